@@ -0,0 +1,1890 @@
+/**
+ * @file benchmark.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Headless benchmarks and accuracy reports for the water synthesis paths. Ran with ./EWS.exe --bench [name]; no window is shown, and only the
+ *        GPU parity check creates an (offscreen) OpenGL context
+ * @version 0.1
+ * @date 2022-06-16
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "benchmark.h"
+#include "SDL2/SDL.h"
+#include "../objects/water.h"
+#include "../objects/wavefield.h"
+#include "../objects/simdmath.h"
+#include "../objects/threadpool.h"
+#include "../objects/ocean.h"
+#include "../objects/streambuffer.h"
+#include "../objects/tessellation.h"
+#include "../objects/clipmap.h"
+#include "../objects/projectedgrid.h"
+#include "../objects/culling.h"
+#include "../objects/scheduler.h"
+#include "../objects/wavecache.h"
+#include "../objects/caustics.h"
+#include "../objects/causticref.h"
+#include "../objects/photons.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * @brief Set of waves generated the same way as the directional/rounded Water constructor, kept both as raw parameters (for reference evaluation) and as a WaveField
+ */
+struct BenchWaves {
+    vector<float> A, w, Dx, Dy, S;
+    WaveField field;
+
+    BenchWaves(int count, float maxA) {
+        srand(1);
+        for (int i = 0; i < count; i ++) {
+            A.push_back(randFloat(maxA));
+            w.push_back(randFloat(MAXFREQ)*0.5+MAXFREQ*0.5);
+            Dx.push_back(randFloat(1.0f)*2-1);
+            Dy.push_back(randFloat(1.0f)*2-1);
+            S.push_back(randFloat(MAXSPED)*0.5+MAXFREQ*0.5);
+            field.addWave(A[i], w[i], Dx[i], Dy[i], S[i]);
+        }
+    }
+
+    // double precision reference of H and both partials
+    void reference(float x, float y, float t, double& h, double& dhdx, double& dhdy) const {
+        h = 0; dhdx = 0; dhdy = 0;
+        for (size_t i = 0; i < A.size(); i ++) {
+            double phase = ((double)Dx[i] * x + (double)Dy[i] * y) * w[i] + (double)S[i] * w[i] * t;
+            h += A[i] * sin(phase);
+            dhdx += (double)w[i] * Dx[i] * A[i] * cos(phase);
+            dhdy += (double)w[i] * Dy[i] * A[i] * cos(phase);
+        }
+    }
+};
+
+/**
+ * @brief Coordinates of a dim x dim grid of the given size centered on the origin (same distribution as Water)
+ */
+struct BenchGrid {
+    int dim;
+    vector<float> x, y;
+
+    BenchGrid(int dim, int size) : dim(dim), x(dim), y(dim) {
+        for (int i = 0; i < dim; i ++) {
+            x[i] = 0 - size / 2 + (float)i * size / dim;
+            y[i] = 0 - size / 2 + (float)i * size / dim;
+        }
+    }
+};
+
+/**
+ * @brief Largest absolute error of a grid of heights and partials against the double precision reference
+ */
+struct BenchError {
+    double h, dhdx, dhdy;
+
+    BenchError() : h(0), dhdx(0), dhdy(0) {}
+
+    void measure(const BenchWaves& waves, const BenchGrid& grid, float t, const vector<float>& h, const vector<float>& dhdx, const vector<float>& dhdy) {
+        for (int i = 0; i < grid.dim; i ++) {
+            for (int j = 0; j < grid.dim; j ++) {
+                double rh, rdx, rdy;
+                waves.reference(grid.x[i], grid.y[j], t, rh, rdx, rdy);
+                int k = i * grid.dim + j;
+                this->h = fmax(this->h, fabs(h[k] - rh));
+                this->dhdx = fmax(this->dhdx, fabs(dhdx[k] - rdx));
+                this->dhdy = fmax(this->dhdy, fabs(dhdy[k] - rdy));
+            }
+        }
+    }
+};
+
+/**
+ * @brief Times a function, returning the fastest of BENCH_REPS runs in milliseconds
+ */
+template <typename F>
+static double timeMs(F f) {
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPS; r ++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::milli> diff = std::chrono::steady_clock::now() - start;
+        best = fmin(best, diff.count());
+    }
+    return best;
+}
+
+/**
+ * @brief Prints one row of a timing/error table
+ */
+static void printRow(const char* name, double ms, double baseMs, const BenchError& err) {
+    printf("  %-28s %9.3f ms %7.2fx   %9.2e %9.2e %9.2e\n", name, ms, baseMs / ms, err.h, err.dhdx, err.dhdy);
+}
+
+/**
+ * @brief Error of a float result against a double precision reference, in units in the last place of the reference rounded to float
+ */
+static double ulpError(float value, double reference) {
+    int exponent;
+    frexp(reference, &exponent);
+    return fabs(value - reference) / ldexp(1.0, exponent - 24);
+}
+
+/**
+ * @brief Runs sincosArray at every SIMD level the processor supports over the floats with |x| <= SIMD_SINCOS_MAXARG (both signs), every one of
+ *        them or every stride-th bit pattern, in chunks that every level evaluates in turn against one double precision reference of the chunk.
+ *        Reports the max ulp error (where |result| >= BENCH_SINCOS_ULP_FLOOR) and max absolute error of sin and cos per level, and whether the
+ *        level is bit-identical to scalar
+ * 
+ * @param stride Bit patterns from one float swept to the next (1 - every float, minutes on a few threads)
+ * @return bool whether every level is within BENCH_SINCOS_SIN_ULP, BENCH_SINCOS_COS_ULP and BENCH_SINCOS_ABS, and identical to scalar
+ */
+bool benchSinCos(int stride) {
+    const int chunk = 1 << 16;
+    SimdLevel restore = simdLevel();
+    int levels = simdDetect() + 1;
+    ThreadPool pool;
+
+    float maxArg = SIMD_SINCOS_MAXARG;
+    uint32_t last;
+    memcpy(&last, &maxArg, sizeof(last));
+    uint64_t count = last / stride + 1;
+    if (stride == 1)
+        printf("sincos: every float with |x| <= %.0f (%.2f billion), levels up to %s, %d threads\n", maxArg, 2.0 * count / 1e9,
+               simdName(simdDetect()), pool.size());
+    else
+        printf("sincos: every %dth float with |x| <= %.0f (%.2f million), levels up to %s, %d threads\n", stride, maxArg, 2.0 * count / 1e6,
+               simdName(simdDetect()), pool.size());
+
+    int tasks = pool.size();
+    vector<float> x(chunk), s((size_t)levels * chunk), c((size_t)levels * chunk);
+    vector<double> errors((size_t)tasks * levels * 4, 0);   // sin ulp, cos ulp, sin abs, cos abs of every level, per task
+    vector<bool> identical(levels, true);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t sign = 0; sign <= 1; sign ++) {
+        for (uint64_t first = 0; first < count; first += chunk) {
+            int n = (int)std::min<uint64_t>(chunk, count - first);
+            for (int k = 0; k < n; k ++) {
+                uint32_t bits = (uint32_t)((first + k) * stride) | (sign << 31);
+                memcpy(&x[k], &bits, sizeof(float));
+            }
+            for (int level = 0; level < levels; level ++) {
+                simdSetLevel((SimdLevel)level);
+                sincosArray(&x[0], &s[(size_t)level * chunk], &c[(size_t)level * chunk], n);
+            }
+
+            // the reference is the cost: a slice of the chunk per thread, each with maxima of its own
+            pool.parallelFor(tasks, 1, [&](int begin, int end) {
+                for (int task = begin; task < end; task ++) {
+                    double* worst = &errors[(size_t)task * levels * 4];
+                    for (int k = task * n / tasks; k < (task + 1) * n / tasks; k ++) {
+                        double rs = sin((double)x[k]), rc = cos((double)x[k]);
+                        for (int level = 0; level < levels; level ++) {
+                            float fs = s[(size_t)level * chunk + k], fc = c[(size_t)level * chunk + k];
+                            double* w = worst + level * 4;
+                            if (fabs(rs) >= BENCH_SINCOS_ULP_FLOOR)
+                                w[0] = fmax(w[0], ulpError(fs, rs));
+                            if (fabs(rc) >= BENCH_SINCOS_ULP_FLOOR)
+                                w[1] = fmax(w[1], ulpError(fc, rc));
+                            w[2] = fmax(w[2], fabs(fs - rs));
+                            w[3] = fmax(w[3], fabs(fc - rc));
+                        }
+                    }
+                }
+            });
+            for (int level = 1; level < levels; level ++) {
+                identical[level] = identical[level] && memcmp(&s[(size_t)level * chunk], &s[0], n * sizeof(float)) == 0
+                    && memcmp(&c[(size_t)level * chunk], &c[0], n * sizeof(float)) == 0;
+            }
+        }
+    }
+    simdSetLevel(restore);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    printf("  %-10s %10s %10s %10s %10s %10s\n", "level", "sin ulp", "cos ulp", "sin abs", "cos abs", "= scalar");
+    bool pass = true;
+    for (int level = 0; level < levels; level ++) {
+        double sinUlp = 0, cosUlp = 0, sinAbs = 0, cosAbs = 0;
+        for (int task = 0; task < tasks; task ++) {
+            const double* w = &errors[((size_t)task * levels + level) * 4];
+            sinUlp = fmax(sinUlp, w[0]);
+            cosUlp = fmax(cosUlp, w[1]);
+            sinAbs = fmax(sinAbs, w[2]);
+            cosAbs = fmax(cosAbs, w[3]);
+        }
+        bool ok = sinUlp <= BENCH_SINCOS_SIN_ULP && cosUlp <= BENCH_SINCOS_COS_ULP && sinAbs <= BENCH_SINCOS_ABS && cosAbs <= BENCH_SINCOS_ABS
+            && identical[level];
+        pass = pass && ok;
+        printf("  %-10s %10.4f %10.4f %10.2e %10.2e %10s %s\n", simdName((SimdLevel)level), sinUlp, cosUlp, sinAbs, cosAbs,
+               identical[level] ? "yes" : "no", ok ? "PASS" : "FAIL");
+    }
+    printf("  swept in %.0f s\n", seconds.count());
+    return pass;
+}
+
+/**
+ * @brief Compares the per-point H/N evaluation against batched rows (sin/cos of every phase) and recurrence rows (angle-addition rotations), timing a full grid
+ *        and reporting the max error of each against a double precision reference over every point of the grid
+ */
+void benchWaveRows() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+    float dy = (float)BENCH_SIZE / BENCH_DIM;
+
+    int n = grid.dim * grid.dim;
+    vector<float> h(n), dhdx(n), dhdy(n);
+
+    printf("wave rows: %dx%d grid, %d waves, sincos level %s\n", grid.dim, grid.dim, BENCH_WAVES, simdName(simdLevel()));
+    printf("  %-28s %12s %8s   %9s %9s %9s\n", "path", "time", "speedup", "err H", "err ddx", "err ddy");
+
+    // original Water::H/N: one libm sin pass for H and two cos passes for the partials, per point
+    BenchError libmErr;
+    double libmMs = timeMs([&]() {
+        for (int i = 0; i < grid.dim; i ++) {
+            for (int j = 0; j < grid.dim; j ++) {
+                float sh = 0, sdx = 0, sdy = 0;
+                for (int k = 0; k < BENCH_WAVES; k ++)
+                    sh += waves.A[k] * sin((waves.Dx[k] * grid.x[i] + waves.Dy[k] * grid.y[j]) * waves.w[k] + waves.S[k] * waves.w[k] * t);
+                for (int k = 0; k < BENCH_WAVES; k ++)
+                    sdx += waves.w[k] * waves.Dx[k] * waves.A[k] * cos((waves.Dx[k] * grid.x[i] + waves.Dy[k] * grid.y[j]) * waves.w[k] + waves.S[k] * waves.w[k] * t);
+                for (int k = 0; k < BENCH_WAVES; k ++)
+                    sdy += waves.w[k] * waves.Dy[k] * waves.A[k] * cos((waves.Dx[k] * grid.x[i] + waves.Dy[k] * grid.y[j]) * waves.w[k] + waves.S[k] * waves.w[k] * t);
+                h[i * grid.dim + j] = sh; dhdx[i * grid.dim + j] = sdx; dhdy[i * grid.dim + j] = sdy;
+            }
+        }
+    });
+    libmErr.measure(waves, grid, t, h, dhdx, dhdy);
+    printRow("per-point libm (original)", libmMs, libmMs, libmErr);
+
+    // current Water::H/N: single pass per point, waves vectorized
+    BenchError pointErr;
+    double pointMs = timeMs([&]() {
+        for (int i = 0; i < grid.dim; i ++) {
+            for (int j = 0; j < grid.dim; j ++) {
+                int k = i * grid.dim + j;
+                waves.field.evaluatePoint(grid.x[i], grid.y[j], t, h[k], dhdx[k], dhdy[k]);
+            }
+        }
+    });
+    pointErr.measure(waves, grid, t, h, dhdx, dhdy);
+    printRow("per-point WaveField", pointMs, libmMs, pointErr);
+
+    // batched rows
+    BenchError rowErr;
+    double rowMs = timeMs([&]() {
+        for (int i = 0; i < grid.dim; i ++) {
+            int k = i * grid.dim;
+            waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[k], &dhdx[k], &dhdy[k]);
+        }
+    });
+    rowErr.measure(waves, grid, t, h, dhdx, dhdy);
+    printRow("rows, direct", rowMs, libmMs, rowErr);
+
+    // recurrence rows
+    BenchError recErr;
+    double recMs = timeMs([&]() {
+        for (int i = 0; i < grid.dim; i ++) {
+            int k = i * grid.dim;
+            waves.field.evaluateRowRecurrence(grid.x[i], grid.y[0], dy, grid.dim, t, &h[k], &dhdx[k], &dhdy[k]);
+        }
+    });
+    recErr.measure(waves, grid, t, h, dhdx, dhdy);
+    printRow("rows, recurrence", recMs, libmMs, recErr);
+}
+
+/**
+ * @brief Compares the per-frame cost of the cached spatial basis against direct rows, and reports the one-off build cost, the memory held by the
+ *        basis and the max error of each against a double precision reference
+ */
+void benchWaveBasis() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+
+    int n = grid.dim * grid.dim;
+    vector<float> h(n), dhdx(n), dhdy(n);
+
+    printf("wave basis: %dx%d grid, %d waves, sincos level %s\n", grid.dim, grid.dim, BENCH_WAVES, simdName(simdLevel()));
+    printf("  %-28s %12s %8s   %9s %9s %9s\n", "path", "time", "speedup", "err H", "err ddx", "err ddy");
+
+    BenchError rowErr;
+    double rowMs = timeMs([&]() {
+        for (int i = 0; i < grid.dim; i ++) {
+            int k = i * grid.dim;
+            waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[k], &dhdx[k], &dhdy[k]);
+        }
+    });
+    rowErr.measure(waves, grid, t, h, dhdx, dhdy);
+    printRow("rows, direct", rowMs, rowMs, rowErr);
+
+    WaveBasis basis;
+    auto start = std::chrono::steady_clock::now();
+    basis.build(waves.field, &grid.x[0], grid.dim, &grid.y[0], grid.dim);
+    std::chrono::duration<double, std::milli> buildMs = std::chrono::steady_clock::now() - start;
+
+    BenchError err;
+    double ms = timeMs([&]() {
+        basis.setTime(waves.field, t);
+        for (int i = 0; i < grid.dim; i ++) {
+            int k = i * grid.dim;
+            basis.evaluateRow(i, &h[k], &dhdx[k], &dhdy[k]);
+        }
+    });
+    err.measure(waves, grid, t, h, dhdx, dhdy);
+    printRow("basis GEMV", ms, rowMs, err);
+    printf("  %-28s build %.3f ms, %.1f MB\n", "", buildMs.count(), basis.bytes() / (1024.0 * 1024.0));
+}
+
+/**
+ * @brief Times a full grid update (rows evaluated and written into the dynamic height/normal stream, the same way as Water::updateMesh) on a pool
+ *        of 1 to maxThreads threads, reporting the per-frame cost, the speedup over one thread and whether the vertices are bit-identical
+ *        to the single threaded result
+ *
+ * @param maxThreads Largest number of threads to time (0 - one per hardware thread)
+ * @return bool whether the vertices are bit-identical for every thread count, in both modes
+ */
+bool benchThreadScaling(int maxThreads) {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+    float dy = (float)BENCH_SIZE / BENCH_DIM;
+
+    if (maxThreads <= 0)
+        maxThreads = ThreadPool::hardwareThreads();
+
+    size_t floats = (size_t)grid.dim * grid.dim * WATER_DYNAMIC_FLOATS;
+    vector<float> vertices(floats), reference(floats);
+    bool pass = true;
+
+    printf("thread scaling: %dx%d grid, %d waves, %d rows per tile, %d hardware threads\n", grid.dim, grid.dim, BENCH_WAVES, WATER_TILE_ROWS, ThreadPool::hardwareThreads());
+
+    for (int mode = 0; mode < 2; mode ++) {
+        bool recurrence = (mode == 1);
+        printf("  %s\n  %-8s %12s %8s %10s\n", recurrence ? "rows, recurrence" : "rows, direct", "threads", "frame", "speedup", "identical");
+
+        auto fillRows = [&](int first, int last) {
+            vector<float> h(grid.dim), dhdx(grid.dim), dhdy(grid.dim);
+            for (int i = first; i < last; i ++) {
+                if (recurrence)
+                    waves.field.evaluateRowRecurrence(grid.x[i], grid.y[0], dy, grid.dim, t, &h[0], &dhdx[0], &dhdy[0]);
+                else
+                    waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[0], &dhdx[0], &dhdy[0]);
+
+                float* vertex = &vertices[(size_t)i * grid.dim * WATER_DYNAMIC_FLOATS];
+                for (int j = 0; j < grid.dim; j ++) {
+                    vertex[0] = h[j]; vertex[1] = 0 - dhdx[j]; vertex[2] = 0 - dhdy[j]; vertex[3] = 1;
+                    vertex += WATER_DYNAMIC_FLOATS;
+                }
+            }
+        };
+
+        double singleMs = 0;
+        ThreadPool pool(1);
+        for (int threads = 1; threads <= maxThreads; threads ++) {
+            pool.resize(threads);
+            double ms = timeMs([&]() { pool.parallelFor(grid.dim, WATER_TILE_ROWS, fillRows); });
+
+            if (threads == 1) {
+                singleMs = ms;
+                reference = vertices;
+            }
+            bool identical = memcmp(&vertices[0], &reference[0], floats * sizeof(float)) == 0;
+            pass = pass && identical;
+            printf("  %-8d %9.3f ms %7.2fx %10s\n", threads, ms, singleMs / ms, identical ? "yes" : "NO");
+        }
+    }
+    return pass;
+}
+
+/**
+ * @brief Times the per-frame synthesis of a spectral ocean (spectrum evolved, three inverse FFTs) for FFT sizes from 64 to 512, single threaded
+ *        and on a pool of every hardware thread, and the cost of sampling it onto the default mesh. The FFT grids are checked against a direct
+ *        double precision sum of every wave at a few grid points, and a snapshot of the grids (what the caustics producer samples) against the
+ *        ocean itself
+ *
+ * @return bool whether every size is within BENCH_OCEAN_TOL of the direct sum, with its snapshot sampled bit-identical to the ocean
+ */
+bool benchOcean() {
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    ThreadPool pool;
+
+    int n = grid.dim * grid.dim;
+    vector<float> h(n), dhdx(n), dhdy(n), dispX(n), dispY(n);
+    vector<float> snapH(n), snapDx(n), snapDy(n);
+    bool pass = true;
+
+    printf("spectral ocean: %d wide patch, Phillips spectrum, sampled onto a %dx%d grid, %d threads\n", BENCH_SIZE, grid.dim, grid.dim, pool.size());
+    printf("  %-8s %8s %12s %12s %12s   %9s %9s %9s %9s\n", "fft", "waves", "1 thread", "pool", "sample", "err H", "err ddx", "err disp", "snapshot");
+
+    for (int size = 64; size <= 512; size *= 2) {
+        Ocean ocean(size, (float)BENCH_SIZE, OCEAN_PHILLIPS, 8.0f, 1.0f, 1.0f, 1e-4f, 0.5f);
+
+        // a new time every repetition, so each one synthesizes a frame
+        float t = 12.5f;
+        double singleMs = timeMs([&]() { ocean.setTime(t += 0.01f, NULL); });
+        double poolMs = timeMs([&]() { ocean.setTime(t += 0.01f, &pool); });
+
+        double sampleMs = timeMs([&]() {
+            for (int i = 0; i < grid.dim; i ++) {
+                int k = i * grid.dim;
+                ocean.sampleRow(grid.x[i], &grid.y[0], grid.dim, &h[k], &dhdx[k], &dhdy[k], &dispX[k], &dispY[k]);
+            }
+        });
+
+        // FFT grids against the direct sum of every wave, at points spread over the patch
+        double errH = 0, errD = 0, errDisp = 0;
+        for (int p = 0; p < 16; p ++) {
+            int ix = (p * 37) % size, iz = (p * 11 + 5) % size;
+            double rh, rdx, rdz, rpx, rpz;
+            ocean.directSum(ix, iz, rh, rdx, rdz, rpx, rpz);
+
+            int k = ix * size + iz;
+            errH = fmax(errH, fabs(ocean.heights()[k] - rh));
+            errD = fmax(errD, fmax(fabs(ocean.slopesX()[k] - rdx), fabs(ocean.slopesZ()[k] - rdz)));
+            errDisp = fmax(errDisp, fmax(fabs(ocean.displacementsX()[k] - rpx), fabs(ocean.displacementsZ()[k] - rpz)));
+        }
+
+        // the copy of the grids samples exactly as the ocean (h, dhdx and dhdy still hold the samples of the last timed repetition)
+        OceanSnapshot snapshot;
+        ocean.snapshot(snapshot);
+        for (int i = 0; i < grid.dim; i ++) {
+            int k = i * grid.dim;
+            snapshot.sampleRow(grid.x[i], &grid.y[0], grid.dim, &snapH[k], &snapDx[k], &snapDy[k]);
+        }
+        bool identical = memcmp(&h[0], &snapH[0], n * sizeof(float)) == 0 && memcmp(&dhdx[0], &snapDx[0], n * sizeof(float)) == 0 &&
+                         memcmp(&dhdy[0], &snapDy[0], n * sizeof(float)) == 0;
+
+        bool ok = identical && errH <= BENCH_OCEAN_TOL && errD <= BENCH_OCEAN_TOL && errDisp <= BENCH_OCEAN_TOL;
+        pass = pass && ok;
+        printf("  %-8d %8d %9.3f ms %9.3f ms %9.3f ms   %9.2e %9.2e %9.2e %9s %s\n", size, size * size, singleMs, poolMs, sampleMs, errH, errD, errDisp,
+               identical ? "yes" : "NO", ok ? "PASS" : "FAIL");
+    }
+    return pass;
+}
+
+/**
+ * @brief Times the vertex streams of Gerstner waves against the sum of sines (direct rows written into the height/normal stream, as Water::updateMesh does) on
+ *        the default grid, for a few wave counts. At a steepness of 0 both must agree; at full steepness the smallest up component of the normal (the determinant of
+ *        the horizontal map) must stay positive, i.e. no crest folds over
+ *
+ * @return bool whether every wave count is within BENCH_GERSTNER_TOL of the sum of sines at Q = 0, with a positive normal up at every steepness
+ */
+bool benchGerstner() {
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+
+    size_t floats = (size_t)grid.dim * grid.dim * WATER_DYNAMIC_FLOATS;
+    vector<float> sines(floats), trochoids(floats);
+    vector<float> offsets((size_t)grid.dim * grid.dim * WATER_DISPLACEMENT_FLOATS);
+    vector<float> h(grid.dim), dhdx(grid.dim), dhdy(grid.dim);
+    bool pass = true;
+
+    printf("gerstner waves: %dx%d grid, sincos level %s\n", grid.dim, grid.dim, simdName(simdLevel()));
+    printf("  %-6s %-22s %12s %8s   %12s %12s\n", "waves", "path", "frame", "ratio", "max diff", "min normal up");
+
+    for (int count = BENCH_WAVES; count <= BENCH_WAVES * 4; count *= 2) {
+        BenchWaves waves(count, BENCH_MAXA);
+        Gerstner gerstner;
+        for (int i = 0; i < count; i ++)
+            gerstner.addWave(waves.A[i], waves.w[i], waves.Dx[i], waves.Dy[i], waves.S[i]);
+
+        double sineMs = timeMs([&]() {
+            for (int i = 0; i < grid.dim; i ++) {
+                waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[0], &dhdx[0], &dhdy[0]);
+
+                float* vertex = &sines[(size_t)i * grid.dim * WATER_DYNAMIC_FLOATS];
+                for (int j = 0; j < grid.dim; j ++) {
+                    vertex[0] = h[j]; vertex[1] = 0 - dhdx[j]; vertex[2] = 0 - dhdy[j]; vertex[3] = 1;
+                    vertex += WATER_DYNAMIC_FLOATS;
+                }
+            }
+        });
+        printf("  %-6d %-22s %9.3f ms %7.2fx\n", count, "sum of sines", sineMs, 1.0);
+
+        for (int q = 0; q <= 2; q ++) {
+            float Q = q * 0.5f;
+            gerstner.setSteepness(Q);
+
+            double ms = timeMs([&]() {
+                for (int i = 0; i < grid.dim; i ++)
+                    gerstner.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &trochoids[(size_t)i * grid.dim * WATER_DYNAMIC_FLOATS],
+                        &offsets[(size_t)i * grid.dim * WATER_DISPLACEMENT_FLOATS]);
+            });
+
+            // the sum of sines never moves vertices sideways
+            double diff = 0, minUp = 1e30;
+            for (size_t k = 0; k < floats; k += WATER_DYNAMIC_FLOATS) {
+                for (int c = 0; c < WATER_DYNAMIC_FLOATS; c ++)
+                    diff = fmax(diff, fabs(trochoids[k + c] - sines[k + c]));
+                minUp = fmin(minUp, trochoids[k + 3]);
+            }
+            for (size_t k = 0; k < offsets.size(); k ++)
+                diff = fmax(diff, fabs(offsets[k]));
+
+            bool ok = minUp > 0 && (q > 0 || diff <= BENCH_GERSTNER_TOL);
+            pass = pass && ok;
+
+            char name[32];
+            snprintf(name, sizeof(name), "gerstner, Q = %.1f", Q);
+            printf("  %-6s %-22s %9.3f ms %7.2fx   %12.2e %12.4f %s\n", "", name, ms, sineMs / ms, diff, minUp, ok ? "PASS" : "FAIL");
+        }
+    }
+    return pass;
+}
+
+/**
+ * @brief Times a full grid for each of the four wave families (directional/circular x rounded/pointed), once a point at a time and once a row at
+ *        a time through the evaluators specialized for the family, checking both give the same result
+ *
+ * @return bool whether the rows give bit-identical heights and partials to the points for every family and wave count
+ */
+bool benchWaveFamilies() {
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+
+    int n = grid.dim * grid.dim;
+    vector<float> h(n), dhdx(n), dhdy(n), pointH(n), pointDx(n), pointDy(n);
+    bool pass = true;
+
+    printf("wave families: %dx%d grid, sincos level %s\n", grid.dim, grid.dim, simdName(simdLevel()));
+    printf("  %-6s %-24s %12s %12s %8s %10s\n", "waves", "family", "points", "rows", "speedup", "identical");
+
+    const char* names[4] = { "directional, rounded", "directional, pointed", "circular, rounded", "circular, pointed" };
+    for (int count = 4; count <= BENCH_WAVES; count = (count == 16) ? BENCH_WAVES : count * 2) {
+        BenchWaves waves(count, BENCH_MAXA);
+
+        // circular waves radiate from centers over the grid
+        WaveField field;
+        for (int i = 0; i < count; i ++)
+            field.addWave(waves.A[i], waves.w[i], waves.Dx[i], waves.Dy[i], waves.S[i], waves.Dx[i] * BENCH_SIZE / 2, waves.Dy[i] * BENCH_SIZE / 2);
+
+        for (int family = 0; family < 4; family ++) {
+            field.setFamily(family < 2, family % 2 == 0);
+
+            double pointMs = timeMs([&]() {
+                for (int i = 0; i < grid.dim; i ++) {
+                    for (int j = 0; j < grid.dim; j ++) {
+                        int k = i * grid.dim + j;
+                        field.evaluatePoint(grid.x[i], grid.y[j], t, pointH[k], pointDx[k], pointDy[k]);
+                    }
+                }
+            });
+            double rowMs = timeMs([&]() {
+                for (int i = 0; i < grid.dim; i ++) {
+                    int k = i * grid.dim;
+                    field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[k], &dhdx[k], &dhdy[k]);
+                }
+            });
+
+            bool identical = memcmp(&h[0], &pointH[0], n * sizeof(float)) == 0 && memcmp(&dhdx[0], &pointDx[0], n * sizeof(float)) == 0 &&
+                             memcmp(&dhdy[0], &pointDy[0], n * sizeof(float)) == 0;
+            pass = pass && identical;
+            printf("  %-6d %-24s %9.3f ms %9.3f ms %7.2fx %10s\n", count, names[family], pointMs, rowMs, pointMs / rowMs, identical ? "yes" : "NO");
+        }
+    }
+    return pass;
+}
+
+/**
+ * @brief Compares analytic normals (partials summed over every wave) against finite difference normals (heights only, then a central difference
+ *        stencil over the grid) for every evaluation mode, at two wave counts. Reports the per-frame cost of a full grid and the largest error of
+ *        the partials and of the direction of the normals against a double precision reference, to choose a mode per deployment
+ */
+void benchNormals() {
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+    float dy = (float)BENCH_SIZE / BENCH_DIM;
+
+    int n = grid.dim * grid.dim;
+    vector<float> h(n), dhdx(n), dhdy(n);
+
+    printf("normals: %dx%d grid, spacing %.3f, sincos level %s\n", grid.dim, grid.dim, dy, simdName(simdLevel()));
+    printf("  %-6s %-18s %-10s %12s %8s   %9s %9s %11s\n", "waves", "rows", "normals", "frame", "speedup", "err ddx", "err ddy", "err angle");
+
+    const char* names[3] = { "direct", "recurrence", "basis" };
+    for (int count = BENCH_WAVES; count <= BENCH_WAVES * 4; count *= 4) {
+        BenchWaves waves(count, BENCH_MAXA);
+        WaveBasis basis;
+
+        for (int mode = WAVE_DIRECT; mode <= WAVE_BASIS; mode ++) {
+            if (mode == WAVE_BASIS)
+                basis.build(waves.field, &grid.x[0], grid.dim, &grid.y[0], grid.dim);
+
+            double analyticMs = 0;
+            for (int finite = 0; finite < 2; finite ++) {
+                double ms = timeMs([&]() {
+                    if (mode == WAVE_BASIS)
+                        basis.setTime(waves.field, t);
+
+                    for (int i = 0; i < grid.dim; i ++) {
+                        int k = i * grid.dim;
+                        float* rdx = finite ? NULL : &dhdx[k];
+                        float* rdy = finite ? NULL : &dhdy[k];
+                        if (mode == WAVE_BASIS)
+                            basis.evaluateRow(i, &h[k], rdx, rdy);
+                        else if (mode == WAVE_RECURRENCE)
+                            waves.field.evaluateRowRecurrence(grid.x[i], grid.y[0], dy, grid.dim, t, &h[k], rdx, rdy);
+                        else
+                            waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[k], rdx, rdy);
+                    }
+                    if (finite)
+                        gridSlopes(&h[0], grid.dim, grid.dim, dy, dy, 0, grid.dim, &dhdx[0], &dhdy[0]);
+                });
+                if (!finite)
+                    analyticMs = ms;
+
+                // partials, and angle between the normals <-ddx, -ddy, 1>
+                BenchError err;
+                err.measure(waves, grid, t, h, dhdx, dhdy);
+                double angle = 0;
+                for (int i = 0; i < grid.dim; i ++) {
+                    for (int j = 0; j < grid.dim; j ++) {
+                        double rh, rdx, rdy;
+                        waves.reference(grid.x[i], grid.y[j], t, rh, rdx, rdy);
+                        int k = i * grid.dim + j;
+                        double dot = rdx * dhdx[k] + rdy * dhdy[k] + 1;
+                        double norms = sqrt((rdx * rdx + rdy * rdy + 1) * ((double)dhdx[k] * dhdx[k] + (double)dhdy[k] * dhdy[k] + 1));
+                        angle = fmax(angle, acos(fmin(1.0, dot / norms)) * 180 / M_PI);
+                    }
+                }
+
+                printf("  %-6d %-18s %-10s %9.3f ms %7.2fx   %9.2e %9.2e %9.2e deg\n", count, names[mode], finite ? "finite" : "analytic", ms, analyticMs / ms, err.dhdx, err.dhdy, angle);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Compares the per-frame vertex traffic of the old interleaved layout (x, y, z and the normal of every vertex rebuilt and uploaded every
+ *        frame) against split streams (x, z uploaded once, only the height and normal rewritten in place and uploaded). The upload is stood in for
+ *        by a copy into a second buffer of the same size, as glBufferSubData copies out of client memory
+ */
+void benchVertexStreams() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+
+    size_t points = (size_t)grid.dim * grid.dim;
+    vector<float> h(grid.dim), dhdx(grid.dim), dhdy(grid.dim);
+
+    printf("vertex streams: %dx%d grid, %d waves, direct rows\n", grid.dim, grid.dim, BENCH_WAVES);
+    printf("  %-22s %12s %12s %12s %8s\n", "layout", "upload", "fill", "copy", "speedup");
+
+    double baseMs = 0;
+    for (int split = 0; split < 2; split ++) {
+        int stride = split ? WATER_DYNAMIC_FLOATS : 6;
+        vector<float> vertices(points * stride), uploaded(points * stride);
+
+        // heights and normals in place; the interleaved layout also rewrites x and z
+        double fillMs = timeMs([&]() {
+            for (int i = 0; i < grid.dim; i ++) {
+                waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[0], &dhdx[0], &dhdy[0]);
+
+                float* vertex = &vertices[(size_t)i * grid.dim * stride];
+                for (int j = 0; j < grid.dim; j ++) {
+                    if (split) {
+                        vertex[0] = h[j]; vertex[1] = 0 - dhdx[j]; vertex[2] = 0 - dhdy[j]; vertex[3] = 1;
+                    } else {
+                        vertex[0] = grid.x[i]; vertex[1] = h[j]; vertex[2] = grid.y[j];
+                        vertex[3] = 0 - dhdx[j]; vertex[4] = 0 - dhdy[j]; vertex[5] = 1;
+                    }
+                    vertex += stride;
+                }
+            }
+        });
+        double copyMs = timeMs([&]() { memcpy(&uploaded[0], &vertices[0], vertices.size() * sizeof(float)); });
+
+        double ms = fillMs + copyMs;
+        if (!split)
+            baseMs = ms;
+
+        char upload[32];
+        snprintf(upload, sizeof(upload), "%.2f MB", vertices.size() * sizeof(float) / (1024.0 * 1024.0));
+        printf("  %-22s %12s %9.3f ms %9.3f ms %7.2fx\n", split ? "split (y + normal)" : "interleaved (xyz + n)", upload, fillMs, copyMs, baseMs / ms);
+    }
+    printf("  static stream: %.2f MB, uploaded once\n", points * WATER_STATIC_FLOATS * sizeof(float) / (1024.0 * 1024.0));
+}
+
+// fake GPU that also remembers the last fence it issued, so the benchmark knows which fence guards each region
+class RecordingStreamBackend : public FakeStreamBackend {
+    public:
+        RecordingStreamBackend(int latency) : FakeStreamBackend(latency), last(NULL) {}
+
+        void* fence() {
+            last = FakeStreamBackend::fence();
+            return last;
+        }
+
+        void* last;
+};
+
+/**
+ * @brief Validates the packed dynamic stream against the float one for every wave family over the benchmark grid: largest height error (against
+ *        the snorm16 step of the amplitude bound) and largest angle between the unpacked normal and the float one, with the SSE2 packer checked
+ *        bit-identical to the scalar one. Also times both packers against the bytes they save
+ * 
+ * @return bool whether every family is within BENCH_PACKED_HEIGHT_STEPS steps and BENCH_PACKED_ANGLE_TOL degrees, with identical packers
+ */
+bool benchPackedVertices() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    size_t points = (size_t)grid.dim * grid.dim;
+    float t = 12.5f;
+
+    printf("packed vertices: %dx%d grid, %d waves, %d -> %d bytes per dynamic vertex (%.2f -> %.2f MB per frame)\n", grid.dim, grid.dim, BENCH_WAVES,
+           (int)(WATER_DYNAMIC_FLOATS * sizeof(float)), (int)(WATER_PACKED_SHORTS * sizeof(int16_t)),
+           points * WATER_DYNAMIC_FLOATS * sizeof(float) / (1024.0 * 1024.0), points * WATER_PACKED_SHORTS * sizeof(int16_t) / (1024.0 * 1024.0));
+    printf("  %-22s %10s %12s %12s %12s %12s %10s\n", "family", "bound", "height err", "(steps)", "normal err", "scalar", "SSE2");
+
+    const char* names[4] = { "directional rounded", "directional pointed", "circular rounded", "circular pointed" };
+    vector<float> surface(points * WATER_DYNAMIC_FLOATS), unpacked(surface.size());
+    vector<float> h(grid.dim), dhdx(grid.dim), dhdy(grid.dim);
+    vector<int16_t> packedScalar(points * WATER_PACKED_SHORTS), packedSimd(packedScalar.size());
+    SimdLevel level = simdLevel();
+    bool pass = true;
+
+    for (int family = 0; family < 4; family ++) {
+        bool directional = family < 2, rounded = (family % 2) == 0;
+        waves.field.setFamily(directional, rounded);
+
+        float bound = 0;
+        for (int i = 0; i < BENCH_WAVES; i ++)
+            bound += waves.A[i];
+        if (!rounded)
+            bound *= 2;
+        float scale = SIMD_SNORM16_MAX / bound;
+
+        for (int i = 0; i < grid.dim; i ++) {
+            waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[0], &dhdx[0], &dhdy[0]);
+            float* vertex = &surface[(size_t)i * grid.dim * WATER_DYNAMIC_FLOATS];
+            for (int j = 0; j < grid.dim; j ++) {
+                vertex[0] = h[j]; vertex[1] = 0 - dhdx[j]; vertex[2] = 0 - dhdy[j]; vertex[3] = 1;
+                vertex += WATER_DYNAMIC_FLOATS;
+            }
+        }
+
+        simdSetLevel(SIMD_SCALAR);
+        double scalarMs = timeMs([&]() { packSurfaceArray(&surface[0], &packedScalar[0], points, scale); });
+        simdSetLevel(SIMD_SSE2);
+        double simdMs = timeMs([&]() { packSurfaceArray(&surface[0], &packedSimd[0], points, scale); });
+        simdSetLevel(level);
+        bool identical = memcmp(&packedScalar[0], &packedSimd[0], packedSimd.size() * sizeof(int16_t)) == 0;
+
+        unpackSurfaceArray(&packedSimd[0], &unpacked[0], points, scale);
+        double heightErr = 0, angleErr = 0;
+        for (size_t k = 0; k < points; k ++) {
+            const float* a = &surface[k * WATER_DYNAMIC_FLOATS];
+            const float* b = &unpacked[k * WATER_DYNAMIC_FLOATS];
+            heightErr = fmax(heightErr, fabs((double)a[0] - b[0]));
+
+            // atan2 of the cross and dot products keeps its precision at small angles (acos of the dot product does not)
+            double cx = (double)a[2] * b[3] - (double)a[3] * b[2], cy = (double)a[3] * b[1] - (double)a[1] * b[3], cz = (double)a[1] * b[2] - (double)a[2] * b[1];
+            double dot = (double)a[1] * b[1] + (double)a[2] * b[2] + (double)a[3] * b[3];
+            angleErr = fmax(angleErr, atan2(sqrt(cx * cx + cy * cy + cz * cz), dot) * 180.0 / M_PI);
+        }
+
+        double steps = heightErr * scale;
+        bool ok = identical && steps <= BENCH_PACKED_HEIGHT_STEPS && angleErr <= BENCH_PACKED_ANGLE_TOL;
+        pass = pass && ok;
+        printf("  %-22s %8.3f m %10.2e m %12.3f %10.5f deg %9.3f ms %7.3f ms %s%s\n", names[family], bound, heightErr, steps, angleErr, scalarMs, simdMs,
+               ok ? "PASS" : "FAIL", identical ? "" : " (packers differ)");
+    }
+    waves.field.setFamily(true, true);
+    return pass;
+}
+
+/**
+ * @brief Runs the fence logic of the streaming ring against a fake GPU lagging 0 to 4 frames behind, for rings of 1 to STREAM_REGIONS regions,
+ *        reporting how many of the frames stalled. Checks that a ring never stalls while the GPU lags fewer frames than it has regions, stalls
+ *        on every frame once the ring is full otherwise (a single region: on every frame after the first), and that acquire never hands out a
+ *        region whose last fence the GPU has not passed
+ *
+ * @return bool whether every check passes
+ */
+bool benchStreamRing() {
+    int frames = 120;
+    size_t bytes = (size_t)BENCH_DIM * BENCH_DIM * (WATER_DYNAMIC_FLOATS + WATER_DISPLACEMENT_FLOATS) * sizeof(float);
+    bool pass = true;
+
+    printf("streaming ring: %d frames of %.2f MB, fake GPU\n", frames, bytes / (1024.0 * 1024.0));
+    printf("  %-8s", "latency");
+    for (int regions = 1; regions <= STREAM_REGIONS; regions ++)
+        printf(" %7d reg", regions);
+    printf("\n");
+
+    for (int latency = 0; latency <= 4; latency ++) {
+        printf("  %-8d", latency);
+        for (int regions = 1; regions <= STREAM_REGIONS; regions ++) {
+            RecordingStreamBackend backend(latency);
+            StreamBuffer ring;
+            ring.init(bytes, regions, &backend);
+
+            // write a frame, draw it (the fence), repeat, remembering the fence of every region
+            vector<void*> guards(regions, (void*)NULL);
+            long pending = 0;
+            for (int f = 0; f < frames; f ++) {
+                char* region = (char*)ring.acquire();
+                int index = (int)(ring.offset() / ring.regionBytes());
+                if (guards[index] && !backend.signaled(guards[index]))
+                    pending ++;
+                memset(region, f, 64);
+                ring.fence();
+                guards[index] = backend.last;
+            }
+
+            long expected = latency < regions ? 0 : frames - regions;
+            bool ok = ring.stalls() == expected && pending == 0;
+            pass = pass && ok;
+            printf(" %4ld stall%s", ring.stalls(), ok ? "" : (pending ? "!P" : "!S"));
+        }
+        printf("\n");
+    }
+    printf("  stalls as expected, no region handed out under a pending fence %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+/**
+ * @brief Times a clipmap update (every level evaluated around the viewer) at the spacing of the benchmark grid, for more and more levels: the
+ *        vertices and vertex-wave evaluations per frame stay nearly constant while the extent doubles with every level, against the flat grid of
+ *        the finest spacing that would cover the same extent (and against the benchmark grid itself)
+ */
+void benchClipmap() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float spacing = (float)BENCH_SIZE / BENCH_DIM;
+
+    printf("clipmap: %dx%d vertices per level, %.2f m finest spacing, %d waves\n", CLIPMAP_RESOLUTION, CLIPMAP_RESOLUTION, spacing, BENCH_WAVES);
+    printf("  %-10s %9s %10s %12s %8s %12s %12s\n", "levels", "extent", "vertices", "flat grid", "of flat", "wave evals", "update");
+
+    // the benchmark grid, as Water updates it (every vertex, every wave)
+    vector<float> h((size_t)BENCH_DIM * BENCH_DIM), dhdx(h.size()), dhdy(h.size());
+    double meshMs = timeMs([&]() {
+        for (int i = 0; i < BENCH_DIM; i ++)
+            waves.field.evaluateRow(grid.x[i], &grid.y[0], BENCH_DIM, 12.5f, &h[i * BENCH_DIM], &dhdx[i * BENCH_DIM], &dhdy[i * BENCH_DIM]);
+    });
+    long meshVertices = (long)BENCH_DIM * BENCH_DIM;
+    printf("  %-10s %7d m %10ld %12ld %7.1f%% %12ld %9.3f ms\n", "flat mesh", BENCH_SIZE, meshVertices, meshVertices, 100.0, meshVertices * BENCH_WAVES, meshMs);
+
+    for (int levels = 1; levels <= 10; levels ++) {
+        Clipmap clipmap(levels, CLIPMAP_RESOLUTION, spacing);
+        for (int i = 0; i < BENCH_WAVES; i ++)
+            clipmap.addWave(waves.A[i], waves.w[i], waves.Dx[i], waves.Dy[i], waves.S[i]);
+        clipmap.setFamily(true, true);
+
+        // the viewer drifts, so levels move now and then
+        float t = 12.5f;
+        double ms = timeMs([&]() { clipmap.update(3.3f + t, -1.7f, t); t += 0.25f; });
+
+        double side = clipmap.extent() / spacing + 1;
+        double flat = side * side;
+        printf("  %-10d %7.0f m %10ld %12.0f %7.2f%% %12ld %9.3f ms\n", levels, clipmap.extent(), clipmap.verticesEvaluated(), flat,
+               100.0 * clipmap.verticesEvaluated() / flat, clipmap.waveEvaluations(), ms);
+
+        if (levels == CLIPMAP_LEVELS) {
+            printf("  %-10s", "  waves");
+            for (int l = 0; l < levels; l ++)
+                printf(" %d", clipmap.waves(l));
+            printf(" (level 0 outwards)\n");
+        }
+    }
+}
+
+/**
+ * @brief Compares the projected grid with flat BENCH_DIM x BENCH_DIM meshes of growing extent, seen by cameras at several heights and pitches: of
+ *        the vertices of the mesh only the ones in the frustum are of any use, while every vertex of the projected grid is. Times unprojecting and
+ *        evaluating the grid, then checks that no vertex of the grid lies behind the camera and that every vertex on the plane (short of the far
+ *        plane) projects back to its point of the screen
+ * 
+ * @return bool whether every check passes
+ */
+bool benchProjectedGrid() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    float height = 0;
+    for (int i = 0; i < BENCH_WAVES; i ++)
+        height += waves.A[i];
+
+    float farPlane = 1000.0f;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, farPlane);
+    int extents[3] = { BENCH_SIZE, BENCH_SIZE * 10, BENCH_SIZE * 100 };
+    float heights[3] = { 2.0f, 10.0f, 50.0f };
+    float pitches[4] = { -5.0f, -20.0f, -45.0f, -89.0f };
+
+    ProjectedGrid grid(PROJECTED_COLUMNS, PROJECTED_ROWS);
+    printf("projected grid: %dx%d vertices against %dx%d meshes, %d waves, far plane %.0f m\n", grid.columns(), grid.rows(), BENCH_DIM, BENCH_DIM, BENCH_WAVES, farPlane);
+    printf("  %-8s %6s  %-30s %10s %9s %12s %12s\n", "camera", "pitch", "mesh vertices in view", "grid", "behind", "unproject", "evaluate");
+
+    double worst = 0;
+    long behindTotal = 0;
+    for (int hc = 0; hc < 3; hc ++) {
+        for (int pc = 0; pc < 4; pc ++) {
+            float pitch = glm::radians(pitches[pc]);
+            glm::vec3 eye(0.3f, heights[hc], -0.7f);
+            glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(0, sinf(pitch), cosf(pitch)), glm::vec3(0, 1, 0));
+            glm::mat4 viewProjection = projection * view;
+
+            // vertices of every mesh that land in the frustum
+            char meshes[64] = "";
+            int written = 0;
+            for (int e = 0; e < 3; e ++) {
+                long inside = 0;
+                float spacing = (float)extents[e] / BENCH_DIM;
+                for (int i = 0; i < BENCH_DIM; i ++) {
+                    for (int j = 0; j < BENCH_DIM; j ++) {
+                        glm::vec4 clip = viewProjection * glm::vec4(-extents[e] / 2 + i * spacing, 0, -extents[e] / 2 + j * spacing, 1);
+                        if (fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && fabsf(clip.z) <= clip.w)
+                            inside ++;
+                    }
+                }
+                written += snprintf(meshes + written, sizeof(meshes) - written, " %6.2f%%", 100.0 * inside / ((long)BENCH_DIM * BENCH_DIM));
+            }
+
+            bool visible = false;
+            double unprojectMs = timeMs([&]() { visible = grid.update(view, projection, 0, height); });
+            double evaluateMs = timeMs([&]() { grid.evaluate(waves.field, 12.5f); });
+
+            // every vertex should be in front of the camera and, short of the far plane, on the ray through its point of the screen
+            long behind = 0;
+            glm::vec2 lower = grid.rangeMin(), upper = grid.rangeMax();
+            for (int r = 0; visible && r < grid.rows(); r ++) {
+                for (int c = 0; c < grid.columns(); c ++) {
+                    const float* point = &grid.planar[((size_t)r * grid.columns() + c) * PROJECTED_STATIC_FLOATS];
+                    glm::vec4 clip = viewProjection * glm::vec4(point[0], 0, point[1], 1);
+                    if (clip.w <= 0) {
+                        behind ++;
+                        continue;
+                    }
+                    if (clip.z / clip.w >= 0.999f)
+                        continue;
+                    glm::vec2 expected(lower.x + (upper.x - lower.x) * c / (grid.columns() - 1), lower.y + (upper.y - lower.y) * r / (grid.rows() - 1));
+                    worst = fmax(worst, glm::length(glm::vec2(clip) / clip.w - expected));
+                }
+            }
+            behindTotal += behind;
+
+            printf("  %6.0f m %5.0f  %-30s %10d %9ld %9.3f ms %9.3f ms\n", heights[hc], pitches[pc], meshes, visible ? grid.vertices() : 0, behind, unprojectMs, evaluateMs);
+        }
+    }
+    printf("  (mesh columns: %d m, %d m, %d m of water)\n", extents[0], extents[1], extents[2]);
+
+    bool aligned = worst < 1e-3;
+    printf("  vertices behind the camera: %ld %s\n", behindTotal, behindTotal == 0 ? "PASS" : "FAIL");
+    printf("  largest screen error of the vertices on the plane: %.2e %s\n", worst, aligned ? "PASS" : "FAIL");
+    return behindTotal == 0 && aligned;
+}
+
+/**
+ * @brief Culls the tiles of the benchmark grid for cameras inside, above and beside the water, looking every way: tiles and vertices kept, and
+ *        the cost of evaluating only the spans under kept tiles against the whole grid. Checks that culling is conservative: every vertex that
+ *        lands in the frustum at its actual height lies under a kept tile
+ * 
+ * @return bool whether no visible vertex was culled for any camera
+ */
+bool benchCulling() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+    float t = 12.5f;
+
+    float bound = 0;
+    for (int i = 0; i < BENCH_WAVES; i ++)
+        bound += waves.A[i];
+
+    // heights of the whole grid, to check the kept tiles against
+    vector<float> heights((size_t)grid.dim * grid.dim), dhdx(heights.size()), dhdy(heights.size());
+    double fullMs = timeMs([&]() {
+        for (int i = 0; i < grid.dim; i ++)
+            waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &heights[i * grid.dim], &dhdx[i * grid.dim], &dhdy[i * grid.dim]);
+    });
+
+    TileGrid tiles(grid.dim, grid.dim, CULL_TILE_QUADS);
+    long tileVertices = 0;
+    for (int k = 0; k < tiles.count(); k ++)
+        tileVertices += tiles.tileVertices(k);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    printf("culling: %dx%d grid in %d tiles of %d quads, %d waves, bound %.3f m, whole grid %.3f ms\n", grid.dim, grid.dim, tiles.count(), CULL_TILE_QUADS,
+           BENCH_WAVES, bound, fullMs);
+    printf("  %-24s %6s %6s %12s %12s %9s %10s\n", "camera", "yaw", "pitch", "tiles kept", "vertices", "update", "missed");
+
+    struct BenchCamera { const char* name; glm::vec3 eye; };
+    BenchCamera cameras[3] = { { "inside, 2 m up", glm::vec3(3, 2, -4) }, { "center, 30 m up", glm::vec3(0, 30, 0) }, { "beside, 10 m up", glm::vec3(-40, 10, 5) } };
+    float yaws[4] = { 0, 90, 180, 270 };
+    float pitches[2] = { -15, -60 };
+
+    long missedTotal = 0;
+    vector<glm::ivec2> spans;
+    vector<float> h(grid.dim), sx(grid.dim), sy(grid.dim);
+    for (int c = 0; c < 3; c ++) {
+        for (int y = 0; y < 4; y ++) {
+            for (int p = 0; p < 2; p ++) {
+                float yaw = glm::radians(yaws[y]), pitch = glm::radians(pitches[p]);
+                glm::vec3 forward(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw));
+                glm::mat4 viewProjection = projection * glm::lookAt(cameras[c].eye, cameras[c].eye + forward, glm::vec3(0, 1, 0));
+
+                tiles.cull(Frustum(viewProjection), &grid.x[0], &grid.y[0], bound);
+
+                // only the spans under kept tiles, as Water::fillSpans
+                double ms = timeMs([&]() {
+                    for (int i = 0; i < grid.dim; i ++) {
+                        tiles.visibleSpans(i, spans);
+                        for (size_t s = 0; s < spans.size(); s ++) {
+                            int n = spans[s].y - spans[s].x + 1;
+                            waves.field.evaluateRow(grid.x[i], &grid.y[spans[s].x], n, t, &h[0], &sx[0], &sy[0]);
+                        }
+                    }
+                });
+
+                // vertices in the frustum at their actual height must be under a kept tile
+                long missed = 0;
+                for (int i = 0; i < grid.dim; i ++) {
+                    tiles.visibleSpans(i, spans);
+                    for (int j = 0; j < grid.dim; j ++) {
+                        glm::vec4 clip = viewProjection * glm::vec4(grid.x[i], heights[(size_t)i * grid.dim + j], grid.y[j], 1);
+                        if (fabsf(clip.x) > clip.w || fabsf(clip.y) > clip.w || fabsf(clip.z) > clip.w)
+                            continue;
+                        bool kept = false;
+                        for (size_t s = 0; s < spans.size() && !kept; s ++)
+                            kept = (j >= spans[s].x && j <= spans[s].y);
+                        missed += !kept;
+                    }
+                }
+                missedTotal += missed;
+
+                printf("  %-24s %6.0f %6.0f %6d %4.1f%% %11.1f%% %6.3f ms %10ld\n", cameras[c].name, yaws[y], pitches[p], (int)tiles.visible().size(),
+                       100.0 * tiles.visible().size() / tiles.count(), 100.0 * tiles.visibleVertices() / tileVertices, ms, missed);
+            }
+        }
+    }
+
+    printf("  culling efficiency over every camera: %.1f%% of the vertices culled\n", 100.0 * tiles.stats().efficiency());
+    printf("  visible vertices culled: %ld %s\n", missedTotal, missedTotal == 0 ? "PASS" : "FAIL");
+    return missedTotal == 0;
+}
+
+/**
+ * @brief Time-sliced updates of the benchmark grid under a camera circling it 20 m out and 3 m up, for 4 seconds of frames at 60 Hz. First with
+ *        budgets that are shares of a whole update, the cost of a vertex fed back from a model (the whole grid timed once) so the schedule is
+ *        the same on every machine: every frame past the first (cost still unknown) must fit its budget, and no tile in view may wait more than
+ *        BENCH_BUDGET_MAX_WAIT frames for its update. Then with fixed budgets of milliseconds and the cost of a vertex measured as it goes,
+ *        reporting the actual cost of every frame against its budget
+ * 
+ * @return bool whether every frame fit its budget and no tile starved
+ */
+bool benchUpdateBudget() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    BenchGrid grid(BENCH_DIM, BENCH_SIZE);
+
+    float bound = 0;
+    for (int i = 0; i < BENCH_WAVES; i ++)
+        bound += waves.A[i];
+
+    TileGrid tiles(grid.dim, grid.dim, CULL_TILE_QUADS);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    vector<float> h(grid.dim), sx(grid.dim), sy(grid.dim);
+    double fullMs = timeMs([&]() {
+        for (int i = 0; i < grid.dim; i ++)
+            waves.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, 12.5f, &h[0], &sx[0], &sy[0]);
+    });
+    double modelMsPerVertex = fullMs / ((double)grid.dim * grid.dim);
+
+    const int frames = 240;
+    const float dt = 1.0f / 60;
+
+    printf("budget: %dx%d grid in %d tiles of %d quads, %d waves, whole grid %.3f ms, %d frames of %.1f ms\n", grid.dim, grid.dim, tiles.count(),
+           CULL_TILE_QUADS, BENCH_WAVES, fullMs, frames, 1000.0 * dt);
+    printf("  %-10s %9s %13s %11s %11s %11s %9s %9s\n", "budget", "budget ms", "tiles/frame", "estimated", "actual", "over", "stalest", "wait");
+
+    double shares[] = BENCH_BUDGET_SHARES;
+    double fixedMs[3] = { 4, 2, 1 };
+    int runs = sizeof(shares) / sizeof(shares[0]);
+
+    bool pass = true;
+    vector<glm::ivec2> spans;
+    for (int run = 0; run < runs + 3; run ++) {
+        bool modeled = run < runs;
+        double budget = modeled ? shares[run] * fullMs : fixedMs[run - runs];
+        TileScheduler scheduler(budget);
+
+        double estimatedSum = 0, actualSum = 0;
+        long scheduledSum = 0, candidateSum = 0;
+        int over = 0, wait = 0;
+        float stalest = 0;
+        vector<int> waiting(tiles.count(), 0);
+        for (int f = 0; f < frames; f ++) {
+            float t = f * dt;
+            float angle = glm::radians(90.0f) * f / frames;
+            glm::vec3 eye(20 * cosf(angle), 3, 20 * sinf(angle));
+            glm::mat4 view = glm::lookAt(eye, glm::vec3(0, -4, 0), glm::vec3(0, 1, 0));
+
+            const vector<int>& picked = scheduler.schedule(tiles, view, projection, &grid.x[0], &grid.y[0], bound, t);
+            const SchedulerFrame& frame = scheduler.lastFrame();
+
+            // frames every tile has stayed in view without an update
+            Frustum frustum(projection * view);
+            for (int k = 0; k < tiles.count(); k ++) {
+                glm::vec3 lower, upper;
+                tiles.bounds(k, &grid.x[0], &grid.y[0], bound, lower, upper);
+                waiting[k] = (frustum.intersects(lower, upper) && !scheduler.scheduledMask()[k]) ? waiting[k] + 1 : 0;
+                wait = std::max(wait, waiting[k]);
+            }
+
+            // only the spans under the picked tiles, as Water::fillSpans
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < grid.dim; i ++) {
+                tiles.spans(i, scheduler.scheduledMask(), spans);
+                for (size_t s = 0; s < spans.size(); s ++) {
+                    int n = spans[s].y - spans[s].x + 1;
+                    waves.field.evaluateRow(grid.x[i], &grid.y[spans[s].x], n, t, &h[0], &sx[0], &sy[0]);
+                }
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            scheduler.record(modeled ? frame.vertices * modelMsPerVertex : elapsed.count(), frame.vertices);
+
+            if (f > 0) {
+                estimatedSum += frame.estimatedMs;
+                actualSum += elapsed.count();
+                over += (picked.size() > 1 && frame.estimatedMs > budget * (1 + 1e-9));
+            }
+            scheduledSum += frame.scheduled;
+            candidateSum += frame.candidates;
+            stalest = std::max(stalest, frame.maxStaleness);
+        }
+
+        string label = modeled ? std::to_string((int)(100 * shares[run])) + "%" : "fixed";
+        printf("  %-10s %9.3f %6.1f/%5.1f %8.3f ms %8.3f ms %11d %6.0f ms %6d fr\n", label.c_str(), budget, (double)scheduledSum / frames,
+               (double)candidateSum / frames, estimatedSum / (frames - 1), actualSum / (frames - 1), over, 1000.0 * stalest, wait);
+
+        if (modeled)
+            pass = pass && over == 0 && wait <= BENCH_BUDGET_MAX_WAIT;
+    }
+
+    printf("  every frame within budget, no tile in view waiting over %d frames: %s\n", BENCH_BUDGET_MAX_WAIT, pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+/**
+ * @brief Unit normal of an octahedral encoding, as water.vs decodes it
+ */
+static void octahedralDecode(float ex, float ey, double n[3]) {
+    n[0] = ex; n[1] = ey; n[2] = 1.0 - fabs(ex) - fabs(ey);
+    if (n[2] < 0) {
+        double x = (1.0 - fabs(ey)) * (ex >= 0 ? 1 : -1), y = (1.0 - fabs(ex)) * (ey >= 0 ? 1 : -1);
+        n[0] = x; n[1] = y;
+    }
+    double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    n[0] /= length; n[1] /= length; n[2] /= length;
+}
+
+/**
+ * @brief Angle in degrees between a normal and (-dhdx, -dhdy, 1) (atan2 of the cross and dot products, precise at small angles)
+ */
+static double normalAngle(const double n[3], double dhdx, double dhdy) {
+    double a[3] = { -dhdx, -dhdy, 1 };
+    double cx = a[1] * n[2] - a[2] * n[1], cy = a[2] * n[0] - a[0] * n[2], cz = a[0] * n[1] - a[1] * n[0];
+    double dot = a[0] * n[0] + a[1] * n[1] + a[2] * n[2];
+    return atan2(sqrt(cx * cx + cy * cy + cz * cz), dot) * 180.0 / M_PI;
+}
+
+/**
+ * @brief Snaps the benchmark waves to a loop of WAVECACHE_PERIOD seconds over the benchmark grid (as Water::setPeriodicWaves does), reporting how
+ *        far their wave vectors and angular speeds moved, and checks the surface repeats one period later in time, along x and along y. Then bakes
+ *        WAVECACHE_FRAMES frames of a BENCH_LOOP_DIM grid to a cache file, checks a cache for other frames is rejected, and compares the baked
+ *        frames (exactly as water.vs decodes them) and the blends halfway between them against the waves. Also reports the cost of evaluating a
+ *        frame of the full benchmark grid against the bytes a second the loop uploads instead
+ * 
+ * @return bool whether the waves repeat, the cache round trips and every baked frame is within BENCH_PACKED_HEIGHT_STEPS and BENCH_LOOP_ANGLE_TOL
+ */
+bool benchWaveLoop() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    float period = WAVECACHE_PERIOD;
+
+    // snapped copy of the waves
+    BenchWaves loop(BENCH_WAVES, BENCH_MAXA);
+    loop.field.clear();
+    double moved = 0, retimed = 0;
+    for (int i = 0; i < BENCH_WAVES; i ++) {
+        snapToLoop(loop.w[i], loop.Dx[i], loop.Dy[i], loop.S[i], BENCH_SIZE, BENCH_SIZE, period, true);
+        loop.field.addWave(loop.A[i], loop.w[i], loop.Dx[i], loop.Dy[i], loop.S[i]);
+
+        double kx = waves.w[i] * waves.Dx[i], ky = waves.w[i] * waves.Dy[i];
+        double lx = loop.w[i] * loop.Dx[i], ly = loop.w[i] * loop.Dy[i];
+        moved = fmax(moved, sqrt((lx - kx) * (lx - kx) + (ly - ky) * (ly - ky)) / sqrt(kx * kx + ky * ky));
+        retimed = fmax(retimed, fabs((double)loop.S[i] - waves.S[i]) / waves.S[i]);
+    }
+
+    // one period later in time, and one grid over along x and y
+    double drift[3] = { 0, 0, 0 };
+    for (int a = 0; a < 16; a ++) {
+        for (int b = 0; b < 16; b ++) {
+            float x = -BENCH_SIZE / 2 + a * BENCH_SIZE / 16.0f, y = -BENCH_SIZE / 2 + b * BENCH_SIZE / 16.0f, t = 3.7f * (a + b);
+            double h, dx, dy, ht, hx, hy;
+            loop.reference(x, y, t, h, dx, dy);
+            loop.reference(x, y, t + period, ht, dx, dy);
+            loop.reference(x + BENCH_SIZE, y, t, hx, dx, dy);
+            loop.reference(x, y + BENCH_SIZE, t, hy, dx, dy);
+            drift[0] = fmax(drift[0], fabs(ht - h));
+            drift[1] = fmax(drift[1], fabs(hx - h));
+            drift[2] = fmax(drift[2], fabs(hy - h));
+        }
+    }
+    bool periodic = drift[0] <= BENCH_LOOP_TOL && drift[1] <= BENCH_LOOP_TOL && drift[2] <= BENCH_LOOP_TOL;
+
+    printf("loop: %d waves snapped to %.0f s over %dx%d m, wave vectors moved up to %.1f%%, speeds up to %.1f%%\n", BENCH_WAVES, period, BENCH_SIZE,
+           BENCH_SIZE, 100 * moved, 100 * retimed);
+    printf("  height one period later %.2e m, one grid over along x %.2e m, along y %.2e m %s\n", drift[0], drift[1], drift[2], periodic ? "PASS" : "FAIL");
+
+    // bake a small grid
+    BenchGrid grid(BENCH_LOOP_DIM, BENCH_SIZE);
+    float bound = 0;
+    for (int i = 0; i < BENCH_WAVES; i ++)
+        bound += loop.A[i];
+    WaveCacheInfo info = { grid.dim, grid.dim, WAVECACHE_FRAMES, period, bound, 1234u };
+    const char* path = "bench_loop.cache";
+
+    vector<float> h(grid.dim), dhdx(grid.dim), dhdy(grid.dim);
+    auto produce = [&](float t, float* surface) {
+        for (int i = 0; i < grid.dim; i ++) {
+            loop.field.evaluateRow(grid.x[i], &grid.y[0], grid.dim, t, &h[0], &dhdx[0], &dhdy[0]);
+            for (int j = 0; j < grid.dim; j ++) {
+                float* vertex = surface + ((size_t)i * grid.dim + j) * 4;
+                vertex[0] = h[j]; vertex[1] = 0 - dhdx[j]; vertex[2] = 0 - dhdy[j]; vertex[3] = 1;
+            }
+        }
+    };
+
+    bool baked = false;
+    auto start = std::chrono::steady_clock::now();
+    baked = WaveCache::bake(path, info, produce);
+    std::chrono::duration<double, std::milli> bakeMs = std::chrono::steady_clock::now() - start;
+
+    WaveCache cache;
+    WaveCacheInfo other = info;
+    other.frames ++;
+    bool rejects = !cache.open(path, other);
+    bool opened = baked && cache.open(path, info);
+
+    printf("  baked %d frames of %dx%d in %.1f ms: %.2f MB (%d bytes a vertex), reopened %s, other frames rejected %s\n", info.frames, grid.dim, grid.dim,
+           bakeMs.count(), info.frames * cache.frameBytes() / (1024.0 * 1024.0), WAVECACHE_VERTEX_BYTES, opened ? "PASS" : "FAIL", rejects ? "PASS" : "FAIL");
+
+    // baked frames, and blends halfway between two of them (the last one blends into the first), against the waves
+    double heightErr = 0, angleErr = 0, blendHeightErr = 0, blendAngleErr = 0;
+    float scale = bound / SIMD_SNORM16_MAX;
+    for (int f = 0; opened && f < info.frames; f += 7) {
+        for (int half = 0; half < 2; half ++) {
+            float t = (f + 0.5f * half) * period / info.frames, blend;
+            int frame = cache.frameAt(t, blend);
+            const unsigned char* a = cache.frame(frame);
+            const unsigned char* b = cache.frame(frame + 1);
+
+            for (int i = 0; i < grid.dim; i += 3) {
+                for (int j = 0; j < grid.dim; j += 3) {
+                    size_t k = ((size_t)i * grid.dim + j) * WAVECACHE_VERTEX_BYTES;
+                    int16_t ha, hb;
+                    memcpy(&ha, a + k, sizeof(ha));
+                    memcpy(&hb, b + k, sizeof(hb));
+                    double na[3], nb[3], n[3];
+                    octahedralDecode(fmax((int8_t)a[k + 2] / 127.0, -1.0), fmax((int8_t)a[k + 3] / 127.0, -1.0), na);
+                    octahedralDecode(fmax((int8_t)b[k + 2] / 127.0, -1.0), fmax((int8_t)b[k + 3] / 127.0, -1.0), nb);
+                    double height = (fmax(ha / SIMD_SNORM16_MAX, -1.0) * (1 - blend) + fmax(hb / SIMD_SNORM16_MAX, -1.0) * blend) * bound;
+                    for (int c = 0; c < 3; c ++)
+                        n[c] = na[c] * (1 - blend) + nb[c] * blend;
+
+                    double rh, rdx, rdy;
+                    loop.reference(grid.x[i], grid.y[j], t, rh, rdx, rdy);
+                    if (half) {
+                        blendHeightErr = fmax(blendHeightErr, fabs(height - rh));
+                        blendAngleErr = fmax(blendAngleErr, normalAngle(n, rdx, rdy));
+                    } else {
+                        heightErr = fmax(heightErr, fabs(height - rh));
+                        angleErr = fmax(angleErr, normalAngle(n, rdx, rdy));
+                    }
+                }
+            }
+        }
+    }
+    bool accurate = opened && heightErr / scale <= BENCH_PACKED_HEIGHT_STEPS && angleErr <= BENCH_LOOP_ANGLE_TOL;
+    printf("  baked frames: height %.2e m (%.3f steps), normal %.3f deg %s\n", heightErr, heightErr / scale, angleErr, accurate ? "PASS" : "FAIL");
+    printf("  halfway between frames: height %.2e m (%.1f%% of the bound), normal %.3f deg\n", blendHeightErr, 100 * blendHeightErr / bound, blendAngleErr);
+    cache.close();
+    remove(path);
+
+    // playing against evaluating the full grid
+    BenchGrid full(BENCH_DIM, BENCH_SIZE);
+    vector<float> fh(full.dim), fx(full.dim), fy(full.dim);
+    double evalMs = timeMs([&]() {
+        for (int i = 0; i < full.dim; i ++)
+            loop.field.evaluateRow(full.x[i], &full.y[0], full.dim, 12.5f, &fh[0], &fx[0], &fy[0]);
+    });
+    double frameMB = (double)full.dim * full.dim * WAVECACHE_VERTEX_BYTES / (1024.0 * 1024.0);
+    printf("  %dx%d grid: %.3f ms evaluating a frame, against playing %.1f MB of frames on disk and uploading %.2f MB a second (a pair of frames every %.0f ms)\n",
+           full.dim, full.dim, evalMs, frameMB * WAVECACHE_FRAMES, 2 * frameMB * WAVECACHE_FRAMES / period, 1000.0 * period / WAVECACHE_FRAMES);
+
+    return periodic && opened && rejects && accurate;
+}
+
+/**
+ * @brief Runs the caustics producer over the benchmark water for BENCH_CAUSTICS_TICKS ticks of a 60 Hz loop, against a fake GPU lagging 0 to 3
+ *        frames behind: cost of a tick on the render thread (update) against the worker's cost of a map (what regenerating it on the render thread
+ *        would cost every tick), maps requested, uploaded, dropped for a newer one and ticks the worker or the buffers were busy, and how many ticks
+ *        old the uploaded map is. Every few ticks the uploaded map is compared byte for byte with the map generated at its time, and the map of
+ *        still water is checked to hold the upward normal in every texel
+ * 
+ * @return bool whether still water encodes exactly, every uploaded map matches and maps keep flowing (at least one upload every
+ *         BENCH_CAUSTICS_MAX_GAP ticks) at every latency
+ */
+bool benchCaustics() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    glm::vec2 origin(0 - BENCH_SIZE / 2, 0 - BENCH_SIZE / 2), size(BENCH_SIZE, BENCH_SIZE);
+    float tick = 1.0f / 60;
+
+    CausticsProducer reference(waves.field, BENCH_DIM, BENCH_DIM, origin, size);
+    vector<unsigned char> expected(reference.bytes());
+    double generateMs = timeMs([&]() { reference.generate(12.5f, &expected[0]); });
+
+    printf("caustics: %dx%d normal map (%.2f MB), %d waves, %d ticks at 60 Hz; %.3f ms a map on the render thread\n", BENCH_DIM, BENCH_DIM,
+           reference.bytes() / (1024.0 * 1024.0), BENCH_WAVES, BENCH_CAUSTICS_TICKS, generateMs);
+    printf("  %-8s %10s %10s %10s %6s %6s %6s %6s %8s %8s %s\n", "latency", "update", "max", "worker", "req", "up", "drop", "busy", "age", "gap", "maps");
+
+    // still water encodes as the upward normal (0, 0, 1) in every texel, without overflowing a byte
+    WaveField flat;
+    CausticsProducer still(flat, BENCH_DIM, BENCH_DIM, origin, size);
+    vector<unsigned char> stillMap(still.bytes());
+    still.generate(0, &stillMap[0]);
+    bool upward = true;
+    for (size_t k = 0; k < stillMap.size(); k += CAUSTICS_TEXEL_BYTES)
+        upward = upward && stillMap[k] == 128 && stillMap[k + 1] == 128 && stillMap[k + 2] == 255;
+
+    bool pass = upward;
+    for (int latency = 0; latency <= 3; latency ++) {
+        FakeStreamBackend backend(latency);
+        CausticsProducer producer(waves.field, BENCH_DIM, BENCH_DIM, origin, size);
+        producer.start(0, &backend);
+
+        double totalMs = 0, maxMs = 0, age = 0;
+        int gap = 0, maxGap = 0, checked = 0, shown = 0;
+        long uploads = 0;
+        bool matches = true;
+        float t = 12.5f;
+        for (int k = 0; k < BENCH_CAUSTICS_TICKS; k ++) {
+            auto start = std::chrono::steady_clock::now();
+            producer.update(t);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            totalMs += elapsed.count();
+            maxMs = fmax(maxMs, elapsed.count());
+
+            gap = producer.uploaded() > uploads ? 0 : gap + 1;
+            maxGap = std::max(maxGap, gap);
+            uploads = producer.uploaded();
+            if (producer.uploadedMap()) {
+                age += (t - producer.uploadedTime()) / tick;
+                shown ++;
+                if (k % 10 == 0) {
+                    reference.generate(producer.uploadedTime(), &expected[0]);
+                    matches = matches && memcmp(producer.uploadedMap(), &expected[0], expected.size()) == 0;
+                    checked ++;
+                }
+            }
+
+            // the rest of the tick goes to the render thread's other work (its draws fenced, so the fake GPU lags frames, not uploads)
+            backend.deleteFence(backend.fence());
+            std::this_thread::sleep_until(start + std::chrono::microseconds((long)(tick * 1e6f)));
+            t += tick;
+        }
+        double worker = producer.produceMs();
+        producer.stop();
+
+        bool ok = matches && checked > 0 && maxGap <= BENCH_CAUSTICS_MAX_GAP;
+        pass = pass && ok;
+        printf("  %-8d %7.4f ms %7.4f ms %7.3f ms %6ld %6ld %6ld %6ld %8.1f %8d %d %s\n", latency, totalMs / BENCH_CAUSTICS_TICKS, maxMs, worker,
+               producer.requested(), producer.uploaded(), producer.dropped(), producer.busy(), age / std::max(1, shown),
+               maxGap, checked, ok ? "PASS" : "FAIL");
+    }
+    printf("  still water encoded as (128, 128, 255) in every texel %s\n", upward ? "PASS" : "FAIL");
+    return pass;
+}
+
+/**
+ * @brief Renders the CPU caustics reference (CausticReference) of the benchmark waves on a BENCH_REF_DIM receiver grid 20 m down, lit like the
+ *        kernel's scene. Checks still water comes out 1 on average, reports cost against error (RMS against a golden image of
+ *        BENCH_REF_GOLDEN_SAMPLES directions, another seed) for growing sample counts along with the error of ignoring caustics, checks the image
+ *        is identical on 1 and every hardware thread and round trips through a PFM, and leaves the golden image in bench_caustics.pfm
+ * 
+ * @return bool whether still water is within BENCH_REF_STILL_TOL of 1, more samples cut the error, and the threads and the file agree
+ */
+bool benchCausticReference() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    glm::vec2 origin(0 - BENCH_SIZE / 2, 0 - BENCH_SIZE / 2), size(BENCH_SIZE, BENCH_SIZE);
+    glm::vec3 sun(1, 5, 1);
+    int dim = BENCH_REF_DIM;
+    size_t texels = (size_t)dim * dim;
+    ThreadPool pool;
+
+    printf("caustic reference: %dx%d receivers %.0f m down, %d waves, sun %.3f rad, %d threads\n", dim, dim, CAUSTICREF_DEPTH, BENCH_WAVES,
+           CAUSTICREF_SUN_RADIUS, pool.size());
+
+    // still water
+    WaveField flat;
+    CausticReference still(flat, origin, size);
+    still.setLight(sun);
+    still.setSamples(64);
+    vector<float> image(texels);
+    still.render(12.5f, dim, dim, &image[0], &pool);
+    double mean = 0, spread = 0;
+    for (size_t k = 0; k < texels; k ++) {
+        mean += image[k] / texels;
+        spread = fmax(spread, fabs(image[k] - 1.0));
+    }
+    bool calm = fabs(mean - 1) <= BENCH_REF_STILL_TOL;
+    printf("  still water: mean %.4f, furthest texel %.4f from 1 %s\n", mean, spread, calm ? "PASS" : "FAIL");
+
+    // golden image
+    CausticReference reference(waves.field, origin, size);
+    reference.setLight(sun);
+    reference.setSamples(BENCH_REF_GOLDEN_SAMPLES);
+    reference.setSeed(7);
+    vector<float> golden(texels);
+    auto start = std::chrono::steady_clock::now();
+    reference.render(12.5f, dim, dim, &golden[0], &pool);
+    std::chrono::duration<double, std::milli> goldenMs = std::chrono::steady_clock::now() - start;
+
+    double contrast = 0, goldenMean = 0;
+    for (size_t k = 0; k < texels; k ++) {
+        contrast += (golden[k] - 1.0) * (golden[k] - 1.0) / texels;
+        goldenMean += golden[k] / texels;
+    }
+    printf("  golden: %d directions in %.0f ms, mean %.4f; no caustics (1 everywhere) is %.4f RMS off\n", BENCH_REF_GOLDEN_SAMPLES, goldenMs.count(),
+           goldenMean, sqrt(contrast));
+    printf("  %-10s %10s %10s %10s\n", "samples", "render", "mean", "RMS err");
+
+    // cost against error
+    reference.setSeed(1);
+    double firstErr = 0, lastErr = 0;
+    int counts[4] = { 16, 64, 256, 1024 };
+    for (int c = 0; c < 4; c ++) {
+        reference.setSamples(counts[c]);
+        start = std::chrono::steady_clock::now();
+        reference.render(12.5f, dim, dim, &image[0], &pool);
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+
+        double err = 0, sum = 0;
+        for (size_t k = 0; k < texels; k ++) {
+            err += (image[k] - golden[k]) * (image[k] - golden[k]) / texels;
+            sum += image[k] / texels;
+        }
+        err = sqrt(err);
+        if (c == 0)
+            firstErr = err;
+        lastErr = err;
+        printf("  %-10d %7.0f ms %10.4f %10.4f\n", counts[c], ms.count(), sum, err);
+    }
+    bool converges = lastErr < firstErr;
+
+    // the same texels on one thread
+    vector<float> single(texels);
+    reference.render(12.5f, dim, dim, &single[0]);
+    bool identical = memcmp(&single[0], &image[0], texels * sizeof(float)) == 0;
+
+    // golden image to disk and back
+    const char* path = "bench_caustics.pfm";
+    int width = 0, height = 0;
+    vector<float> loaded;
+    bool saved = CausticReference::writeImage(path, dim, dim, &golden[0]) && CausticReference::readImage(path, width, height, loaded)
+        && width == dim && height == dim && memcmp(&loaded[0], &golden[0], texels * sizeof(float)) == 0;
+    printf("  converges %s, 1 thread identical %s, %s round trip %s\n", converges ? "PASS" : "FAIL", identical ? "PASS" : "FAIL", path,
+           saved ? "PASS" : "FAIL");
+
+    return calm && converges && identical && saved;
+}
+
+/**
+ * @brief Renders the caustics of the benchmark waves forward (PhotonSplatter) on the receiver grid of benchCausticReference, lit the same. Checks
+ *        still water comes out 1 on average, reports cost against error for growing photon counts next to the backward reference at
+ *        BENCH_PHOTON_REF_SAMPLES directions, both against the golden image of texel centers (as benchCausticReference) and of texel averages
+ *        (BENCH_PHOTON_SUPERSAMPLE x BENCH_PHOTON_SUPERSAMPLE receivers a texel), and checks the image is identical with SSE2 and scalar batches
+ *        and on 1 and every hardware thread
+ * 
+ * @return bool whether still water is within BENCH_REF_STILL_TOL of 1, more photons cut the error against texel averages, and the batches and
+ *         threads agree
+ */
+bool benchPhotons() {
+    BenchWaves waves(BENCH_WAVES, BENCH_MAXA);
+    glm::vec2 origin(0 - BENCH_SIZE / 2, 0 - BENCH_SIZE / 2), size(BENCH_SIZE, BENCH_SIZE);
+    glm::vec3 sun(1, 5, 1);
+    int dim = BENCH_REF_DIM, fine = BENCH_PHOTON_SUPERSAMPLE;
+    size_t texels = (size_t)dim * dim;
+    ThreadPool pool;
+
+    printf("photon caustics: %dx%d receivers %.0f m down, %d waves, sun %.3f rad, %d threads\n", dim, dim, CAUSTICREF_DEPTH, BENCH_WAVES,
+           CAUSTICREF_SUN_RADIUS, pool.size());
+
+    // still water
+    WaveField flat;
+    PhotonSplatter still(flat, origin, size);
+    still.setLight(sun);
+    still.setPhotons(256);
+    vector<float> image(texels);
+    still.render(12.5f, dim, dim, &image[0], &pool);
+    double mean = 0, spread = 0;
+    for (size_t k = 0; k < texels; k ++) {
+        mean += image[k] / texels;
+        spread = fmax(spread, fabs(image[k] - 1.0));
+    }
+    bool calm = fabs(mean - 1) <= BENCH_REF_STILL_TOL;
+    printf("  still water: mean %.4f, furthest texel %.4f from 1 %s\n", mean, spread, calm ? "PASS" : "FAIL");
+
+    // golden images: texel centers (as benchCausticReference), and texel averages over a finer grid
+    CausticReference reference(waves.field, origin, size);
+    reference.setLight(sun);
+    reference.setSamples(BENCH_REF_GOLDEN_SAMPLES);
+    reference.setSeed(7);
+    vector<float> golden(texels), box(texels), sub(texels * fine * fine);
+    reference.render(12.5f, dim, dim, &golden[0], &pool);
+    reference.setSamples(BENCH_PHOTON_BOX_SAMPLES);
+    reference.render(12.5f, dim * fine, dim * fine, &sub[0], &pool);
+    for (int v = 0; v < dim; v ++) {
+        for (int u = 0; u < dim; u ++) {
+            double sum = 0;
+            for (int a = 0; a < fine; a ++) {
+                for (int b = 0; b < fine; b ++)
+                    sum += sub[(size_t)(v * fine + a) * dim * fine + u * fine + b];
+            }
+            box[(size_t)v * dim + u] = (float)(sum / (fine * fine));
+        }
+    }
+
+    // RMS of an image against each golden image
+    auto rms = [&](const vector<float>& against) {
+        double err = 0;
+        for (size_t k = 0; k < texels; k ++)
+            err += (image[k] - against[k]) * (image[k] - against[k]) / texels;
+        return sqrt(err);
+    };
+    printf("  golden: texel centers (%d directions) and averages (%dx%d x %d directions) %.4f RMS apart\n", BENCH_REF_GOLDEN_SAMPLES, fine, fine,
+           BENCH_PHOTON_BOX_SAMPLES, (image = golden, rms(box)));
+
+    reference.setSamples(BENCH_PHOTON_REF_SAMPLES);
+    reference.setSeed(1);
+    auto start = std::chrono::steady_clock::now();
+    reference.render(12.5f, dim, dim, &image[0], &pool);
+    std::chrono::duration<double, std::milli> referenceMs = std::chrono::steady_clock::now() - start;
+    printf("  %-10s %10s %10s %10s %10s %10s %10s\n", "photons", "render", "per texel", "landed", "mean", "RMS center", "RMS avg");
+    printf("  %-10s %7.1f ms %10d %10s %10s %10.4f %10.4f\n", "backward", referenceMs.count(), BENCH_PHOTON_REF_SAMPLES, "-", "-", rms(golden),
+           rms(box));
+
+    // cost against error
+    PhotonSplatter photons(waves.field, origin, size);
+    photons.setLight(sun);
+    double firstErr = 0, lastErr = 0;
+    int counts[] = BENCH_PHOTON_COUNTS;
+    int runs = sizeof(counts) / sizeof(counts[0]);
+    for (int c = 0; c < runs; c ++) {
+        photons.setPhotons(counts[c]);
+        start = std::chrono::steady_clock::now();
+        photons.render(12.5f, dim, dim, &image[0], &pool);
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+
+        double sum = 0;
+        for (size_t k = 0; k < texels; k ++)
+            sum += image[k] / texels;
+        double err = rms(box);
+        if (c == 0)
+            firstErr = err;
+        lastErr = err;
+        printf("  %-10ld %7.1f ms %10.1f %9.1f%% %10.4f %10.4f %10.4f\n", photons.emitted(), ms.count(), (double)photons.landed() / texels,
+               100.0 * photons.landed() / photons.emitted(), sum, rms(golden), err);
+    }
+    bool converges = lastErr < firstErr;
+    printf("  photons emitted up to %.2f m beyond the water\n", photons.emissionMargin());
+
+    // the same texels from scalar batches, and on one thread
+    vector<float> scalar(texels), single(texels);
+    SimdLevel level = simdSetLevel(SIMD_SCALAR);
+    photons.render(12.5f, dim, dim, &scalar[0], &pool);
+    simdSetLevel(level);
+    bool batches = memcmp(&scalar[0], &image[0], texels * sizeof(float)) == 0;
+    photons.render(12.5f, dim, dim, &single[0]);
+    bool identical = memcmp(&single[0], &image[0], texels * sizeof(float)) == 0;
+    printf("  converges %s, scalar batches identical %s, 1 thread identical %s\n", converges ? "PASS" : "FAIL", batches ? "PASS" : "FAIL",
+           identical ? "PASS" : "FAIL");
+
+    return calm && converges && batches && identical;
+}
+
+/**
+ * @brief Reports the level of detail policy of the tessellated water (TessellationPolicy, the CPU model of water.tcs) for the default patch grid
+ *        over the benchmark water, seen from above its center at rising heights: triangles against the fixed mesh, range of factors and on-screen
+ *        pixels per triangle. Then checks that neighbouring patches agree on every shared edge, that factors never grow with distance and stay
+ *        within [1, maxLevel], and that patchTriangles counts uniform tessellations exactly
+ * 
+ * @return bool whether every check passes
+ */
+bool benchTessellation() {
+    TessellationPolicy policy;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    glm::vec2 origin(-BENCH_SIZE / 2, -BENCH_SIZE / 2), size(BENCH_SIZE, BENCH_SIZE);
+    glm::vec2 patchSize = size / (float)TESS_PATCHES;
+    long mesh = 2L * (BENCH_DIM - 1) * (BENCH_DIM - 1);
+
+    printf("tessellation: %dx%d patches over %dx%d water, %.0f px edges, 1080 px viewport (fixed mesh: %ld triangles)\n", TESS_PATCHES, TESS_PATCHES,
+           BENCH_SIZE, BENCH_SIZE, policy.edgePixels(), mesh);
+    printf("  %-8s %10s %8s %9s %9s %10s\n", "height", "triangles", "of mesh", "min f", "max f", "px/tri");
+
+    bool cracks = false, bounded = true;
+    float heights[6] = { 1, 5, 20, 80, 200, 400 };
+    for (int h = 0; h < 6; h ++) {
+        glm::vec3 camera(0, heights[h], 0);
+        policy.setView(projection, camera, 1080.0f);
+
+        float minF = TESS_MAX_LEVEL, maxF = 1;
+        double pixels = 0;
+        vector<float> outers((size_t)TESS_PATCHES * TESS_PATCHES * 4);
+        for (int i = 0; i < TESS_PATCHES; i ++) {
+            for (int k = 0; k < TESS_PATCHES; k ++) {
+                glm::vec3 corners[4];
+                for (int c = 0; c < 4; c ++) {
+                    glm::vec2 p = origin + glm::vec2(i + (c & 1), k + (c >> 1)) * patchSize;
+                    corners[c] = glm::vec3(p.x, 0.0f, p.y);
+                }
+                float* outer = &outers[((size_t)i * TESS_PATCHES + k) * 4];
+                float inner[2];
+                policy.patchFactors(corners, outer, inner);
+
+                for (int e = 0; e < 4; e ++) {
+                    minF = fminf(minF, outer[e]);
+                    maxF = fmaxf(maxF, outer[e]);
+                    bounded = bounded && outer[e] >= 1 && outer[e] <= policy.maxLevel();
+                }
+
+                // on-screen area of the patch, seen face on from its center
+                glm::vec3 center = (corners[0] + corners[3]) * 0.5f;
+                float d = glm::distance(center, camera);
+                double scale = projection[1][1] * 1080.0 * 0.5 / d;
+                pixels += patchSize.x * patchSize.y * scale * scale * fabs(camera.y - center.y) / d;
+
+                // edge u = 0 is edge u = 1 of the previous patch along x, edge v = 0 edge v = 1 of the previous patch along z
+                if (i > 0 && outer[0] != outers[((size_t)(i - 1) * TESS_PATCHES + k) * 4 + 2])
+                    cracks = true;
+                if (k > 0 && outer[1] != outers[((size_t)i * TESS_PATCHES + k - 1) * 4 + 3])
+                    cracks = true;
+            }
+        }
+
+        long triangles = policy.gridTriangles(origin, size, TESS_PATCHES);
+        printf("  %-8.0f %10ld %7.1f%% %9.2f %9.2f %10.1f\n", heights[h], triangles, 100.0 * triangles / mesh, minF, maxF, pixels / triangles);
+    }
+
+    // factors of the same edge moving away from the camera
+    bool monotone = true;
+    policy.setView(projection, glm::vec3(0, 2, 0), 1080.0f);
+    float last = TESS_MAX_LEVEL;
+    for (float x = 0; x < 2 * TESS_FADE_FAR; x += 0.5f) {
+        float f = policy.edgeFactor(glm::vec3(x, 0, 0), glm::vec3(x, 0, 1));
+        monotone = monotone && f <= last;
+        last = f;
+    }
+    bool faded = (last == 1.0f);
+
+    // a quad at level n everywhere is n x n quads
+    bool counts = true;
+    for (int n = 1; n <= 64; n ++) {
+        float outer[4] = { (float)n, (float)n, (float)n, (float)n }, inner[2] = { (float)n, (float)n };
+        counts = counts && TessellationPolicy::patchTriangles(outer, inner) == 2L * n * n;
+    }
+
+    printf("  shared edges agree: %s, factors within [1, %.0f]: %s, monotone in distance: %s, 1 past fade: %s, uniform counts: %s\n",
+           cracks ? "FAIL" : "pass", policy.maxLevel(), bounded ? "pass" : "FAIL", monotone ? "pass" : "FAIL", faded ? "pass" : "FAIL", counts ? "pass" : "FAIL");
+    return !cracks && bounded && monotone && faded && counts;
+}
+
+/**
+ * @brief Synthesizes the heightfield of each wave family with the compute shader and on the CPU, at the default grid, and compares the two. Needs a
+ *        current OpenGL 4.3 context
+ *
+ * @param computePath Path of the compute shader (shaders/water.cs)
+ * @return bool whether the heights and normals of every family are within BENCH_PARITY_TOL
+ */
+bool checkComputeParity(const char* computePath) {
+    Shader compute(computePath);
+    bool passed = true;
+
+    printf("compute parity: %dx%d grid, %d waves, %s\n", BENCH_DIM, BENCH_DIM, BENCH_WAVES, (const char*)glGetString(GL_RENDERER));
+    printf("  %-24s %9s %9s %9s %7s\n", "family", "err H", "err N", "gpu", "result");
+
+    const char* names[4] = { "directional, rounded", "directional, pointed", "circular, rounded", "circular, pointed" };
+    for (int family = 0; family < 4; family ++) {
+        Water water(0, 0, BENCH_SIZE, BENCH_SIZE, BENCH_DIM, BENCH_DIM, BENCH_MAXA, BENCH_WAVES, family < 2, family % 2 == 0, true);
+        water.setHeightfieldMode(true);
+        water.updateTime(12.5f);
+        water.updateMesh();
+        vector<float> cpu = water.surface;
+
+        // the compute shader overwrites the same texture
+        auto start = std::chrono::steady_clock::now();
+        water.setComputeShader(&compute);
+        vector<float> gpu(cpu.size());
+        glBindTexture(GL_TEXTURE_2D, water.heightfieldTexture());
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, &gpu[0]);
+        std::chrono::duration<double, std::milli> gpuMs = std::chrono::steady_clock::now() - start;
+
+        double errH = 0, errN = 0;
+        for (size_t k = 0; k < cpu.size(); k += WATER_DYNAMIC_FLOATS) {
+            errH = fmax(errH, fabs(gpu[k] - cpu[k]));
+            for (int c = 1; c < WATER_DYNAMIC_FLOATS; c ++)
+                errN = fmax(errN, fabs(gpu[k + c] - cpu[k + c]));
+        }
+
+        // NaN compares false, so it fails too
+        bool ok = (errH <= BENCH_PARITY_TOL && errN <= BENCH_PARITY_TOL);
+        passed = passed && ok;
+        printf("  %-24s %9.2e %9.2e %6.1f ms %7s\n", names[family], errH, errN, gpuMs.count(), ok ? "pass" : "FAIL");
+    }
+    return passed;
+}
+
+/**
+ * @brief Runs checkComputeParity in a hidden window's OpenGL 4.3 core context. Runs headless under Mesa llvmpipe (LIBGL_ALWAYS_SOFTWARE=1, with
+ *        SDL_VIDEODRIVER=offscreen where there is no display)
+ *
+ * @return bool whether every family is within BENCH_PARITY_TOL (true, skipped, if no context could be made: there is nothing to compare on)
+ */
+bool benchComputeParity() {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        printf("compute parity: skipped, unable to initialize SDL: %s\n", SDL_GetError());
+        return true;
+    }
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+    SDL_Window* window = SDL_CreateWindow("parity", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext context = window ? SDL_GL_CreateContext(window) : NULL;
+    bool passed = true;
+
+    glewExperimental = GL_TRUE;
+    if (!context) {
+        printf("compute parity: skipped, no OpenGL 4.3 context: %s\n", SDL_GetError());
+    } else if (glewInit() != GLEW_OK) {
+        printf("compute parity: skipped, could not initialize GLEW\n");
+    } else {
+        passed = checkComputeParity("shaders/water.cs");
+    }
+
+    if (context)
+        SDL_GL_DeleteContext(context);
+    if (window)
+        SDL_DestroyWindow(window);
+    SDL_Quit();
+    return passed;
+}
+
+/**
+ * @brief Runs the benchmark called name, or every benchmark for "all" (every one runs even after a check has failed, and sincos samples the
+ *        floats instead of sweeping every one, which only "sincos-exhaustive" does)
+ *
+ * @param name Name of the benchmark
+ * @return BenchStatus BENCH_UNKNOWN if no benchmark had that name, otherwise whether every check of the benchmarks ran passed
+ */
+BenchStatus runBenchmarks(const string& name) {
+    bool all = (name == "all");
+    bool found = false;
+    bool passed = true;
+
+    if (all || name == "sincos") {
+        passed = benchSinCos(BENCH_SINCOS_STRIDE) && passed;
+        found = true;
+    }
+    if (name == "sincos-exhaustive") {
+        passed = benchSinCos(1) && passed;
+        found = true;
+    }
+    if (all || name == "rows") {
+        benchWaveRows();
+        found = true;
+    }
+    if (all || name == "basis") {
+        benchWaveBasis();
+        found = true;
+    }
+    if (all || name == "threads") {
+        passed = benchThreadScaling() && passed;
+        found = true;
+    }
+    if (all || name == "normals") {
+        benchNormals();
+        found = true;
+    }
+    if (all || name == "families") {
+        passed = benchWaveFamilies() && passed;
+        found = true;
+    }
+    if (all || name == "gerstner") {
+        passed = benchGerstner() && passed;
+        found = true;
+    }
+    if (all || name == "ocean") {
+        passed = benchOcean() && passed;
+        found = true;
+    }
+    if (all || name == "streams") {
+        benchVertexStreams();
+        found = true;
+    }
+    if (all || name == "packed") {
+        passed = benchPackedVertices() && passed;
+        found = true;
+    }
+    if (all || name == "ring") {
+        passed = benchStreamRing() && passed;
+        found = true;
+    }
+    if (all || name == "clipmap") {
+        benchClipmap();
+        found = true;
+    }
+    if (all || name == "projected") {
+        passed = benchProjectedGrid() && passed;
+        found = true;
+    }
+    if (all || name == "culling") {
+        passed = benchCulling() && passed;
+        found = true;
+    }
+    if (all || name == "budget") {
+        passed = benchUpdateBudget() && passed;
+        found = true;
+    }
+    if (all || name == "loop") {
+        passed = benchWaveLoop() && passed;
+        found = true;
+    }
+    if (all || name == "caustics") {
+        passed = benchCaustics() && passed;
+        found = true;
+    }
+    if (all || name == "reference") {
+        passed = benchCausticReference() && passed;
+        found = true;
+    }
+    if (all || name == "photons") {
+        passed = benchPhotons() && passed;
+        found = true;
+    }
+    if (all || name == "tess") {
+        passed = benchTessellation() && passed;
+        found = true;
+    }
+    if (all || name == "compute") {
+        passed = benchComputeParity() && passed;
+        found = true;
+    }
+
+    if (!found)
+        return BENCH_UNKNOWN;
+    return passed ? BENCH_PASSED : BENCH_FAILED;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file benchmark.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Headless benchmarks and accuracy reports for the water synthesis paths. Ran with ./EWS.exe --bench [name]; no window is shown, and only the
+ *        GPU parity check creates an (offscreen) OpenGL context
+ * @version 0.1
+ * @date 2022-06-16
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+using std::string;
+
+// default benchmark grid (matches the water constructed in Kernel::start)
+#define BENCH_DIM 500
+#define BENCH_SIZE 50
+#define BENCH_WAVES 20
+#define BENCH_MAXA 0.1f
+
+// number of timed repetitions of every benchmark (the fastest is reported)
+#define BENCH_REPS 5
+
+// sincos error bounds documented in simdmath.h (ulp where |result| >= BENCH_SINCOS_ULP_FLOOR, absolute everywhere)
+#define BENCH_SINCOS_SIN_ULP 1.57
+#define BENCH_SINCOS_COS_ULP 1.55
+#define BENCH_SINCOS_ABS 7.9e-8
+#define BENCH_SINCOS_ULP_FLOOR (1.0 / 1024)
+
+// bit patterns between the floats the sampled sincos check sweeps (prime, so the samples fall all over the mantissa of every binade)
+#define BENCH_SINCOS_STRIDE 257
+
+// largest difference allowed between the GPU and CPU heights and normals
+#define BENCH_PARITY_TOL 1e-3
+
+// largest difference allowed between Gerstner waves of steepness 0 and the sum of sines (vertices and displacements)
+#define BENCH_GERSTNER_TOL 1e-5
+
+// largest difference allowed between the FFT grids of the ocean and the direct sum of its waves (heights, slopes and displacements)
+#define BENCH_OCEAN_TOL 1e-5
+
+// largest height (in snorm16 steps of the amplitude bound: half a step of rounding, plus float rounding) and normal (in degrees) errors allowed
+// between the packed and float dynamic streams
+#define BENCH_PACKED_HEIGHT_STEPS 0.51
+#define BENCH_PACKED_ANGLE_TOL 0.01
+
+// shares of the cost of a whole update of the benchmark grid given as budgets to the time-sliced updates, and the most frames a tile in view may
+// wait for its update under any of them
+#define BENCH_BUDGET_SHARES { 1.0, 0.5, 0.25, 0.1 }
+#define BENCH_BUDGET_MAX_WAIT 60
+
+// vertices a side of the grid baked by the loop benchmark, and the largest normal error (degrees) allowed in a baked frame (snorm8 octahedral)
+#define BENCH_LOOP_DIM 128
+#define BENCH_LOOP_ANGLE_TOL 1.0
+
+// largest difference allowed between the snapped waves one period (of time, or of the grid) apart
+#define BENCH_LOOP_TOL 1e-3
+
+// ticks the caustics producer is run for, and the most ticks in a row it may go without an upload
+#define BENCH_CAUSTICS_TICKS 120
+#define BENCH_CAUSTICS_MAX_GAP 4
+
+// receivers a side of the images of the caustics reference, directions integrated for its golden image, and how far from 1 still water may
+// come out on average
+#define BENCH_REF_DIM 24
+#define BENCH_REF_GOLDEN_SAMPLES 4096
+#define BENCH_REF_STILL_TOL 0.02
+
+// photons a side emitted by the photon splatting benchmark, fewest to most, and samples of the backward reference it is set against
+#define BENCH_PHOTON_COUNTS { 64, 128, 256, 512 }
+#define BENCH_PHOTON_REF_SAMPLES 256
+
+// receivers a side of a texel, and directions each, averaged for the golden image of the texels (photons average over a texel, the golden image
+// of benchCausticReference samples its center)
+#define BENCH_PHOTON_SUPERSAMPLE 4
+#define BENCH_PHOTON_BOX_SAMPLES 1024
+
+// outcome of runBenchmarks (the exit status of ./EWS.exe --bench)
+enum BenchStatus {
+    BENCH_PASSED = 0,   // every check of the benchmarks ran passed (or they had none)
+    BENCH_FAILED = 1,   // at least one check failed
+    BENCH_UNKNOWN = 2   // no benchmark has that name
+};
+
+// runs the benchmark called name, or every benchmark for "all"
+BenchStatus runBenchmarks(const string& name);
+
+// sincosArray at every SIMD level the processor has, over every stride-th float with |x| <= SIMD_SINCOS_MAXARG (every float for stride 1, the
+// "sincos-exhaustive" benchmark), against a double precision reference: max ulp and absolute errors, every level bit-identical to scalar.
+// Returns whether every level is within the bounds documented in simdmath.h
+bool benchSinCos(int stride);
+
+// per-point H/N against batched rows and recurrence rows, with max error over the full grid
+void benchWaveRows();
+
+// cached spatial basis against direct rows: build cost, memory, per-frame cost and max error
+void benchWaveBasis();
+
+// per-frame cost of a tiled grid update for 1 to N threads. Returns whether the output is bit-identical for every thread count
+bool benchThreadScaling(int maxThreads = 0);
+
+// spectral ocean: per-frame synthesis cost for several FFT sizes, cost of sampling it onto the default mesh and max error of the FFT grids against a direct sum of every wave.
+// Returns whether every size is within BENCH_OCEAN_TOL and its snapshot (what the caustics producer samples) samples identically to it
+bool benchOcean();
+
+// Gerstner waves against the sum of sines at equal vertex and wave counts: per-frame cost of writing the vertex buffer, deviation at zero steepness and folding at full steepness.
+// Returns whether zero steepness is within BENCH_GERSTNER_TOL of the sum of sines and no steepness folds a crest over
+bool benchGerstner();
+
+// the four wave families (directional/circular x rounded/pointed), each timed a point at a time and a row at a time through the evaluators specialized
+// for it. Returns whether both give bit-identical heights and partials for every family
+bool benchWaveFamilies();
+
+// analytic normals against central differences of the grid of heights, per evaluation mode: per-frame cost and error of the normals against a double precision reference
+void benchNormals();
+
+// interleaved vertices rebuilt every frame against split static (x, z) and dynamic (height, normal) streams: bytes uploaded and per-frame cost
+void benchVertexStreams();
+
+// packed dynamic stream (snorm16 height, octahedral normal) against the float one for every wave family: height and normal errors, scalar and
+// SSE2 packers bit-identical, cost of packing. Returns whether every family is within BENCH_PACKED_HEIGHT_STEPS and BENCH_PACKED_ANGLE_TOL
+bool benchPackedVertices();
+
+// fence logic of the persistently mapped streaming ring against a fake GPU lagging a few frames behind: stalls per ring size. Returns whether
+// the stalls are as expected and no region is ever handed out before the GPU is done with it
+bool benchStreamRing();
+
+// geometry clipmap by number of levels: extent covered, vertices and vertex-wave evaluations per frame against a flat grid of the finest spacing
+void benchClipmap();
+
+// projected grid against flat meshes of growing extent: vertices in view by camera height and pitch, cost of unprojecting and evaluating the grid,
+// no vertex behind the camera and every vertex on its point of the screen. Returns whether every check passes
+bool benchProjectedGrid();
+
+// frustum culling of the tiles of the grid for cameras inside, above and beside the water: tiles and vertices kept, cost of the culled update,
+// no vertex in view ever culled. Returns whether every check passes
+bool benchCulling();
+
+// time-sliced updates (TileScheduler) of the grid under a camera circling it, for budgets that are shares of a whole update and then fixed
+// milliseconds: tiles and vertices per frame, estimated against actual cost, staleness. Checks every frame stays within its budget and no tile in
+// view waits more than BENCH_BUDGET_MAX_WAIT frames. Returns whether every check passes
+bool benchUpdateBudget();
+
+// waves snapped to a loop (snapToLoop) and one period baked to a WaveCache: how far the waves moved, periodicity in time and over the grid, size
+// and cost of baking, error of the baked and blended frames against the waves, bandwidth of playing the loop. Returns whether every check passes
+bool benchWaveLoop();
+
+// caustics normal map regenerated on a worker thread (CausticsProducer) against a fake GPU lagging behind: render thread cost of a tick against
+// the worker's cost of a map, maps handed over and dropped, age of the uploaded map. Returns whether every uploaded map is exact and maps keep flowing
+bool benchCaustics();
+
+// CPU backward Monte Carlo caustics (CausticReference): still water, cost against error for growing sample counts (against a golden image), same
+// image on every thread count, PFM round trip. Returns whether every check passes
+bool benchCausticReference();
+
+// CPU forward photon splatting caustics (PhotonSplatter) against golden backward images (texel centers, and texel averages): still water, cost
+// against error for growing photon counts next to the backward reference, SSE2 and scalar batches identical, same image on every thread count. Returns whether every check passes
+bool benchPhotons();
+
+// level of detail policy of the tessellated water (CPU model of water.tcs): triangles and on-screen density by camera height, crack-free and
+// monotone factors, exact triangle counts. Returns whether every check passes
+bool benchTessellation();
+
+// compute shader synthesis against the CPU, for every wave family, in a hidden window's OpenGL 4.3 context (runs under Mesa llvmpipe). Returns whether
+// every family is within BENCH_PARITY_TOL (skipped, and passing, where no such context can be made)
+bool benchComputeParity();
+
+// same check in the current OpenGL context, with the compute shader at computePath
+bool checkComputeParity(const char* computePath);
+
+#endif
@@ -29,6 +29,14 @@ Kernel::Kernel() {
     rx = 0;
     ry = 0;
     isRunning = false;
+    causticMap = NULL;
+    caustic_shader = NULL;
+    pool = NULL;
+    ocean = NULL;
+    water_compute = NULL;
+    water_tess_shader = NULL;
+    clipmap = NULL;
+    projgrid = NULL;
 }
 
 /**
@@ -188,9 +196,53 @@ void Kernel::start(string title, int resx, int resy) {
     pX = 0; pZ = 0;
     pW = 50; pL = 50;
     pdimX = 500; pdimZ = 500;
-    water = new Water(pX, pZ, pW, pL, pdimX, pdimZ, 0.1f, 20, true, true, false);
+    water = new Water(pX, pZ, pW, pL, pdimX, pdimZ, 0.1f, 20, true, true, true);
+    pool = new ThreadPool();
+    water->setThreadPool(pool);
+
+    // Uncomment to write the dynamic vertex streams straight into a persistently mapped ring (stays on glBufferSubData without OpenGL 4.4)
+    //water->setStreaming(true);
+
+    // Uncomment to pack the dynamic vertex stream: 16 bit heights and octahedral normals, 8 bytes per vertex instead of 16
+    //water->setPackedVertices(true);
+
+    // Uncomment to skip the tiles of the mesh outside the view frustum (not drawn, and not evaluated with analytic normals and direct or
+    // recurrence rows; share culled shown in the title)
+    //water->setCulling(true);
+
+    // Uncomment to hold updates of the mesh to a budget of milliseconds: only the tiles largest on screen and longest since their last update
+    // are evaluated every frame (tiles updated per frame shown in the title)
+    //water->setUpdateBudget(SCHEDULER_BUDGET_MS);
+
+    // Uncomment to loop the same sea forever at no synthesis cost: the waves are snapped to repeat every WAVECACHE_PERIOD seconds (and over the
+    // body of water), and one period of frames is baked into water.cache once, then played from the mapped file
+    //water->setPeriodicWaves(WAVECACHE_PERIOD);
+    //water->setWaveCache("water.cache");
+
+    // Uncomment for the spectral ocean tiling the whole body of water: 256 x 256 waves (Phillips spectrum, 8 m/s wind)
+    //ocean = new Ocean(256, (float)pW, OCEAN_PHILLIPS, 8.0f, 1.0f, 1.0f, 1e-4f, 0.5f);
+    //water->setOcean(ocean);
+
+    // Uncomment to draw the water from a heightfield texture (no vertex or index buffers; also replaces the normal map of the rocks)
+    //water->setHeightfieldMode(true);
     water_shader = new Shader("shaders/water.vs", "shaders/water.fs");
 
+    // Uncomment to synthesize the water on the GPU (heightfield mode, nothing uploaded per frame)
+    //water_compute = new Shader("shaders/water.cs");
+    //water->setComputeShader(water_compute);
+
+    // Uncomment to draw the water as a coarse grid of patches tessellated by distance and on-screen size (waves evaluated per generated vertex)
+    //water_tess_shader = new Shader("shaders/water_tess.vs", "shaders/water.tcs", "shaders/water.tes", "shaders/water.fs");
+    //water->setTessellation(TESS_PATCHES);
+
+    // Uncomment to draw the water as clipmap levels following the camera: 8 levels of 129 x 129 vertices, 10 cm apart at the finest (1.6 km across)
+    //clipmap = new Clipmap(CLIPMAP_LEVELS, CLIPMAP_RESOLUTION, 0.1f);
+    //water->setClipmap(clipmap);
+
+    // Uncomment to draw the water from a 256 x 256 grid of the screen unprojected onto the water plane every frame (out to the far plane)
+    //projgrid = new ProjectedGrid(PROJECTED_COLUMNS, PROJECTED_ROWS);
+    //water->setProjectedGrid(projgrid);
+
     // Generate water height/normal map texture <NORMAL.X, NORMAL.Y, NORMAL.Z> (height is irrelevant because all vectors point straight up anyhow)
     //Uint32 rmask, bmask, gmask, amask;
     //rmask = 0xff000000 >> 8;
@@ -198,18 +250,12 @@ void Kernel::start(string title, int resx, int resy) {
     //bmask = 0x0000ff00 >> 8;
     //amask = 0x000000ff >> 8;
 
-    unsigned char* data = new unsigned char[pdimX * pdimZ * 3];
-    for (int i = 0; i < pdimX; i ++) {
-        for (int j = 0; j < pdimZ; j ++) {
-            float x = pX - pW / 2 + (float)i * pW / pdimX;
-            float z = pZ - pL / 2 + (float)j * pL / pdimZ;
-
-            glm::vec3 normal = water->N(x, z, 0);
-            data[i * pdimZ*3 + j*3 + 0] = (unsigned char)((normal.x / 2 + 0.5) * 256);
-            data[i * pdimZ*3 + j*3 + 1] = (unsigned char)((normal.y / 2 + 0.5) * 256);
-            data[i * pdimZ*3 + j*3 + 2] = (unsigned char)((normal.z / 2 + 0.5) * 256);
-        }
-    }
+    // normal map of the water at t = 0; from then on the producer regenerates it on a worker thread every tick the water moves, from whatever
+    // the water is drawn from (sum of waves, Gerstner waves or the ocean)
+    caustics = new CausticsProducer(water->waveField(), pdimX, pdimZ, water->gridOrigin(), water->gridSize());
+    caustics->follow(water);
+    unsigned char* data = new unsigned char[caustics->bytes()];
+    caustics->generate(0, data);
 
     // Generate additive refraction result texture (basically a shiny dot in the center of the same resolution as the previously generated texture)
     // we can use the same masks!
@@ -243,6 +289,17 @@ void Kernel::start(string title, int resx, int resy) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, pdimX, pdimZ, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+    caustics->start(normalTex);
+
+    // Uncomment to render caustics once per frame into a 512 x 512 map seen from the sun (256 x 256 rays through the water, focused at the depth
+    // of the rocks) instead of refracting a fixed ray per fragment of the rocks, whatever covers the screen
+    //caustic_shader = new Shader("shaders/caustics.vs", "shaders/caustics.fs");
+    //causticMap = new CausticMap(CAUSTICMAP_RESOLUTION, CAUSTICMAP_GRID);
+    //causticMap->setLight(glm::vec3(1, 5, 1));
+    //causticMap->setDepth(CAUSTICMAP_DEPTH);
+    //causticMap->setWater(water->gridOrigin(), water->gridSize());
+    // Uncomment to splat 1024 x 1024 photons as points into the map instead (forward photon splatting, see objects/photons.h for the CPU version)
+    //causticMap->setPhotons(CAUSTICMAP_PHOTONS);
 
     glBindTexture(GL_TEXTURE_2D, refractionTex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -285,7 +342,13 @@ void Kernel::start(string title, int resx, int resy) {
             curFPS = (int)(30/sumFPS);
             sumFPS = 0;
         }
-        string atitle = title + string(" - FPS: ") + std::to_string(curFPS) + string(" - Frame: ") + std::to_string(frame);
+        string atitle = title + string(" - FPS: ") + std::to_string(curFPS) + string(" - Frame: ") + std::to_string(frame) + string(" - Water draws: ") + std::to_string(water->drawCalls());
+        if (water->culling())
+            atitle += string(" - Water culled: ") + std::to_string((int)(100 * water->cullStats().efficiency())) + string("%");
+        if (water->timeSliced())
+            atitle += string(" - Water tiles: ") + std::to_string(water->updateScheduler().lastFrame().scheduled) + string("/") + std::to_string(water->updateScheduler().lastFrame().candidates);
+        if (causticMap)
+            atitle += string(" - Caustics: ") + std::to_string(causticMap->gpuMs()).substr(0, 4) + string(" ms");
         SDL_SetWindowTitle(window, atitle.c_str());
 
         // handle events
@@ -308,15 +371,22 @@ void Kernel::start(string title, int resx, int resy) {
         camera->updateKeyboard(end, dt);
         camera->updateMouse(relX, -relY);
 
-        // update renderer
-        if (frame % 2 == 1) {
-            //update(dt);
-        }
+        // update renderer (every frame, so the water and its caustics keep real time)
+        update(dt);
         render();
     }
 
-    delete data;
-    delete refract;
+    delete[] data;
+    delete[] refract;
+    delete caustics;
+    delete pool;
+    delete causticMap;
+    delete caustic_shader;
+    delete ocean;
+    delete water_compute;
+    delete water_tess_shader;
+    delete clipmap;
+    delete projgrid;
 }
 
 /**
@@ -330,7 +400,7 @@ void Kernel::render() {
     //backpack_shader->use();
 
     // compute matrices
-    glm::mat4 projection = glm::perspective(glm::radians(camera->zoom), (float)rx / (float)ry, 0.1f, 100.0f);
+    glm::mat4 projection = getProjection();
     glm::mat4 view = camera->getViewMatrix();
 
     // loads shaders
@@ -345,6 +415,11 @@ void Kernel::render() {
     //backpack_shader->setMat4("model", model);
     //backpack_model->draw(backpack_shader);
 
+    // light through the water, once per frame whatever covers the screen
+    unsigned int surfaceTex = water->heightfieldTexture() ? water->heightfieldTexture() : normalTex;
+    if (causticMap)
+        causticMap->render(caustic_shader, surfaceTex, water->heightfieldTexture() != 0);
+
     // same thing but for rocks
     rocks_shader->use();
     rocks_shader->setMat4("projection", projection);
@@ -357,21 +432,31 @@ void Kernel::render() {
     rocks_shader->setMat4("model", model);
     rocks_shader->setInt("normal", 1);
     rocks_shader->setInt("refractions", 2);
+    rocks_shader->setBool("surfaceHeightfield", water->heightfieldTexture() != 0);
+    rocks_shader->setVec2("surfaceOrigin", water->gridOrigin());
+    rocks_shader->setVec2("surfaceSize", water->gridSize());
+    rocks_shader->setBool("causticMapped", causticMap != NULL);
+    rocks_shader->setInt("causticMap", 3);
+    if (causticMap)
+        rocks_shader->setMat4("causticSpace", causticMap->lightSpace());
     glActiveTexture(GL_TEXTURE0 + 1);
-    glBindTexture(GL_TEXTURE_2D, normalTex);
+    glBindTexture(GL_TEXTURE_2D, surfaceTex);
     glActiveTexture(GL_TEXTURE0 + 2);
     glBindTexture(GL_TEXTURE_2D, refractionTex);
+    glActiveTexture(GL_TEXTURE0 + 3);
+    glBindTexture(GL_TEXTURE_2D, causticMap ? causticMap->texture() : 0);
     rocks_model->draw(rocks_shader);
 
     // render water
-    water_shader->use();
-    water_shader->setMat4("projection", projection);
-    water_shader->setMat4("view", view);
+    Shader* surface_shader = water->tessellated() ? water_tess_shader : water_shader;
+    surface_shader->use();
+    surface_shader->setMat4("projection", projection);
+    surface_shader->setMat4("view", view);
     model = glm::mat4(1.0f);
-    water_shader->setMat4("model", model);
-    water_shader->setVec3("cameraPos", camera->position);
+    surface_shader->setMat4("model", model);
+    surface_shader->setVec3("cameraPos", camera->position);
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    water->draw(water_shader, skybox->cubeTexture);
+    water->draw(surface_shader, skybox->cubeTexture);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
     // draw skybox last
@@ -387,7 +472,27 @@ void Kernel::render() {
  */
 void Kernel::update(float dt) {
     water->updateTime(dt);
+    water->setView(camera->getViewMatrix(), getProjection());
     water->updateMesh();
+
+    // still water keeps its mesh, so the caustics under it stay still too
+    if (water->animates())
+        caustics->update(water->time());
+}
+
+/**
+ * @brief Projection matrix of the camera (shared by rendering and the water, which unprojects its grid through it)
+ * 
+ * @return glm::mat4
+ */
+glm::mat4 Kernel::getProjection() {
+    // the clipmap and the projected grid reach well past the far plane of the scene
+    float farPlane = 100.0f;
+    if (water->clipmapped())
+        farPlane = clipmap->extent();
+    else if (water->projected())
+        farPlane = 1000.0f;
+    return glm::perspective(glm::radians(camera->zoom), (float)rx / (float)ry, 0.1f, farPlane);
 }
 
 /**
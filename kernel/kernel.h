@@ -28,6 +28,8 @@ using std::string;
 #include "../objects/camera.h"
 #include "../objects/skybox.h"
 #include "../objects/water.h"
+#include "../objects/caustics.h"
+#include "../objects/causticmap.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -49,6 +51,8 @@ class Kernel {
         void handleEvents();
 
     private:
+        glm::mat4 getProjection();
+
         bool isRunning;
         int rx, ry;
 
@@ -62,8 +66,13 @@ class Kernel {
 
         // ---- Objects in kernel ----
 
-        // Rocks (for caustics)
+        // Rocks (for caustics): normal map of the water, regenerated every tick off the render thread
         unsigned int normalTex, refractionTex;
+        CausticsProducer* caustics;
+
+        // Caustic map (light through the water rendered once per frame in the light space of the sun; NULL - the rocks refract a ray per fragment)
+        CausticMap* causticMap;
+        Shader*  caustic_shader;
 
         // Camera
         Camera*  camera;
@@ -71,9 +80,23 @@ class Kernel {
         // Skybox
         Skybox*  skybox;
 
+        // Worker threads (shared by every object updated in parallel)
+        ThreadPool* pool;
+
         // Water
         Water*   water;
         Shader*  water_shader;
+        Shader*  water_compute;
+        Shader*  water_tess_shader;
+
+        // Spectral ocean (FFT synthesized alternative to the sum of waves of the water)
+        Ocean*   ocean;
+
+        // Geometry clipmap (water out to the horizon around the camera)
+        Clipmap* clipmap;
+
+        // Projected grid (water out to the far plane, vertices spread over the screen)
+        ProjectedGrid* projgrid;
 
         // Test backpack model
         Shader*  backpack_shader;
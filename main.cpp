@@ -9,10 +9,21 @@
  */
 
 #include "kernel/kernel.h"
+#include "kernel/benchmark.h"
 
 #include <iostream>
 
 int main(int argc, char* argv[]) {
+    // headless benchmarks (./EWS.exe --bench [name]): exits 1 if a check failed, 2 if no benchmark has that name
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        string name = (argc > 2) ? string(argv[2]) : string("all");
+        BenchStatus status = runBenchmarks(name);
+        if (status == BENCH_UNKNOWN)
+            std::cout << "Unknown benchmark " << name << std::endl;
+        else if (status == BENCH_FAILED)
+            std::cout << "Benchmark checks failed" << std::endl;
+        return status;
+    }
 
     std::cout << "Reached line " << __LINE__ << " in " << __FILE__ << std::endl;
 
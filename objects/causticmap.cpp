@@ -0,0 +1,206 @@
+/**
+ * @file causticmap.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Caustic map: light refracted through the water rendered once per frame into a fixed size texture in the light space of the sun, which
+ *        every receiver projects into like a shadow map
+ * @version 0.1
+ * @date 2022-06-29
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "causticmap.h"
+
+/**
+ * @brief Construct a new CausticMap object: the map texture, its framebuffer, the vertex array without attributes the lattice of rays is drawn
+ *        from and the timer queries. Lit from straight above, over a 50 x 50 water centered on the origin, until set otherwise
+ *
+ * @param resolution Texels a side of the map
+ * @param grid Rays a side of the lattice cast through the water
+ */
+CausticMap::CausticMap(int resolution, int grid) : mapResolution(resolution), gridResolution(grid < 2 ? 2 : grid), photonsPerSide(0), pass(0),
+    lastGpuMs(0), light(0, 1, 0), depth(CAUSTICMAP_DEPTH), level(0), origin(-25, -25), size(50, 50) {
+    // outside the map, receivers get the light of still water
+    float border[4] = { 1, 1, 1, 1 };
+    glGenTextures(1, &mapTex);
+    glBindTexture(GL_TEXTURE_2D, mapTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, mapResolution, mapResolution, 0, GL_RED, GL_FLOAT, NULL);
+
+    GLint previous;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mapTex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::CAUSTICMAP::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+    glGenVertexArrays(1, &gridVAO);
+    glGenQueries(2, queries);
+}
+
+/**
+ * @brief Destroy the CausticMap object, deleting its GL objects
+ */
+CausticMap::~CausticMap() {
+    glDeleteQueries(2, queries);
+    glDeleteVertexArrays(1, &gridVAO);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &mapTex);
+}
+
+/**
+ * @brief Sets the direction towards the sun
+ *
+ * @param direction Direction (normalized here; must point above the horizon)
+ */
+void CausticMap::setLight(const glm::vec3& direction) {
+    light = glm::normalize(direction);
+}
+
+/**
+ * @brief Sets how far below the water level the refracted light is focused (receivers at other depths see it slightly out of focus)
+ *
+ * @param depth Depth (positive)
+ */
+void CausticMap::setDepth(float depth) {
+    this->depth = depth;
+}
+
+/**
+ * @brief Sets the water the map covers
+ *
+ * @param origin x, z of the first vertex of the water
+ * @param size Extent of the water along x, z
+ * @param level Height of still water
+ */
+void CausticMap::setWater(const glm::vec2& origin, const glm::vec2& size, float level) {
+    this->origin = origin;
+    this->size = size;
+    this->level = level;
+}
+
+/**
+ * @brief Switches between splatting photons and drawing the triangles between rays
+ *
+ * @param perSide Photons a side of the lattice (0 - triangles between the rays of the grid)
+ */
+void CausticMap::setPhotons(int perSide) {
+    photonsPerSide = perSide < 0 ? 0 : perSide;
+}
+
+/**
+ * @brief Direction of sunlight once refracted by still water
+ *
+ * @return glm::vec3
+ */
+glm::vec3 CausticMap::refracted() const {
+    return glm::refract(0.0f - light, glm::vec3(0, 1, 0), 1.0f / CAUSTICMAP_IOR);
+}
+
+/**
+ * @brief Oblique projection along the refracted sunlight onto the surface of still water, then onto the extent of the water: (u, v) of a point
+ *        is where the ray through it entered the water, over [0, 1] across the water; z is its depth below the water level
+ *
+ * @return glm::mat4
+ */
+glm::mat4 CausticMap::lightSpace() const {
+    glm::vec3 d = refracted();
+    float slopeX = d.x / d.y, slopeZ = d.z / d.y;
+
+    glm::mat4 m(0.0f);
+    m[0][0] = 1 / size.x;
+    m[1][0] = 0 - slopeX / size.x;
+    m[3][0] = (slopeX * level - origin.x) / size.x;
+
+    m[2][1] = 1 / size.y;
+    m[1][1] = 0 - slopeZ / size.y;
+    m[3][1] = (slopeZ * level - origin.y) / size.y;
+
+    m[1][2] = -1;
+    m[3][2] = level;
+    m[3][3] = 1;
+    return m;
+}
+
+/**
+ * @brief Renders the map: every ray of a grid x grid lattice over the water is refracted by the normal of the water where it enters and followed
+ *        to the focus depth; the triangles between neighbouring rays are drawn where they land (in light space) with the ratio of their area
+ *        under still water to their area where they land, added up. In photon mode every ray of a perSide x perSide lattice is instead drawn as a
+ *        point where it lands, adding the texels of the map over the photons. Under still water every texel comes out 1
+ *
+ * @param shader Caustic map shader
+ * @param surface Texture of the normals of the water (texel (j, i) for vertex j of row i)
+ * @param heightfield Whether surface is the heightfield texture of the water (height, then normal) instead of the RGB normal map
+ */
+void CausticMap::render(Shader* shader, unsigned int surface, bool heightfield) {
+    // the timer of the pass before last is read only once it is back
+    unsigned int query = queries[pass % 2];
+    if (pass >= 2) {
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            lastGpuMs = elapsed / 1e6;
+        }
+    }
+
+    GLint previous, viewport[4], blendSrc[2], blendDst[2];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc[0]);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrc[1]);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDst[0]);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDst[1]);
+    GLboolean blending = glIsEnabled(GL_BLEND), depthTesting = glIsEnabled(GL_DEPTH_TEST);
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, mapResolution, mapResolution);
+    float black[4] = { 0, 0, 0, 0 };
+    glClearBufferfv(GL_COLOR, 0, black);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    shader->use();
+    shader->setInt("surfaceMap", 0);
+    shader->setBool("heightfield", heightfield);
+    shader->setVec2("gridOrigin", origin);
+    shader->setVec2("gridSize", size);
+    shader->setBool("photons", photonsPerSide > 0);
+    shader->setInt("grid", photonsPerSide > 0 ? photonsPerSide : gridResolution);
+    shader->setFloat("photonEnergy", photonsPerSide > 0 ? (float)mapResolution * mapResolution / ((float)photonsPerSide * photonsPerSide) : 0);
+    shader->setFloat("level", level);
+    shader->setFloat("depth", depth);
+    shader->setVec3("light", light);
+    shader->setVec3("refracted", refracted());
+    shader->setFloat("eta", 1.0f / CAUSTICMAP_IOR);
+    shader->setMat4("lightSpace", lightSpace());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, surface);
+
+    // a strip per pair of neighbouring rows of rays (instances), the rays of each generated from gl_VertexID; or a row of points per instance
+    glBindVertexArray(gridVAO);
+    if (photonsPerSide > 0)
+        glDrawArraysInstanced(GL_POINTS, 0, photonsPerSide, photonsPerSide);
+    else
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * gridResolution, gridResolution - 1);
+    glBindVertexArray(0);
+    glEndQuery(GL_TIME_ELAPSED);
+    pass ++;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBlendFuncSeparate(blendSrc[0], blendDst[0], blendSrc[1], blendDst[1]);
+    if (!blending)
+        glDisable(GL_BLEND);
+    if (depthTesting)
+        glEnable(GL_DEPTH_TEST);
+}
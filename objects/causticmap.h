@@ -0,0 +1,80 @@
+/**
+ * @file causticmap.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Caustic map: light refracted through the water rendered once per frame into a fixed size texture in the light space of the sun, which
+ *        every receiver projects into like a shadow map
+ * @version 0.1
+ * @date 2022-06-29
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef CAUSTICMAP_H
+#define CAUSTICMAP_H
+
+#include "helper.h"
+
+#include <glm/glm.hpp>
+
+// texels a side of the map, and refracted rays a side of the lattice cast through the water (the whole cost of the pass)
+#define CAUSTICMAP_RESOLUTION 512
+#define CAUSTICMAP_GRID 256
+
+// photons a side of the lattice splatted as points in photon mode (a few per texel: every point lands on a single texel)
+#define CAUSTICMAP_PHOTONS 1024
+
+// depth below the water the map is focused at (the rocks), and refractive index of the water
+#define CAUSTICMAP_DEPTH 20.0f
+#define CAUSTICMAP_IOR 1.33f
+
+class CausticMap {
+    public:
+        // a resolution x resolution map lit by grid x grid rays. Call with a GL context current
+        CausticMap(int resolution = CAUSTICMAP_RESOLUTION, int grid = CAUSTICMAP_GRID);
+        ~CausticMap();
+
+        // direction towards the sun (not necessarily unit)
+        void setLight(const glm::vec3& direction);
+        // depth below the water level the light is focused at
+        void setDepth(float depth);
+        // extent of the water the map covers (x, z of its first vertex, extent along x, z) and its rest height
+        void setWater(const glm::vec2& origin, const glm::vec2& size, float level = 0);
+        // photon mode: perSide x perSide rays splatted as points where they land, each adding its share of the light of still water, instead
+        // of the triangles between grid x grid rays (0 - back to triangles)
+        void setPhotons(int perSide);
+
+        // renders the map with shader (shaders/caustics.vs, caustics.fs) from the normals of the water in surface: the RGB normal map of the
+        // rocks, or the heightfield texture of the water (heightfield - height, then normal, in RGBA). Leaves the framebuffer, viewport, blending
+        // and depth test as they were
+        void render(Shader* shader, unsigned int surface, bool heightfield);
+
+        // the map (one channel, 1 - as much light as through still water) and the matrix from world space to its texture coordinates (xy):
+        // a point is looked up where the ray of sunlight through it, refracted by still water, entered the water
+        unsigned int texture() const { return mapTex; }
+        glm::mat4 lightSpace() const;
+
+        int resolution() const { return mapResolution; }
+        int grid() const { return gridResolution; }
+        int photons() const { return photonsPerSide; }
+
+        // GPU milliseconds of the last pass whose timer has come back (0 - none yet)
+        double gpuMs() const { return lastGpuMs; }
+
+    private:
+        int mapResolution, gridResolution, photonsPerSide;
+        unsigned int FBO, mapTex, gridVAO;
+
+        // timer queries of alternate passes, so a result is never waited for
+        unsigned int queries[2];
+        int pass;
+        double lastGpuMs;
+
+        glm::vec3 light;
+        float depth, level;
+        glm::vec2 origin, size;
+
+        // direction of sunlight under still water (unit, downward)
+        glm::vec3 refracted() const;
+};
+
+#endif
@@ -0,0 +1,296 @@
+/**
+ * @file causticref.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief CPU reference for caustics: backward Monte Carlo from receiver points up through the waves and out to the sun, refracted by Snell's law
+ *        and weighted by Fresnel transmission, written as float images. Needs no GPU; the ground truth every faster approximation is scored against
+ * @version 0.1
+ * @date 2022-06-30
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "causticref.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// directions integrated for the light through still water, per direction of a receiver
+#define CAUSTICREF_STILL_SCALE 16
+
+/**
+ * @brief Integer hash (mixes every bit of x into every bit of the result)
+ */
+static uint32_t hashBits(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * @brief Uniform float in [0, 1) from a hash
+ */
+static float unitFloat(uint32_t bits) {
+    return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @brief Construct a new CausticReference object
+ *
+ * @param waves Waves of the water (copied)
+ * @param origin x, z of the first vertex of the water
+ * @param size Extent of the water along x, z
+ * @param level Height of still water
+ */
+CausticReference::CausticReference(const WaveField& waves, const glm::vec2& origin, const glm::vec2& size, float level) : waves(waves),
+    origin(origin), size(size), level(level), depth(CAUSTICREF_DEPTH), light(0, 1, 0), sunRadius(CAUSTICREF_SUN_RADIUS), strata(1), seed(1) {
+    setSamples(CAUSTICREF_SAMPLES);
+}
+
+/**
+ * @brief Sets the direction towards the sun
+ *
+ * @param direction Direction (normalized here; must point above the horizon)
+ */
+void CausticReference::setLight(const glm::vec3& direction) {
+    light = glm::normalize(direction);
+    refresh();
+}
+
+/**
+ * @brief Sets how far below the water level the receiver plane of render is
+ *
+ * @param depth Depth (positive)
+ */
+void CausticReference::setDepth(float depth) {
+    this->depth = depth;
+    refresh();
+}
+
+/**
+ * @brief Sets the angular radius of the sun (a disc of even radiance)
+ *
+ * @param radius Radius (radians)
+ */
+void CausticReference::setSun(float radius) {
+    sunRadius = radius;
+    refresh();
+}
+
+/**
+ * @brief Sets the directions integrated at every receiver point (rounded down to a square number, at least 1)
+ *
+ * @param samples Directions
+ */
+void CausticReference::setSamples(int samples) {
+    strata = (int)sqrt((double)(samples < 1 ? 1 : samples));
+    refresh();
+}
+
+/**
+ * @brief Recomputes the refracted sunlight under still water, the cone of directions sampled around it and the light through still water. The
+ *        cone holds every direction a receiver can see the sun along: the sun refracted by still water, widened by twice the steepest tilt of
+ *        the waves found over a lattice of the water at a few times, times how far a tilt turns a refracted ray (1 - 1 / IOR)
+ */
+void CausticReference::refresh() {
+    refracted = glm::refract(0.0f - light, glm::vec3(0, 1, 0), 1.0f / CAUSTICREF_IOR);
+
+    int lattice = 64;
+    vector<float> z(lattice), h(lattice), dhdx(lattice), dhdz(lattice);
+    for (int j = 0; j < lattice; j ++)
+        z[j] = origin.y + (j + 0.5f) * size.y / lattice;
+    float steepest = 0;
+    for (int k = 0; k < 4; k ++) {
+        for (int i = 0; i < lattice; i ++) {
+            waves.evaluateRow(origin.x + (i + 0.5f) * size.x / lattice, &z[0], lattice, 1.37f * k, &h[0], &dhdx[0], &dhdz[0]);
+            for (int j = 0; j < lattice; j ++)
+                steepest = fmaxf(steepest, sqrtf(dhdx[j] * dhdx[j] + dhdz[j] * dhdz[j]));
+        }
+    }
+    cone = fminf(sunRadius / CAUSTICREF_IOR + 2 * atanf(steepest) * (1 - 1 / CAUSTICREF_IOR), (float)M_PI / 2);
+
+    // still water is the same everywhere, and only sends the sun down the cone of the sun refracted: many more directions, in that cone only
+    glm::vec3 p(origin.x + size.x / 2, level - depth, origin.y + size.y / 2);
+    float stillCone = fminf(1.01f * sunRadius / CAUSTICREF_IOR, cone);
+    double sum = 0;
+    for (int s = 0; s < CAUSTICREF_STILL_SCALE; s ++)
+        sum += integrate(p, 0, stillCone, true, 0xffffffffu - s);
+    still = sum / CAUSTICREF_STILL_SCALE;
+}
+
+/**
+ * @brief Follows a direction from a receiver up to the waves (fixed point iterations on the height where it crosses the surface), refracts it
+ *        out into the air there, and returns the light it brings back: Fresnel transmission if it leaves towards the sun, 0 otherwise (or on total
+ *        internal reflection)
+ *
+ * @param p Receiver point (below the water)
+ * @param up Unit direction (upward)
+ * @param t Water time
+ * @param flat Whether the water is still
+ * @return double
+ */
+double CausticReference::trace(const glm::vec3& p, const glm::vec3& up, float t, bool flat) const {
+    float h = 0, dhdx = 0, dhdz = 0;
+    if (!flat) {
+        for (int k = 0; k < CAUSTICREF_ITERATIONS; k ++) {
+            float s = (level + h - p.y) / up.y;
+            waves.evaluatePoint(p.x + s * up.x, p.z + s * up.z, t, h, dhdx, dhdz);
+        }
+    }
+
+    // Snell's law out of the water (normal up into the air), and the share of light the surface lets through (unpolarized Fresnel)
+    glm::vec3 n = glm::normalize(glm::vec3(0 - dhdx, 1, 0 - dhdz));
+    float eta = CAUSTICREF_IOR;
+    float cosI = glm::dot(up, n);
+    float sin2T = eta * eta * (1 - cosI * cosI);
+    if (cosI <= 0 || sin2T >= 1)
+        return 0;
+    float cosT = sqrtf(1 - sin2T);
+    glm::vec3 out = eta * up - (eta * cosI - cosT) * n;
+
+    if (glm::dot(glm::normalize(out), light) < cosf(sunRadius))
+        return 0;
+
+    double rs = (eta * cosI - cosT) / (eta * cosI + cosT);
+    double rp = (eta * cosT - cosI) / (eta * cosT + cosI);
+    return 1 - (rs * rs + rp * rp) / 2;
+}
+
+/**
+ * @brief Irradiance on a horizontal receiver from the sun through the waves: strata x strata directions jittered within the strata of the cone
+ *        (even in solid angle), each weighted by its cosine on the receiver
+ *
+ * @param p Receiver point
+ * @param t Water time
+ * @param cone Half angle of the cone (radians)
+ * @param flat Whether the water is still
+ * @param sample Picks the jitter (every receiver of an image gets its own)
+ * @return double
+ */
+double CausticReference::integrate(const glm::vec3& p, float t, float cone, bool flat, uint32_t sample) const {
+    // frame around the cone (axis: back up the refracted sunlight)
+    glm::vec3 axis = 0.0f - refracted;
+    glm::vec3 side = fabsf(axis.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 0, 1);
+    glm::vec3 tangent = glm::normalize(glm::cross(axis, side));
+    glm::vec3 bitangent = glm::cross(axis, tangent);
+
+    float cosCone = cosf(cone);
+    uint32_t state = hashBits(seed * 0x9e3779b9u ^ hashBits(sample));
+    double sum = 0;
+    for (int a = 0; a < strata; a ++) {
+        for (int b = 0; b < strata; b ++) {
+            state = hashBits(state + 1);
+            float u1 = (a + unitFloat(state)) / strata;
+            state = hashBits(state + 1);
+            float u2 = (b + unitFloat(state)) / strata;
+
+            float cosTheta = 1 - u1 * (1 - cosCone);
+            float sinTheta = sqrtf(fmaxf(0.0f, 1 - cosTheta * cosTheta));
+            float phi = 2 * (float)M_PI * u2;
+            glm::vec3 up = cosTheta * axis + sinTheta * (cosf(phi) * tangent + sinf(phi) * bitangent);
+            if (up.y <= 0)
+                continue;
+            sum += trace(p, up, t, flat) * up.y;
+        }
+    }
+    return sum * 2 * M_PI * (1 - cosCone) / (strata * strata);
+}
+
+/**
+ * @brief Light on a horizontal receiver at a point, over the light through still water
+ *
+ * @param p Receiver point (below the water)
+ * @param t Water time
+ * @param sample Picks the jitter
+ * @return float
+ */
+float CausticReference::irradiance(const glm::vec3& p, float t, uint32_t sample) const {
+    return still > 0 ? (float)(integrate(p, t, cone, false, sample) / still) : 0;
+}
+
+/**
+ * @brief Receiver point of a texel: on the plane at the focus depth, along the refracted sunlight of still water from where it entered the water
+ *        at the texel's share of the extent of the water (as CausticMap::lightSpace maps it back)
+ *
+ * @param u Column
+ * @param v Row
+ * @param width Columns of the image
+ * @param height Rows of the image
+ * @return glm::vec3
+ */
+glm::vec3 CausticReference::receiver(int u, int v, int width, int height) const {
+    glm::vec3 entry(origin.x + (u + 0.5f) * size.x / width, level, origin.y + (v + 0.5f) * size.y / height);
+    return entry + refracted * (depth / (0 - refracted.y));
+}
+
+/**
+ * @brief Renders the receiver plane, a tile of rows per task (every texel seeded by its index, so the image does not depend on the threads)
+ *
+ * @param t Water time
+ * @param width Columns
+ * @param height Rows
+ * @param out Returned image (width x height floats, row major)
+ * @param pool Threads to render on (NULL - calling thread)
+ */
+void CausticReference::render(float t, int width, int height, float* out, ThreadPool* pool) const {
+    auto rows = [&](int begin, int end) {
+        for (int v = begin; v < end; v ++) {
+            for (int u = 0; u < width; u ++)
+                out[(size_t)v * width + u] = irradiance(receiver(u, v, width, height), t, (uint32_t)(v * width + u));
+        }
+    };
+    if (pool)
+        pool->parallelFor(height, CAUSTICREF_TILE_ROWS, rows);
+    else
+        rows(0, height);
+}
+
+/**
+ * @brief Writes a float image as a grayscale PFM ("Pf", negative scale for little endian, rows from the bottom)
+ *
+ * @param path File to write
+ * @param width Columns
+ * @param height Rows
+ * @param data Image (row major, row 0 first)
+ * @return bool whether the whole file was written
+ */
+bool CausticReference::writeImage(const char* path, int width, int height, const float* data) {
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    bool written = fprintf(file, "Pf\n%d %d\n-1.0\n", width, height) > 0;
+    for (int v = height - 1; v >= 0 && written; v --)
+        written = fwrite(data + (size_t)v * width, sizeof(float), width, file) == (size_t)width;
+    return (fclose(file) == 0) && written;
+}
+
+/**
+ * @brief Reads a grayscale little endian PFM written by writeImage
+ *
+ * @param path File to read
+ * @param width Returned columns
+ * @param height Returned rows
+ * @param data Returned image (row major, row 0 first)
+ * @return bool whether a whole image was read
+ */
+bool CausticReference::readImage(const char* path, int& width, int& height, vector<float>& data) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    char magic[3] = { 0, 0, 0 };
+    float scale = 0;
+    bool read = fscanf(file, "%2s %d %d %f", magic, &width, &height, &scale) == 4 && strcmp(magic, "Pf") == 0 && width > 0 && height > 0
+        && scale < 0 && fgetc(file) != EOF;
+    if (read) {
+        data.resize((size_t)width * height);
+        for (int v = height - 1; v >= 0 && read; v --)
+            read = fread(&data[(size_t)v * width], sizeof(float), width, file) == (size_t)width;
+    }
+    fclose(file);
+    return read;
+}
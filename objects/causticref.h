@@ -0,0 +1,95 @@
+/**
+ * @file causticref.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief CPU reference for caustics: backward Monte Carlo from receiver points up through the waves and out to the sun, refracted by Snell's law
+ *        and weighted by Fresnel transmission, written as float images. Needs no GPU; the ground truth every faster approximation is scored against
+ * @version 0.1
+ * @date 2022-06-30
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef CAUSTICREF_H
+#define CAUSTICREF_H
+
+#include "wavefield.h"
+#include "threadpool.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using std::vector;
+
+#include <stdint.h>
+
+// jittered directions integrated at every receiver point by default (a square number: the directions are stratified sqrt x sqrt)
+#define CAUSTICREF_SAMPLES 1024
+
+// angular radius of the sun (radians): wider than the real sun (0.0047) so a few hundred samples converge
+#define CAUSTICREF_SUN_RADIUS 0.02f
+
+// iterations of the intersection of a ray with the waves (fixed point on the height), and receiver rows a task of the pool renders
+#define CAUSTICREF_ITERATIONS 6
+#define CAUSTICREF_TILE_ROWS 4
+
+// refractive index of the water, and depth of the receiver plane below it by default (same as CAUSTICMAP_IOR and CAUSTICMAP_DEPTH, without the GL
+// of causticmap.h)
+#define CAUSTICREF_IOR 1.33f
+#define CAUSTICREF_DEPTH 20.0f
+
+class CausticReference {
+    public:
+        // caustics under a copy of waves, over the water of the given extent (x, z of its first vertex, extent along x, z) and rest height.
+        // Lit from straight above, receivers CAUSTICREF_DEPTH below the water, until set otherwise
+        CausticReference(const WaveField& waves, const glm::vec2& origin, const glm::vec2& size, float level = 0);
+
+        void setLight(const glm::vec3& direction);
+        void setDepth(float depth);
+        void setSun(float radius);
+        void setSamples(int samples);
+        void setSeed(uint32_t seed) { this->seed = seed; }
+
+        // light reaching a horizontal receiver at p at time t, over the light through still water (1 - no caustic). sample picks the jitter
+        float irradiance(const glm::vec3& p, float t, uint32_t sample) const;
+
+        // width x height image (row major, one float a texel) of the receiver plane at the focus depth, laid out like the caustic map: texel
+        // (u, v) is where sunlight refracted by still water enters the water at u, v across it. The same for any number of threads of pool
+        // (NULL - the calling thread only)
+        void render(float t, int width, int height, float* out, ThreadPool* pool = NULL) const;
+
+        // receiver point of texel (u, v) of a width x height image
+        glm::vec3 receiver(int u, int v, int width, int height) const;
+
+        // light through still water at the focus depth (what irradiance divides by)
+        double stillIrradiance() const { return still; }
+
+        // writes a width x height float image as a little endian grayscale PFM (rows bottom to top, as PFM stores them). Returns whether it was written
+        static bool writeImage(const char* path, int width, int height, const float* data);
+        // reads one back (width, height returned). Returns whether it was read
+        static bool readImage(const char* path, int& width, int& height, vector<float>& data);
+
+    private:
+        WaveField waves;
+        glm::vec2 origin, size;
+        float level, depth;
+        glm::vec3 light;
+        float sunRadius;
+        int strata;
+        uint32_t seed;
+
+        // refracted sunlight under still water (unit, downward), half angle of the cone of directions sampled around it, and the light
+        // through still water
+        glm::vec3 refracted;
+        float cone;
+        double still;
+
+        // refreshes refracted, cone and still after any setting changes
+        void refresh();
+
+        // light along the upward direction up from p (0 - misses the sun), with the surface at time t (flat - still water)
+        double trace(const glm::vec3& p, const glm::vec3& up, float t, bool flat) const;
+        // light over the jittered directions of a cone (half angle cone) around the refracted sunlight, from p
+        double integrate(const glm::vec3& p, float t, float cone, bool flat, uint32_t sample) const;
+};
+
+#endif
@@ -0,0 +1,307 @@
+/**
+ * @file caustics.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Animated caustics: the normal map of the water the rocks refract light through, regenerated every tick on a worker thread and handed to
+ *        the renderer through three persistently mapped pixel buffers, so the render thread only ever issues the texture upload
+ * @version 0.1
+ * @date 2022-06-28
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "caustics.h"
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <chrono>
+
+/**
+ * @brief Construct a new CausticsProducer object (not running until start)
+ *
+ * @param waves Waves of the water (copied: later changes to the water are not followed, see follow)
+ * @param rows Texels along x (rows of the mesh)
+ * @param columns Texels along z (vertices along each row)
+ * @param origin x, z of the first vertex of the water
+ * @param size Extent of the water along x, z
+ */
+CausticsProducer::CausticsProducer(const WaveField& waves, int rows, int columns, const glm::vec2& origin, const glm::vec2& size) : water(NULL),
+    source(CAUSTICS_SURFACE_WAVES), waves(waves), rows(rows), columns(columns), rowX(rows), rowZ(columns), texture(0), backend(NULL), ownsBackend(false), name(0), mapping(NULL), slotBytes(0),
+    stopping(false), serial(0), job(-1), lastProduceMs(0), lastSlot(-1), lastTime(-1), requestCount(0), uploadCount(0), dropCount(0), busyCount(0) {
+    for (int i = 0; i < rows; i ++)
+        rowX[i] = origin.x + (float)i * size.x / rows;
+    for (int j = 0; j < columns; j ++)
+        rowZ[j] = origin.y + (float)j * size.y / columns;
+
+    for (int s = 0; s < CAUSTICS_SLOTS; s ++) {
+        fences[s] = NULL;
+        states[s] = CAUSTICS_FREE;
+        times[s] = 0;
+        serials[s] = 0;
+    }
+}
+
+/**
+ * @brief Destroy the CausticsProducer object, stopping the worker
+ */
+CausticsProducer::~CausticsProducer() {
+    stop();
+}
+
+/**
+ * @brief Follows the surface a water draws: the maps handed to the worker from then on are generated from its active mode, captured anew with every
+ *        time handed to the worker (see capture), so they follow later changes of its waves, its steepness and its ocean
+ *
+ * @param water Water (NULL - the waves given at construction, as last captured)
+ */
+void CausticsProducer::follow(const Water* water) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->water = water;
+    if (water && job < 0)
+        capture();
+}
+
+/**
+ * @brief Copies what the active mode of the followed water is synthesized from: the grids of its ocean as they are now (never synthesized here, the
+ *        ocean only moves on the GL thread), its Gerstner waves while their steepness is above 0, otherwise its sum of waves. Only while the worker
+ *        is idle (job < 0, under mutex)
+ */
+void CausticsProducer::capture() {
+    switch (water->mode()) {
+        case WATER_MODE_OCEAN:
+            water->spectralOcean()->snapshot(oceanGrids);
+            source = CAUSTICS_SURFACE_OCEAN;
+            break;
+        case WATER_MODE_GERSTNER:
+            trochoids = water->gerstnerWaves();
+            source = CAUSTICS_SURFACE_GERSTNER;
+            break;
+        default:
+            waves = water->waveField();
+            source = CAUSTICS_SURFACE_WAVES;
+            break;
+    }
+}
+
+/**
+ * @brief Maps a component of a normal from [-1, 1] to a byte, rounded to the nearest (clamped outside, so flat water's 1 is 255 instead of
+ *        overflowing)
+ *
+ * @param n Component
+ * @return unsigned char
+ */
+static unsigned char encodeComponent(float n) {
+    float byte = (n / 2 + 0.5f) * 255.0f + 0.5f;
+    return (unsigned char)(byte < 0.0f ? 0.0f : (byte > 255.0f ? 255.0f : byte));
+}
+
+/**
+ * @brief Normal map of the water at a time: texel (j, i) holds the normal <-dH/dx, -dH/dz, 1> of vertex j of row i (the cross product of the
+ *        partials of Gerstner waves, up component last), every component mapped from [-1, 1] to a byte. A snapshot of the ocean only holds its own
+ *        time, which t does not change
+ *
+ * @param t Water time
+ * @param out Returned normal map (bytes() long)
+ */
+void CausticsProducer::generate(float t, unsigned char* out) const {
+    bool trochoidal = (source == CAUSTICS_SURFACE_GERSTNER);
+    vector<float> rowH(columns), rowDx(columns), rowDz(columns);
+    vector<float> vertices(trochoidal ? (size_t)columns * WATER_DYNAMIC_FLOATS : 0), offsets(trochoidal ? (size_t)columns * WATER_DISPLACEMENT_FLOATS : 0);
+    for (int i = 0; i < rows; i ++) {
+        // the whole row of normals at once (N = <-dH/dx, -dH/dz, 1>)
+        if (trochoidal)
+            trochoids.evaluateRow(rowX[i], &rowZ[0], columns, t, &vertices[0], &offsets[0]);
+        else if (source == CAUSTICS_SURFACE_OCEAN)
+            oceanGrids.sampleRow(rowX[i], &rowZ[0], columns, &rowH[0], &rowDx[0], &rowDz[0]);
+        else
+            waves.evaluateRow(rowX[i], &rowZ[0], columns, t, &rowH[0], &rowDx[0], &rowDz[0]);
+
+        unsigned char* texel = out + (size_t)i * columns * CAUSTICS_TEXEL_BYTES;
+        for (int j = 0; j < columns; j ++) {
+            const float* vertex = trochoidal ? &vertices[(size_t)j * WATER_DYNAMIC_FLOATS] : NULL;
+            glm::vec3 normal = trochoidal ? glm::vec3(vertex[1], vertex[2], vertex[3]) : glm::vec3(0 - rowDx[j], 0 - rowDz[j], 1);
+            texel[0] = encodeComponent(normal.x);
+            texel[1] = encodeComponent(normal.y);
+            texel[2] = encodeComponent(normal.z);
+            texel += CAUSTICS_TEXEL_BYTES;
+        }
+    }
+}
+
+/**
+ * @brief Allocates the pixel buffers (CAUSTICS_SLOTS maps in one persistently mapped buffer, or plain memory without OpenGL 4.4) and starts the
+ *        worker. Every map then goes up into texture a tick after the worker was handed its time
+ *
+ * @param texture GL_RGB texture of rows x columns texels (rows along t, columns along s; 0 - maps are handed over without touching OpenGL)
+ * @param backend GL calls to make (NULL - OpenGL, through a GLStreamBackend owned by the producer)
+ */
+void CausticsProducer::start(unsigned int texture, StreamBackend* backend) {
+    stop();
+    this->texture = texture;
+    ownsBackend = (backend == NULL);
+    this->backend = ownsBackend ? new GLStreamBackend() : backend;
+
+    // every map starts on a STREAM_ALIGN boundary
+    slotBytes = (bytes() + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+    mapping = (unsigned char*)this->backend->createStorage(slotBytes * CAUSTICS_SLOTS, name);
+    if (!mapping)
+        copies.assign(CAUSTICS_SLOTS, vector<unsigned char>(bytes()));
+
+    stopping = false;
+    worker = std::thread(&CausticsProducer::run, this);
+}
+
+/**
+ * @brief Stops the worker (after the map it is on) and releases the pixel buffers. Call on the GL thread
+ */
+void CausticsProducer::stop() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    if (backend) {
+        for (int s = 0; s < CAUSTICS_SLOTS; s ++) {
+            if (fences[s]) {
+                backend->wait(fences[s]);
+                backend->deleteFence(fences[s]);
+            }
+        }
+        if (mapping)
+            backend->destroyStorage(name);
+        if (ownsBackend)
+            delete backend;
+    }
+
+    backend = NULL;
+    ownsBackend = false;
+    name = 0;
+    mapping = NULL;
+    copies.clear();
+    for (int s = 0; s < CAUSTICS_SLOTS; s ++) {
+        fences[s] = NULL;
+        states[s] = CAUSTICS_FREE;
+    }
+    job = -1;
+    lastSlot = -1;
+    lastTime = -1;
+}
+
+/**
+ * @brief Texels of a slot (in the mapping, or in its plain copy)
+ *
+ * @param slot Slot
+ * @return unsigned char*
+ */
+unsigned char* CausticsProducer::slotData(int slot) const {
+    return mapping ? mapping + (size_t)slot * slotBytes : (unsigned char*)copies[slot].data();
+}
+
+/**
+ * @brief One tick of the render thread. Slots whose upload the GPU has passed are freed (except the one last uploaded, kept for uploadedMap); the
+ *        newest finished map is uploaded from its pixel buffer and fenced, and older finished ones are dropped; the worker, if idle, is handed a
+ *        free slot and time t (and the surface of the followed water, as of this tick). Nothing here waits for the worker or the GPU
+ *
+ * @param t Water time of this tick
+ */
+void CausticsProducer::update(float t) {
+    if (!running())
+        return;
+
+    int newest = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int s = 0; s < CAUSTICS_SLOTS; s ++) {
+            if (states[s] == CAUSTICS_UPLOADING && s != lastSlot && (!fences[s] || backend->signaled(fences[s]))) {
+                if (fences[s])
+                    backend->deleteFence(fences[s]);
+                fences[s] = NULL;
+                states[s] = CAUSTICS_FREE;
+            }
+            if (states[s] == CAUSTICS_READY && (newest < 0 || serials[s] > serials[newest]))
+                newest = s;
+        }
+        for (int s = 0; s < CAUSTICS_SLOTS; s ++) {
+            if (states[s] == CAUSTICS_READY && s != newest) {
+                states[s] = CAUSTICS_FREE;
+                dropCount ++;
+            }
+        }
+    }
+
+    // the worker never touches a finished slot, so the upload runs outside the lock
+    if (newest >= 0 && texture) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (mapping) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, name);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, columns, rows, GL_RGB, GL_UNSIGNED_BYTE, (void*)((size_t)newest * slotBytes));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, columns, rows, GL_RGB, GL_UNSIGNED_BYTE, slotData(newest));
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (newest >= 0) {
+        // the previous map is released once its own upload is passed
+        if (lastSlot >= 0)
+            states[lastSlot] = CAUSTICS_UPLOADING;
+        fences[newest] = mapping ? backend->fence() : NULL;
+        states[newest] = CAUSTICS_UPLOADING;
+        lastSlot = newest;
+        lastTime = times[newest];
+        uploadCount ++;
+    }
+
+    int slot = -1;
+    for (int s = 0; s < CAUSTICS_SLOTS && slot < 0; s ++) {
+        if (states[s] == CAUSTICS_FREE)
+            slot = s;
+    }
+    if (job >= 0 || slot < 0) {
+        busyCount ++;
+        return;
+    }
+
+    // the worker is idle, so what it generates from can be captured anew
+    if (water)
+        capture();
+
+    states[slot] = CAUSTICS_WRITING;
+    times[slot] = t;
+    serials[slot] = ++ serial;
+    job = slot;
+    requestCount ++;
+    wake.notify_one();
+}
+
+/**
+ * @brief Worker: waits for a slot and a time, fills the slot with the normal map at that time, marks it finished
+ */
+void CausticsProducer::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || job >= 0; });
+        if (stopping)
+            return;
+
+        int slot = job;
+        float t = times[slot];
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        generate(t, slotData(slot));
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        lock.lock();
+        states[slot] = CAUSTICS_READY;
+        job = -1;
+        lastProduceMs = elapsed.count();
+    }
+}
@@ -0,0 +1,133 @@
+/**
+ * @file caustics.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Animated caustics: the normal map of the water the rocks refract light through, regenerated every tick on a worker thread and handed to
+ *        the renderer through three persistently mapped pixel buffers, so the render thread only ever issues the texture upload
+ * @version 0.1
+ * @date 2022-06-28
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef CAUSTICS_H
+#define CAUSTICS_H
+
+#include "wavefield.h"
+#include "ocean.h"
+#include "water.h"
+#include "streambuffer.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using std::vector;
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// pixel buffers between the worker and the texture: one being written, one finished, one the GPU may still be uploading from
+#define CAUSTICS_SLOTS 3
+
+// bytes of every texel of the normal map (RGB)
+#define CAUSTICS_TEXEL_BYTES 3
+
+// what a pixel buffer holds
+enum CausticsSlotState {
+    CAUSTICS_FREE=0,        // nothing, may be handed to the worker
+    CAUSTICS_WRITING=1,     // being filled by the worker
+    CAUSTICS_READY=2,       // filled, waiting for the next upload
+    CAUSTICS_UPLOADING=3    // uploaded from, until the GPU passes its fence
+};
+
+// surface the normal maps are generated from
+enum CausticsSurface {
+    CAUSTICS_SURFACE_WAVES=0,       // sum of waves
+    CAUSTICS_SURFACE_GERSTNER=1,    // Gerstner waves (normals of the undisplaced grid)
+    CAUSTICS_SURFACE_OCEAN=2        // grids of the spectral ocean, as they were at one tick
+};
+
+class CausticsProducer {
+    public:
+        // normal map of rows x columns texels over the grid of the water (row i at x = origin.x + i * size.x / rows, texel j at
+        // z = origin.y + j * size.y / columns), from a copy of its waves
+        CausticsProducer(const WaveField& waves, int rows, int columns, const glm::vec2& origin, const glm::vec2& size);
+        ~CausticsProducer();
+
+        // follows the surface water draws instead (NULL - back to the waves given at construction): its mode is captured right away if the worker
+        // is not running, and again every time the worker is handed a time (the grids of an ocean as they are at that tick). Call on the GL thread
+        void follow(const Water* water);
+
+        // bytes of one normal map
+        size_t bytes() const { return (size_t)rows * columns * CAUSTICS_TEXEL_BYTES; }
+
+        // writes the normal map at time t into out (bytes() long), on the calling thread
+        void generate(float t, unsigned char* out) const;
+
+        // starts the worker, regenerating into texture (rows x columns, GL_RGB; 0 - no upload, as in the benchmarks). Pixel buffers are mapped
+        // through backend (NULL - OpenGL); without persistent mapping the maps are uploaded from plain memory instead. Call on the GL thread
+        void start(unsigned int texture, StreamBackend* backend = NULL);
+        void stop();
+        bool running() const { return worker.joinable(); }
+
+        // whether the maps go up from persistently mapped pixel buffers (false - from plain memory)
+        bool streaming() const { return mapping != NULL; }
+
+        // once per tick, on the GL thread: uploads the newest finished map into the texture (dropping older ones), recycles the pixel buffers the
+        // GPU is done with, and hands the worker time t if it is idle
+        void update(float t);
+
+        // time of the map last uploaded (negative - none yet), and its texels (valid until the next update)
+        float uploadedTime() const { return lastTime; }
+        const unsigned char* uploadedMap() const { return lastSlot >= 0 ? slotData(lastSlot) : NULL; }
+
+        // maps the worker was handed, maps uploaded, maps dropped for a newer one, ticks the worker was still busy (or no buffer was free), and
+        // milliseconds the worker took for the last map
+        long requested() const { return requestCount; }
+        long uploaded() const { return uploadCount; }
+        long dropped() const { return dropCount; }
+        long busy() const { return busyCount; }
+        double produceMs() const { return lastProduceMs; }
+
+    private:
+        void run();
+        void capture();
+        unsigned char* slotData(int slot) const;
+
+        // water followed (NULL - none), and what the maps are generated from: only rewritten while the worker is idle
+        const Water* water;
+        CausticsSurface source;
+        WaveField waves;
+        Gerstner trochoids;
+        OceanSnapshot oceanGrids;
+        int rows, columns;
+        vector<float> rowX, rowZ;
+
+        // GL side: texture uploaded into, pixel buffer storage (NULL - plain memory in copies) and the fence of every upload
+        unsigned int texture;
+        StreamBackend* backend;
+        bool ownsBackend;
+        unsigned int name;
+        unsigned char* mapping;
+        size_t slotBytes;
+        vector<vector<unsigned char> > copies;
+        void* fences[CAUSTICS_SLOTS];
+
+        // shared with the worker (under mutex): state, time and age of every slot, and the job (-1 - idle)
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping;
+        CausticsSlotState states[CAUSTICS_SLOTS];
+        float times[CAUSTICS_SLOTS];
+        long serials[CAUSTICS_SLOTS];
+        long serial;
+        int job;
+        double lastProduceMs;
+
+        int lastSlot;
+        float lastTime;
+        long requestCount, uploadCount, dropCount, busyCount;
+};
+
+#endif
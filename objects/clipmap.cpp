@@ -0,0 +1,338 @@
+/**
+ * @file clipmap.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Geometry clipmap of a sum of waves: nested square levels of the same number of vertices, each twice as coarse as the one inside it, that
+ *        follow the viewer. Every level is a ring around the hole the finer level fills, so kilometres of water cost the same few levels of
+ *        vertices, and outer levels drop the waves too short (or too small) for their spacing
+ * @version 0.1
+ * @date 2022-06-23
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "clipmap.h"
+
+#include <algorithm>
+#include <math.h>
+#include <limits.h>
+
+/**
+ * @brief Construct a new Clipmap object without waves (flat until waves are added)
+ *
+ * @param levels Number of levels (the finest one has no hole)
+ * @param resolution Vertices along each side of every level, rounded down to 4k + 1 (at least 5)
+ * @param spacing Distance between the vertices of the finest level
+ */
+Clipmap::Clipmap(int levels, int resolution, float spacing) : levelCount(levels < 1 ? 1 : levels), finest(spacing), directional(true), rounded(true), shifted(false), vertexCount(0), waveCount(0) {
+    n = (resolution - 1) / 4 * 4 + 1;
+    if (n < 5)
+        n = 5;
+
+    size_t points = (size_t)levelCount * n * n;
+    planar.resize(points * CLIPMAP_STATIC_FLOATS);
+    surface.resize(points * CLIPMAP_DYNAMIC_FLOATS);
+
+    // not centered anywhere yet, so the first update moves every level
+    originX.assign(levelCount, LONG_MIN);
+    originZ.assign(levelCount, LONG_MIN);
+    holeX.assign(levelCount, -1);
+    holeZ.assign(levelCount, -1);
+
+    buildIndices();
+    buildLevels();
+}
+
+/**
+ * @brief Removes every wave
+ */
+void Clipmap::clearWaves() {
+    A.clear(); w.clear(); Dx.clear(); Dy.clear(); S.clear(); Cx.clear(); Cy.clear();
+    buildLevels();
+}
+
+/**
+ * @brief Adds a wave (same parameters as WaveField::addWave)
+ *
+ * @param A Amplitude
+ * @param w Frequency
+ * @param Dx x component of the direction
+ * @param Dy y component of the direction
+ * @param S Phase-constant
+ * @param Cx x component of the center of circular waves
+ * @param Cy y component of the center of circular waves
+ */
+void Clipmap::addWave(float A, float w, float Dx, float Dy, float S, float Cx, float Cy) {
+    this->A.push_back(A); this->w.push_back(w);
+    this->Dx.push_back(Dx); this->Dy.push_back(Dy);
+    this->S.push_back(S);
+    this->Cx.push_back(Cx); this->Cy.push_back(Cy);
+    buildLevels();
+}
+
+/**
+ * @brief Sets the family of every wave (as WaveField::setFamily)
+ *
+ * @param directional Directional (true) or circular waves
+ * @param rounded Rounded (true) or pointed crests
+ */
+void Clipmap::setFamily(bool directional, bool rounded) {
+    this->directional = directional;
+    this->rounded = rounded;
+    buildLevels();
+}
+
+/**
+ * @brief Picks the waves of every level. Level l keeps the waves of level l - 1 whose wavelength spans CLIPMAP_SAMPLES_PER_WAVE of its vertices,
+ *        at most CLIPMAP_WAVE_FALLOFF of them (the largest), so the waves of a level are always a subset of the waves of the level inside it
+ */
+void Clipmap::buildLevels() {
+    // every wave, largest first
+    vector<int> kept(A.size());
+    for (size_t i = 0; i < A.size(); i ++)
+        kept[i] = i;
+    std::stable_sort(kept.begin(), kept.end(), [this](int a, int b) { return A[a] > A[b]; });
+
+    vector<vector<int> > selection(levelCount);
+    for (int l = 0; l < levelCount; l ++) {
+        float shortest = CLIPMAP_SAMPLES_PER_WAVE * spacing(l);
+        size_t budget = (l == 0) ? kept.size() : (size_t)ceilf(kept.size() * CLIPMAP_WAVE_FALLOFF);
+
+        vector<int> next;
+        for (size_t k = 0; k < kept.size() && next.size() < budget; k ++) {
+            if (2.0f * (float)M_PI / w[kept[k]] >= shortest)
+                next.push_back(kept[k]);
+        }
+        selection[l] = next;
+        kept = next;
+    }
+
+    // shared with the coarser level first, then the waves fading out towards it (the coarsest level shares everything)
+    common.assign(levelCount, WaveField());
+    extra.assign(levelCount, WaveField());
+    for (int l = 0; l < levelCount; l ++) {
+        const vector<int>& coarser = selection[l + 1 < levelCount ? l + 1 : l];
+        for (size_t k = 0; k < selection[l].size(); k ++) {
+            int i = selection[l][k];
+            bool shared = std::find(coarser.begin(), coarser.end(), i) != coarser.end();
+            (shared ? common[l] : extra[l]).addWave(A[i], w[i], Dx[i], Dy[i], S[i], Cx[i], Cy[i]);
+        }
+        common[l].setFamily(directional, rounded);
+        extra[l].setFamily(directional, rounded);
+    }
+}
+
+/**
+ * @brief Builds the strips of every variant: a strip between every two neighbouring rows of a level, broken in two around the hole, and the
+ *        zero-area triangles sealing the outer edge
+ */
+void Clipmap::buildIndices() {
+    int hole = (n - 1) / 2;
+
+    indexList.clear();
+    for (int v = 0; v < CLIPMAP_VARIANTS; v ++) {
+        // variant 0 has no hole, the others have theirs (n - 1) / 4 vertices in, plus one along x and/or z
+        int ax = -1, az = -1;
+        if (v > 0) {
+            ax = (n - 1) / 4 + ((v - 1) & 1);
+            az = (n - 1) / 4 + ((v - 1) >> 1);
+        }
+
+        offsets[v] = indexList.size();
+        for (int i = 0; i < n - 1; i ++) {
+            // spans of j covered by the strip between rows i and i + 1
+            int spans[2][2] = { { 0, n - 1 }, { 0, -1 } };
+            if (ax >= 0 && i >= ax && i < ax + hole) {
+                spans[0][1] = az;
+                spans[1][0] = az + hole;
+                spans[1][1] = n - 1;
+            }
+
+            for (int s = 0; s < 2; s ++) {
+                if (spans[s][1] < spans[s][0])
+                    continue;
+                for (int j = spans[s][0]; j <= spans[s][1]; j ++) {
+                    for (int k = 0; k < 2; k ++) {
+                        indexList.push_back(j + n * (i + k));
+                    }
+                }
+                indexList.push_back(RESTART_INDEX);
+            }
+        }
+
+        // zero-area triangles along the outer edge (every odd vertex of it lies halfway along an edge of the coarser level around it), so the
+        // edges of the coarser level are also drawn on this side and no pixel falls through the T-junctions
+        for (int k = 0; k + 2 < n; k += 2) {
+            int edges[4][3] = { { k, k + 1, k + 2 }, { (n - 1) * n + k, (n - 1) * n + k + 1, (n - 1) * n + k + 2 },
+                                { k * n, (k + 1) * n, (k + 2) * n }, { k * n + n - 1, (k + 1) * n + n - 1, (k + 2) * n + n - 1 } };
+            for (int e = 0; e < 4; e ++) {
+                indexList.insert(indexList.end(), edges[e], edges[e] + 3);
+                indexList.push_back(RESTART_INDEX);
+            }
+        }
+        counts[v] = indexList.size() - offsets[v];
+    }
+}
+
+/**
+ * @brief Index variant of a level: 0 without a hole, otherwise 1 + (hole one vertex further along x) + 2 * (hole one vertex further along z)
+ *
+ * @param level Level
+ * @return int Variant
+ */
+int Clipmap::variant(int level) const {
+    if (holeX[level] < 0)
+        return 0;
+    return 1 + (holeX[level] - (n - 1) / 4) + 2 * (holeZ[level] - (n - 1) / 4);
+}
+
+/**
+ * @brief Centers every level on the viewer and evaluates it. Level l snaps to twice its own spacing, so the level inside it always lands on its
+ *        even vertices; its hole then starts (n - 1) / 4 vertices in, or one more. Levels are evaluated from the coarsest in, so the outer edge of
+ *        every level can be stitched to the coarser one around it
+ *
+ * @param x x coordinate of the viewer
+ * @param z z coordinate of the viewer
+ * @param t Time elapsed
+ * @param pool Thread pool (NULL - single threaded)
+ */
+void Clipmap::update(float x, float z, float t, ThreadPool* pool) {
+    // cell of twice the finest spacing holding the viewer; level l snaps to cells 2^l times larger
+    long cellX = (long)floorf(x / (2 * finest)), cellZ = (long)floorf(z / (2 * finest));
+    int half = (n - 1) / 2;
+
+    bool moving = false;
+    for (int l = 0; l < levelCount; l ++) {
+        long ox = ((cellX >> l) * 2 - half) * (1L << l);
+        long oz = ((cellZ >> l) * 2 - half) * (1L << l);
+
+        // the hole (where level l - 1 sits) starts (n - 1) / 4 vertices in, one more if level l - 1 snapped to the upper half of the cell of level l
+        if (l > 0) {
+            holeX[l] = (int)((cellX >> (l - 1)) - 2 * (cellX >> l)) + (n - 1) / 4;
+            holeZ[l] = (int)((cellZ >> (l - 1)) - 2 * (cellZ >> l)) + (n - 1) / 4;
+        }
+
+        if (ox == originX[l] && oz == originZ[l])
+            continue;
+        originX[l] = ox;
+        originZ[l] = oz;
+        moving = true;
+
+        // static stream of the level (coordinates in whole finest spacings, so shared vertices match exactly)
+        float* vertex = &planar[(size_t)l * n * n * CLIPMAP_STATIC_FLOATS];
+        for (int i = 0; i < n; i ++) {
+            for (int j = 0; j < n; j ++) {
+                vertex[0] = (float)(ox + ((long)i << l)) * finest;
+                vertex[1] = (float)(oz + ((long)j << l)) * finest;
+                vertex += CLIPMAP_STATIC_FLOATS;
+            }
+        }
+    }
+    shifted = moving;
+
+    vertexCount = 0;
+    waveCount = 0;
+    for (int l = levelCount - 1; l >= 0; l --) {
+        if (pool) {
+            pool->parallelFor(n, 16, [this, l, t](int first, int last) { fillRows(l, first, last, t); });
+        } else {
+            fillRows(l, 0, n, t);
+        }
+        if (l + 1 < levelCount)
+            stitch(l);
+
+        long inside = (holeX[l] < 0) ? 0 : (long)(half - 1) * (half - 1);
+        long vertices = (long)n * n - inside;
+        vertexCount += vertices;
+        waveCount += vertices * waves(l);
+    }
+}
+
+/**
+ * @brief Evaluates rows [first, last) of a level, skipping the vertices strictly inside its hole. Waves the coarser level drops fade out linearly
+ *        over the outer CLIPMAP_BLEND of the level
+ *
+ * @param level Level
+ * @param first First row
+ * @param last One past the last row
+ * @param t Time elapsed
+ */
+void Clipmap::fillRows(int level, int first, int last, float t) {
+    vector<float> z(n), h(n), dhdx(n), dhdz(n), eh(n), edx(n), edz(n);
+    for (int j = 0; j < n; j ++)
+        z[j] = (float)(originZ[level] + ((long)j << level)) * finest;
+
+    int half = (n - 1) / 2;
+    int band = std::max(1, (int)(CLIPMAP_BLEND * (n - 1)));
+    bool fading = extra[level].count() > 0;
+
+    for (int i = first; i < last; i ++) {
+        float x = (float)(originX[level] + ((long)i << level)) * finest;
+
+        // spans of the row outside the hole
+        int spans[2][2] = { { 0, n - 1 }, { 0, -1 } };
+        if (holeX[level] >= 0 && i > holeX[level] && i < holeX[level] + half) {
+            spans[0][1] = holeZ[level];
+            spans[1][0] = holeZ[level] + half;
+            spans[1][1] = n - 1;
+        }
+
+        for (int s = 0; s < 2; s ++) {
+            int j0 = spans[s][0], count = spans[s][1] - spans[s][0] + 1;
+            if (count <= 0)
+                continue;
+
+            common[level].evaluateRow(x, &z[j0], count, t, &h[j0], &dhdx[j0], &dhdz[j0]);
+            if (fading)
+                extra[level].evaluateRow(x, &z[j0], count, t, &eh[j0], &edx[j0], &edz[j0]);
+
+            float* vertex = &surface[(((size_t)level * n + i) * n + j0) * CLIPMAP_DYNAMIC_FLOATS];
+            for (int j = j0; j < j0 + count; j ++) {
+                float hj = h[j], dx = dhdx[j], dz = dhdz[j];
+                if (fading) {
+                    int edge = std::min(std::min(i, n - 1 - i), std::min(j, n - 1 - j));
+                    float alpha = std::min(1.0f, (float)edge / band);
+                    hj += alpha * eh[j];
+                    dx += alpha * edx[j];
+                    dz += alpha * edz[j];
+                }
+
+                // N = <-dH/dx, -dH/dz, 1>
+                vertex[0] = hj;
+                vertex[1] = 0 - dx;
+                vertex[2] = 0 - dz;
+                vertex[3] = 1;
+                vertex += CLIPMAP_DYNAMIC_FLOATS;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Copies the outer edge of a level from the coarser level around it: even vertices are vertices of the coarser level, odd ones sit halfway
+ *        along its edges and take their average. The two levels then share every edge exactly, so no crack or T-junction opens between them
+ *
+ * @param level Level (not the coarsest)
+ */
+void Clipmap::stitch(int level) {
+    int c = level + 1;
+    const float* coarse = &surface[(size_t)c * n * n * CLIPMAP_DYNAMIC_FLOATS];
+    float* fine = &surface[(size_t)level * n * n * CLIPMAP_DYNAMIC_FLOATS];
+
+    for (int e = 0; e < n; e ++) {
+        // vertex e along each of the four edges
+        int edges[4][2] = { { 0, e }, { n - 1, e }, { e, 0 }, { e, n - 1 } };
+        for (int k = 0; k < 4; k ++) {
+            int i = edges[k][0], j = edges[k][1];
+
+            // coarse vertices either side of the fine one (the same vertex twice when it is even)
+            int ci0 = holeX[c] + i / 2, ci1 = holeX[c] + (i + 1) / 2;
+            int cj0 = holeZ[c] + j / 2, cj1 = holeZ[c] + (j + 1) / 2;
+            const float* a = coarse + ((size_t)ci0 * n + cj0) * CLIPMAP_DYNAMIC_FLOATS;
+            const float* b = coarse + ((size_t)ci1 * n + cj1) * CLIPMAP_DYNAMIC_FLOATS;
+
+            float* vertex = fine + ((size_t)i * n + j) * CLIPMAP_DYNAMIC_FLOATS;
+            for (int f = 0; f < CLIPMAP_DYNAMIC_FLOATS; f ++)
+                vertex[f] = (a == b) ? a[f] : (a[f] + b[f]) * 0.5f;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file clipmap.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Geometry clipmap of a sum of waves: nested square levels of the same number of vertices, each twice as coarse as the one inside it, that
+ *        follow the viewer. Every level is a ring around the hole the finer level fills, so kilometres of water cost the same few levels of
+ *        vertices, and outer levels drop the waves too short (or too small) for their spacing
+ * @version 0.1
+ * @date 2022-06-23
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef CLIPMAP_H
+#define CLIPMAP_H
+
+#include "wavefield.h"
+#include "threadpool.h"
+#include "restart.h"
+
+#include <vector>
+using std::vector;
+
+// default number of levels and vertices along each side of a level (4k + 1, so levels nest on even vertices)
+#define CLIPMAP_LEVELS 8
+#define CLIPMAP_RESOLUTION 129
+
+// vertices a wavelength has to span for a level to keep the wave (waves shorter than that would alias)
+#define CLIPMAP_SAMPLES_PER_WAVE 4.0f
+
+// fraction of the waves of a level kept by the next, coarser one (the largest ones)
+#define CLIPMAP_WAVE_FALLOFF 0.5f
+
+// width of the band along the outside of a level over which the waves the coarser level drops fade out (fraction of the side of the level)
+#define CLIPMAP_BLEND 0.1f
+
+// floats per vertex of the static (x, z) and dynamic (height, then the normal) streams, the same layout as the streams of Water
+#define CLIPMAP_STATIC_FLOATS 2
+#define CLIPMAP_DYNAMIC_FLOATS 4
+
+// number of index variants: the full finest level, then the four places the hole of an outer level can sit (one vertex either way along x, z)
+#define CLIPMAP_VARIANTS 5
+
+class Clipmap {
+    public:
+        // levels of resolution x resolution vertices (rounded down to 4k + 1), the finest spacing vertices apart
+        Clipmap(int levels = CLIPMAP_LEVELS, int resolution = CLIPMAP_RESOLUTION, float spacing = 0.1f);
+
+        // wave table and family, as WaveField (levels pick their waves from it)
+        void clearWaves();
+        void addWave(float A, float w, float Dx, float Dy, float S, float Cx = 0, float Cy = 0);
+        void setFamily(bool directional, bool rounded);
+
+        // centers the levels on the viewer (x, z) and evaluates them at time t (a tile of rows at a time on the pool, if any)
+        void update(float x, float z, float t, ThreadPool* pool = NULL);
+
+        int levels() const { return levelCount; }
+        int resolution() const { return n; }
+        float spacing(int level) const { return finest * (float)(1 << level); }
+
+        // side of the water covered by every level together
+        float extent() const { return (n - 1) * spacing(levelCount - 1); }
+
+        // static stream (x, z) and dynamic stream (height, then the normal) of every level, n * n vertices per level (vertex j of row i of level l
+        // at l * n * n + i * n + j; the vertices in the hole of a level are left unevaluated)
+        vector<float> planar;
+        vector<float> surface;
+
+        // whether the last update moved any level (the static stream changed)
+        bool moved() const { return shifted; }
+
+        // strips of every variant, separated by RESTART_INDEX, indexing the vertices of a single level
+        const vector<unsigned int>& indices() const { return indexList; }
+        int variantOffset(int variant) const { return offsets[variant]; }
+        int variantCount(int variant) const { return counts[variant]; }
+
+        // index variant of level l, given its hole after the last update
+        int variant(int level) const;
+
+        // waves evaluated by level l (the ones shared with the coarser level, then the ones fading out towards it)
+        int waves(int level) const { return common[level].count() + extra[level].count(); }
+
+        // vertices and vertex-wave evaluations of the last update
+        long verticesEvaluated() const { return vertexCount; }
+        long waveEvaluations() const { return waveCount; }
+
+    private:
+        void buildLevels();
+        void buildIndices();
+        void fillRows(int level, int first, int last, float t);
+        void stitch(int level);
+
+        int levelCount, n;
+        float finest;
+
+        // wave table (levels pick the largest of the waves they can resolve)
+        vector<float> A, w, Dx, Dy, S, Cx, Cy;
+        bool directional, rounded;
+
+        // per level: the waves of the next coarser level, and the waves only this level keeps (faded out over the outer band)
+        vector<WaveField> common, extra;
+
+        // per level: first vertex (x, z, in finest spacings, so vertices shared by two levels get the same coordinates) and the first vertex of
+        // its hole (in vertices of the level, -1 - no hole)
+        vector<long> originX, originZ;
+        vector<int> holeX, holeZ;
+        bool shifted;
+
+        vector<unsigned int> indexList;
+        int offsets[CLIPMAP_VARIANTS], counts[CLIPMAP_VARIANTS];
+
+        long vertexCount, waveCount;
+};
+
+#endif
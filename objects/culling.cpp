@@ -0,0 +1,194 @@
+/**
+ * @file culling.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Frustum culling of the water mesh: the grid is split into square tiles of vertices, each bounded by a box as high as the sum of waves
+ *        can ever reach (|H| <= sum of Ai), and only the tiles whose box meets the view frustum are evaluated and drawn
+ * @version 0.1
+ * @date 2022-06-25
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "culling.h"
+
+#include <algorithm>
+
+/**
+ * @brief Construct a new Frustum object from the rows of a view-projection matrix (clip space -w <= x, y, z <= w)
+ *
+ * @param viewProjection Projection matrix times view matrix (times model matrix for a frustum in model space)
+ */
+Frustum::Frustum(const glm::mat4& viewProjection) {
+    // glm is column major: row r of the matrix is (m[0][r], m[1][r], m[2][r], m[3][r])
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r ++)
+        rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+    for (int axis = 0; axis < 3; axis ++) {
+        planes[2 * axis] = rows[3] + rows[axis];
+        planes[2 * axis + 1] = rows[3] - rows[axis];
+    }
+}
+
+/**
+ * @brief Whether a box is at least partly inside the frustum: it is out only if its corner furthest along the normal of some plane is behind it
+ *
+ * @param lower Corner of the box with the smallest coordinates
+ * @param upper Corner of the box with the largest coordinates
+ * @return bool
+ */
+bool Frustum::intersects(const glm::vec3& lower, const glm::vec3& upper) const {
+    for (int p = 0; p < 6; p ++) {
+        glm::vec3 corner(planes[p].x >= 0 ? upper.x : lower.x, planes[p].y >= 0 ? upper.y : lower.y, planes[p].z >= 0 ? upper.z : lower.z);
+        if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Construct a new TileGrid object
+ *
+ * @param rows Rows of vertices of the grid
+ * @param columns Vertices along each row
+ * @param quads Quads along each side of a tile
+ */
+TileGrid::TileGrid(int rows, int columns, int quads) : rows(rows), columns(columns), quads(std::max(1, quads)), tileRows(0), tileColumns(0),
+    keptRows(0, -1), keptVertices(0) {
+    if (rows < 2 || columns < 2)
+        return;
+    quads = this->quads;
+    tileRows = (rows - 2) / quads + 1;
+    tileColumns = (columns - 2) / quads + 1;
+
+    // row major over the tiles, tile (tr, tc) at tr * tileColumns + tc
+    for (int r = 0; r < rows - 1; r += quads) {
+        for (int c = 0; c < columns - 1; c += quads) {
+            firstRow.push_back(r);
+            lastRow.push_back(std::min(r + quads, rows - 1));
+            firstColumn.push_back(c);
+            lastColumn.push_back(std::min(c + quads, columns - 1));
+        }
+    }
+    keptMask.resize(count(), 0);
+}
+
+/**
+ * @brief Culls every tile against the frustum. The height of the surface never leaves [-bound, bound], so a tile whose box is outside the
+ *        frustum cannot show on screen whatever the waves do
+ *
+ * @param frustum View frustum (in the space of the grid)
+ * @param rowX x coordinate of every row of vertices
+ * @param columnZ z coordinate of every column of vertices
+ * @param bound Largest height of the surface either way
+ * @return int number of tiles kept
+ */
+int TileGrid::cull(const Frustum& frustum, const float* rowX, const float* columnZ, float bound) {
+    kept.clear();
+    keptVertices = 0;
+    keptRows = glm::ivec2(rows, -1);
+
+    long vertices = 0;
+    for (int t = 0; t < count(); t ++) {
+        vertices += tileVertices(t);
+
+        glm::vec3 lower, upper;
+        bounds(t, rowX, columnZ, bound, lower, upper);
+        keptMask[t] = frustum.intersects(lower, upper);
+        if (keptMask[t]) {
+            kept.push_back(t);
+            keptVertices += tileVertices(t);
+            keptRows = glm::ivec2(std::min(keptRows.x, firstRow[t]), std::max(keptRows.y, lastRow[t]));
+        }
+    }
+
+    totals.frames ++;
+    totals.tiles += count();
+    totals.visibleTiles += kept.size();
+    totals.vertices += vertices;
+    totals.visibleVertices += keptVertices;
+    return kept.size();
+}
+
+/**
+ * @brief Box of a tile, as high as the surface can ever reach
+ *
+ * @param t Tile
+ * @param rowX x coordinate of every row of vertices
+ * @param columnZ z coordinate of every column of vertices
+ * @param bound Largest height of the surface either way
+ * @param lower Returned corner of the box with the smallest coordinates
+ * @param upper Returned corner of the box with the largest coordinates
+ */
+void TileGrid::bounds(int t, const float* rowX, const float* columnZ, float bound, glm::vec3& lower, glm::vec3& upper) const {
+    lower = glm::vec3(std::min(rowX[firstRow[t]], rowX[lastRow[t]]), -bound, std::min(columnZ[firstColumn[t]], columnZ[lastColumn[t]]));
+    upper = glm::vec3(std::max(rowX[firstRow[t]], rowX[lastRow[t]]), bound, std::max(columnZ[firstColumn[t]], columnZ[lastColumn[t]]));
+}
+
+/**
+ * @brief Column spans of a row covered by a set of tiles. A row on the edge between two rows of tiles belongs to both, and neighbouring tiles
+ *        of the set merge into a single span
+ *
+ * @param r Row of vertices
+ * @param mask Whether each tile is in the set
+ * @param spans Returned spans (x - first column, y - last column, inclusive)
+ */
+void TileGrid::spans(int r, const vector<unsigned char>& mask, vector<glm::ivec2>& spans) const {
+    spans.clear();
+    if (r < 0 || r >= rows || !count())
+        return;
+
+    // the (up to two) rows of tiles holding row r
+    int below = std::min(r / quads, tileRows - 1);
+    int above = (r % quads == 0 && r > 0) ? r / quads - 1 : below;
+
+    for (int tc = 0; tc < tileColumns; tc ++) {
+        bool covered = mask[below * tileColumns + tc] || mask[above * tileColumns + tc];
+        if (!covered)
+            continue;
+
+        int t = below * tileColumns + tc;
+        if (!spans.empty() && spans.back().y == firstColumn[t])
+            spans.back().y = lastColumn[t];
+        else
+            spans.push_back(glm::ivec2(firstColumn[t], lastColumn[t]));
+    }
+}
+
+/**
+ * @brief Column spans of a row covered by the tiles kept by the last cull (see spans)
+ *
+ * @param r Row of vertices
+ * @param spans Returned spans (x - first column, y - last column, inclusive)
+ */
+void TileGrid::visibleSpans(int r, vector<glm::ivec2>& spans) const {
+    if (r < keptRows.x || r > keptRows.y) {
+        spans.clear();
+        return;
+    }
+    this->spans(r, keptMask, spans);
+}
+
+/**
+ * @brief Appends the strips of every tile to indices, tile after tile
+ *
+ * @param indices Indices to append to
+ */
+void TileGrid::buildIndices(vector<unsigned int>& indices) {
+    size_t start = indices.size();
+    offsets.clear();
+    counts.clear();
+
+    for (int t = 0; t < count(); t ++) {
+        offsets.push_back(indices.size() - start);
+        for (int r = firstRow[t]; r < lastRow[t]; r ++) {
+            for (int c = firstColumn[t]; c <= lastColumn[t]; c ++) {
+                for (int k = 0; k < 2; k ++) {
+                    indices.push_back(c + columns * (r + k));
+                }
+            }
+            indices.push_back(RESTART_INDEX);
+        }
+        counts.push_back(indices.size() - start - offsets[t]);
+    }
+}
@@ -0,0 +1,110 @@
+/**
+ * @file culling.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Frustum culling of the water mesh: the grid is split into square tiles of vertices, each bounded by a box as high as the sum of waves
+ *        can ever reach (|H| <= sum of Ai), and only the tiles whose box meets the view frustum are evaluated and drawn
+ * @version 0.1
+ * @date 2022-06-25
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "restart.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using std::vector;
+
+// quads along each side of a tile (tiles along the far edges of the grid may be smaller)
+#define CULL_TILE_QUADS 32
+
+// the six planes of a view frustum in world space, extracted from a view-projection matrix (Gribb and Hartmann)
+class Frustum {
+    public:
+        Frustum(const glm::mat4& viewProjection = glm::mat4(1.0f));
+
+        // whether the axis aligned box [lower, upper] is at least partly inside (conservative: boxes near a corner of the frustum may pass)
+        bool intersects(const glm::vec3& lower, const glm::vec3& upper) const;
+
+    private:
+        // a x + b y + c z + d >= 0 inside each plane (left, right, bottom, top, near, far)
+        glm::vec4 planes[6];
+};
+
+// running totals of what culling saved
+struct CullStats {
+    long frames;
+    long tiles, visibleTiles;
+    long vertices, visibleVertices;
+
+    CullStats() : frames(0), tiles(0), visibleTiles(0), vertices(0), visibleVertices(0) {}
+
+    // fraction of the vertices of the mesh culled (never evaluated, never drawn)
+    double efficiency() const { return vertices ? 1.0 - (double)visibleVertices / vertices : 0.0; }
+};
+
+// grid of rows x columns vertices split into tiles of CULL_TILE_QUADS quads a side (neighbouring tiles share their edge vertices)
+class TileGrid {
+    public:
+        TileGrid(int rows = 0, int columns = 0, int quads = CULL_TILE_QUADS);
+
+        int count() const { return (int)firstRow.size(); }
+
+        // vertices [firstRow, lastRow] x [firstColumn, lastColumn] of tile t, inclusive
+        int rowBegin(int t) const { return firstRow[t]; }
+        int rowEnd(int t) const { return lastRow[t]; }
+        int columnBegin(int t) const { return firstColumn[t]; }
+        int columnEnd(int t) const { return lastColumn[t]; }
+        int tileVertices(int t) const { return (lastRow[t] - firstRow[t] + 1) * (lastColumn[t] - firstColumn[t] + 1); }
+
+        // keeps the tiles whose box (x of the rows, z of the columns, heights within [-bound, bound]) meets the frustum. Returns how many
+        int cull(const Frustum& frustum, const float* rowX, const float* columnZ, float bound);
+
+        // tiles kept by the last cull, as a list and as a mask (one entry per tile)
+        const vector<int>& visible() const { return kept; }
+        const vector<unsigned char>& visibleMask() const { return keptMask; }
+
+        // vertices of the tiles kept by the last cull (shared edges counted once per tile)
+        long visibleVertices() const { return keptVertices; }
+
+        // box of tile t: x of its rows, z of its columns, heights within [-bound, bound]
+        void bounds(int t, const float* rowX, const float* columnZ, float bound, glm::vec3& lower, glm::vec3& upper) const;
+
+        // column spans [first, last] (inclusive, merged, in order) of row r covered by the tiles set in mask (one entry per tile)
+        void spans(int r, const vector<unsigned char>& mask, vector<glm::ivec2>& spans) const;
+
+        // same, for the tiles kept by the last cull
+        void visibleSpans(int r, vector<glm::ivec2>& spans) const;
+
+        // rows [first, last] spanned by the tiles kept by the last cull (first > last when none is)
+        int visibleRowBegin() const { return keptRows.x; }
+        int visibleRowEnd() const { return keptRows.y; }
+
+        // appends the strips of every tile (a strip per pair of neighbouring rows, each followed by RESTART_INDEX) to indices, as indices of the
+        // whole grid; tile t then starts offset(t) indices after the first one appended and spans indexCount(t) of them
+        void buildIndices(vector<unsigned int>& indices);
+        int offset(int t) const { return offsets[t]; }
+        int indexCount(int t) const { return counts[t]; }
+
+        // totals of every cull so far (see resetStats)
+        const CullStats& stats() const { return totals; }
+        void resetStats() { totals = CullStats(); }
+
+    private:
+        int rows, columns, quads, tileRows, tileColumns;
+        vector<int> firstRow, lastRow, firstColumn, lastColumn;
+        vector<int> offsets, counts;
+
+        vector<int> kept;
+        vector<unsigned char> keptMask;
+        glm::ivec2 keptRows;
+        long keptVertices;
+
+        CullStats totals;
+};
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * @file fft.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Square 2D inverse FFT of power of two size, on split real/imaginary grids. Radix-4 Stockham passes (one radix-2 pass for odd powers)
+ *        run down whole columns at a time, so every butterfly applies one twiddle to a contiguous strip of floats and vectorizes
+ * @version 0.1
+ * @date 2022-06-19
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "fft.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * @brief Construct a new (unplanned) FFT object
+ */
+FFT::FFT() : n(0) {
+
+}
+
+/**
+ * @brief Plans an n x n transform: picks the radix of every pass and tabulates its twiddles
+ *
+ * @param n Size of the grid along each axis (power of two, at least 2)
+ * @return bool whether n is a valid size
+ */
+bool FFT::init(int n) {
+    if (n < 2 || (n & (n - 1)) != 0)
+        return false;
+
+    this->n = n;
+    radix.clear();
+    twiddleOffset.clear();
+    twRe.clear();
+    twIm.clear();
+
+    // passes shrink the sequence length by their radix (n, n / 4, ...), the last radix-2 pass handles odd powers of two
+    for (int length = n; length > 1; ) {
+        int r = (length % 4 == 0) ? 4 : 2;
+        int m = length / r;
+        radix.push_back(r);
+        twiddleOffset.push_back(twRe.size());
+
+        // inverse twiddles w^(kp), w = e^(2 pi i / length), for k = 1 .. r - 1
+        for (int k = 1; k < r; k ++) {
+            for (int p = 0; p < m; p ++) {
+                double angle = 2 * M_PI * k * p / length;
+                twRe.push_back((float)cos(angle));
+                twIm.push_back((float)sin(angle));
+            }
+        }
+        length = m;
+    }
+
+    tmpRe.resize(n * n);
+    tmpIm.resize(n * n);
+    return true;
+}
+
+/**
+ * @brief Runs every pass of the 1D transform down columns [c0, c1) of the grid, ping-ponging between the two buffers
+ *
+ * @param re Real parts of both buffers
+ * @param im Imaginary parts of both buffers
+ * @param src Buffer (0 or 1) holding the input
+ * @param c0 First column
+ * @param c1 One past the last column
+ * @param copyBack Whether to copy the result into buffer 0 if it ends up in buffer 1
+ */
+void FFT::columns(float* const* re, float* const* im, int src, int c0, int c1, bool copyBack) {
+    int cur = src;
+    int s = 1;
+    int length = n;
+
+    for (size_t pass = 0; pass < radix.size(); pass ++) {
+        const float* xRe = re[cur] + c0;
+        const float* xIm = im[cur] + c0;
+        float* yRe = re[1 - cur] + c0;
+        float* yIm = im[1 - cur] + c0;
+        int width = c1 - c0;
+        int m = length / radix[pass];
+        const float* wRe = twRe.data() + twiddleOffset[pass];
+        const float* wIm = twIm.data() + twiddleOffset[pass];
+
+        for (int p = 0; p < m; p ++) {
+            if (radix[pass] == 4) {
+                float w1r = wRe[p], w1i = wIm[p];
+                float w2r = wRe[m + p], w2i = wIm[m + p];
+                float w3r = wRe[2 * m + p], w3i = wIm[2 * m + p];
+
+                for (int q = 0; q < s; q ++) {
+                    size_t a = (size_t)(q + s * p) * n, b = a + (size_t)s * m * n, c = b + (size_t)s * m * n, d = c + (size_t)s * m * n;
+                    size_t y0 = (size_t)(q + s * 4 * p) * n, y1 = y0 + (size_t)s * n, y2 = y1 + (size_t)s * n, y3 = y2 + (size_t)s * n;
+
+                    for (int k = 0; k < width; k ++) {
+                        float apcR = xRe[a + k] + xRe[c + k], apcI = xIm[a + k] + xIm[c + k];
+                        float amcR = xRe[a + k] - xRe[c + k], amcI = xIm[a + k] - xIm[c + k];
+                        float bpdR = xRe[b + k] + xRe[d + k], bpdI = xIm[b + k] + xIm[d + k];
+
+                        // i (b - d)
+                        float jbmdR = xIm[d + k] - xIm[b + k], jbmdI = xRe[b + k] - xRe[d + k];
+
+                        float t1R = amcR + jbmdR, t1I = amcI + jbmdI;
+                        float t2R = apcR - bpdR, t2I = apcI - bpdI;
+                        float t3R = amcR - jbmdR, t3I = amcI - jbmdI;
+
+                        yRe[y0 + k] = apcR + bpdR;
+                        yIm[y0 + k] = apcI + bpdI;
+                        yRe[y1 + k] = w1r * t1R - w1i * t1I;
+                        yIm[y1 + k] = w1r * t1I + w1i * t1R;
+                        yRe[y2 + k] = w2r * t2R - w2i * t2I;
+                        yIm[y2 + k] = w2r * t2I + w2i * t2R;
+                        yRe[y3 + k] = w3r * t3R - w3i * t3I;
+                        yIm[y3 + k] = w3r * t3I + w3i * t3R;
+                    }
+                }
+            } else {
+                float wr = wRe[p], wi = wIm[p];
+
+                for (int q = 0; q < s; q ++) {
+                    size_t a = (size_t)(q + s * p) * n, b = a + (size_t)s * m * n;
+                    size_t y0 = (size_t)(q + s * 2 * p) * n, y1 = y0 + (size_t)s * n;
+
+                    for (int k = 0; k < width; k ++) {
+                        float amb = xRe[a + k] - xRe[b + k], ambI = xIm[a + k] - xIm[b + k];
+                        yRe[y0 + k] = xRe[a + k] + xRe[b + k];
+                        yIm[y0 + k] = xIm[a + k] + xIm[b + k];
+                        yRe[y1 + k] = wr * amb - wi * ambI;
+                        yIm[y1 + k] = wr * ambI + wi * amb;
+                    }
+                }
+            }
+        }
+
+        cur = 1 - cur;
+        s *= radix[pass];
+        length = m;
+    }
+
+    if (copyBack && cur == 1) {
+        for (int r = 0; r < n; r ++) {
+            memcpy(re[0] + (size_t)r * n + c0, re[1] + (size_t)r * n + c0, (c1 - c0) * sizeof(float));
+            memcpy(im[0] + (size_t)r * n + c0, im[1] + (size_t)r * n + c0, (c1 - c0) * sizeof(float));
+        }
+    }
+}
+
+/**
+ * @brief Writes rows [r0, r1) of the transpose of src into dst, in FFT_STRIP square blocks
+ *
+ * @param srcRe Real part of the grid to transpose
+ * @param srcIm Imaginary part of the grid to transpose
+ * @param dstRe Returned real part
+ * @param dstIm Returned imaginary part
+ * @param r0 First row of dst
+ * @param r1 One past the last row of dst
+ */
+void FFT::transpose(const float* srcRe, const float* srcIm, float* dstRe, float* dstIm, int r0, int r1) {
+    for (int c0 = 0; c0 < n; c0 += FFT_STRIP) {
+        int c1 = (c0 + FFT_STRIP < n) ? c0 + FFT_STRIP : n;
+        for (int r = r0; r < r1; r ++) {
+            for (int c = c0; c < c1; c ++) {
+                dstRe[(size_t)r * n + c] = srcRe[(size_t)c * n + r];
+                dstIm[(size_t)r * n + c] = srcIm[(size_t)c * n + r];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Unnormalized inverse transform of an n x n grid in place. Transforms down the columns, transposes, then transforms down the columns
+ *        again, so the result comes out transposed: input indexed [v][u] gives output indexed [x][y]. Strips of FFT_STRIP columns (and
+ *        rows of the transpose) are independent tiles run on the pool, so the result is bit-identical for any number of threads
+ *
+ * @param re Real part of the row major n x n grid (returned transformed)
+ * @param im Imaginary part of the row major n x n grid (returned transformed)
+ * @param pool Thread pool (NULL - single threaded)
+ */
+void FFT::inverse2D(float* re, float* im, ThreadPool* pool) {
+    float* bufRe[2] = { re, tmpRe.data() };
+    float* bufIm[2] = { im, tmpIm.data() };
+
+    // after the first set of passes the data sits in buffer (number of passes) % 2, the transpose moves it to the other one
+    int first = radix.size() % 2;
+    int second = 1 - first;
+
+    auto run = [&](const std::function<void(int, int)>& job) {
+        if (pool)
+            pool->parallelFor(n, FFT_STRIP, job);
+        else
+            job(0, n);
+    };
+
+    run([&](int c0, int c1) { columns(bufRe, bufIm, 0, c0, c1, false); });
+    run([&](int r0, int r1) { transpose(bufRe[first], bufIm[first], bufRe[second], bufIm[second], r0, r1); });
+    run([&](int c0, int c1) { columns(bufRe, bufIm, second, c0, c1, true); });
+}
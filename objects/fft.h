@@ -0,0 +1,52 @@
+/**
+ * @file fft.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Square 2D inverse FFT of power of two size, on split real/imaginary grids. Radix-4 Stockham passes (one radix-2 pass for odd powers)
+ *        run down whole columns at a time, so every butterfly applies one twiddle to a contiguous strip of floats and vectorizes
+ * @version 0.1
+ * @date 2022-06-19
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include "wavefield.h"
+#include "threadpool.h"
+
+#include <vector>
+using std::vector;
+
+// number of columns transformed together by one tile of a column pass (also the tile of the transpose)
+#define FFT_STRIP 64
+
+class FFT {
+    public:
+        FFT();
+
+        // plans an n x n transform (n a power of two, at least 2). Returns false otherwise
+        bool init(int n);
+        int size() const { return n; }
+
+        // unnormalized inverse transform of the n x n row major grid (re, im) in place: out(x, y) = sum of in(u, v) e^(2 pi i (u x + v y) / n)
+        // input is indexed [v][u] and output [x][y] (the result is returned transposed)
+        void inverse2D(float* re, float* im, ThreadPool* pool);
+
+    private:
+        void columns(float* const* re, float* const* im, int src, int c0, int c1, bool copyBack);
+        void transpose(const float* srcRe, const float* srcIm, float* dstRe, float* dstIm, int r0, int r1);
+
+        int n;
+
+        // radix of each pass (4, with a final 2 for odd powers of two) and the offset of its twiddles
+        vector<int> radix, twiddleOffset;
+
+        // twiddles of every pass: w^p, w^2p, w^3p for p < n / 4 (radix-4), w^p for p < n / 2 (radix-2)
+        AlignedFloats twRe, twIm;
+
+        // ping-pong grids, same layout as the transformed grid
+        AlignedFloats tmpRe, tmpIm;
+};
+
+#endif
@@ -103,7 +103,7 @@ class SptLight : public Light {
 };
 
 /**
- * @brief Defines a shader class to bind and store information on a set of vertex/fragment/(geometry) shaders. Geometry optional (and default null). (adpated from https://learnopengl.com/code_viewer_gh.php?code=includes/learnopengl/shader.h)
+ * @brief Defines a shader class to bind and store information on a set of vertex/fragment/(geometry) shaders, vertex/tessellation/fragment shaders, or on a single compute shader. Geometry optional (and default null). (adpated from https://learnopengl.com/code_viewer_gh.php?code=includes/learnopengl/shader.h)
  */
 class Shader {
     public:
@@ -196,6 +196,74 @@ class Shader {
                 glDeleteShader(geometry);
         }
 
+        // compute shader program
+        explicit Shader(const char* computePath) {
+            string computeCode;
+            std::ifstream cShaderFile;
+            cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+
+            try {
+                cShaderFile.open(computePath);
+                std::stringstream cShaderStream;
+                cShaderStream << cShaderFile.rdbuf();
+                cShaderFile.close();
+                computeCode = cShaderStream.str();
+            } catch (std::ifstream::failure& e) {
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            }
+
+            const char* cShaderCode = computeCode.c_str();
+
+            unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+            glShaderSource(compute, 1, &cShaderCode, NULL);
+            glCompileShader(compute);
+            checkCompileErrors(compute, "COMPUTE");
+
+            ID = glCreateProgram();
+            glAttachShader(ID, compute);
+            glLinkProgram(ID);
+            checkCompileErrors(ID, "PROGRAM");
+
+            glDeleteShader(compute);
+        }
+
+        // tessellated program: vertex, tessellation control, tessellation evaluation and fragment shaders
+        Shader(const char* vertexPath, const char* tessControlPath, const char* tessEvaluationPath, const char* fragmentPath) {
+            const char* paths[4] = { vertexPath, tessControlPath, tessEvaluationPath, fragmentPath };
+            const GLenum types[4] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_FRAGMENT_SHADER };
+            const char* names[4] = { "VERTEX", "TESS_CONTROL", "TESS_EVALUATION", "FRAGMENT" };
+            unsigned int stages[4];
+
+            ID = glCreateProgram();
+            for (int s = 0; s < 4; s ++) {
+                string code;
+                std::ifstream file;
+                file.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+
+                try {
+                    file.open(paths[s]);
+                    std::stringstream stream;
+                    stream << file.rdbuf();
+                    file.close();
+                    code = stream.str();
+                } catch (std::ifstream::failure& e) {
+                    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+                }
+
+                const char* source = code.c_str();
+                stages[s] = glCreateShader(types[s]);
+                glShaderSource(stages[s], 1, &source, NULL);
+                glCompileShader(stages[s]);
+                checkCompileErrors(stages[s], names[s]);
+                glAttachShader(ID, stages[s]);
+            }
+            glLinkProgram(ID);
+            checkCompileErrors(ID, "PROGRAM");
+
+            for (int s = 0; s < 4; s ++)
+                glDeleteShader(stages[s]);
+        }
+
         void use() { 
             glUseProgram(ID); 
         }
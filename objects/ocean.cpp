@@ -0,0 +1,327 @@
+/**
+ * @file ocean.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Spectral (Tessendorf) ocean. A Phillips or JONSWAP spectrum of n x n waves is evolved in frequency space and inverse FFT'd every frame
+ *        to periodic grids of height, slope and horizontal displacement, at O(n^2 log n) per frame however many waves there are
+ * @version 0.1
+ * @date 2022-06-19
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "ocean.h"
+#include "simdmath.h"
+
+#include <math.h>
+
+/**
+ * @brief Returns a standard normal random number (Box-Muller over a xorshift generator, so the ocean only depends on its seed)
+ *
+ * @param state Generator state (advanced)
+ * @return float
+ */
+static float gaussian(uint32_t& state) {
+    float u[2];
+    for (int i = 0; i < 2; i ++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        u[i] = ((state >> 8) + 0.5f) / 16777216.0f;
+    }
+    return sqrtf(-2 * logf(u[0])) * cosf(2 * (float)M_PI * u[1]);
+}
+
+/**
+ * @brief Energy density of the wave spectrum at wave vector k (per unit area of k)
+ *
+ * @param spectrum Spectrum to evaluate
+ * @param kx x component of the wave vector
+ * @param kz z component of the wave vector
+ * @param wind Wind speed (m/s)
+ * @param windX x component of the (unit) wind direction
+ * @param windZ z component of the (unit) wind direction
+ * @return float
+ */
+static float spectrumDensity(OceanSpectrum spectrum, float kx, float kz, float wind, float windX, float windZ) {
+    float k = sqrtf(kx * kx + kz * kz);
+    if (k < 1e-6f)
+        return 0;
+
+    float cosine = (kx * windX + kz * windZ) / k;
+
+    if (spectrum == OCEAN_JONSWAP) {
+        // S(w) = alpha g^2 / w^5 exp (-5/4 (wp / w)^4) gamma^r, moved to k through w^2 = g k, spread by cos^2 of the angle to the wind
+        float g = OCEAN_GRAVITY;
+        float omega = sqrtf(g * k);
+        float alpha = 0.076f * powf(wind * wind / (OCEAN_FETCH * g), 0.22f);
+        float omegaP = 22 * powf(g * g / (wind * OCEAN_FETCH), 1.0f / 3.0f);
+        float sigma = (omega <= omegaP) ? 0.07f : 0.09f;
+        float r = expf(-(omega - omegaP) * (omega - omegaP) / (2 * sigma * sigma * omegaP * omegaP));
+        float S = alpha * g * g / powf(omega, 5) * expf(-1.25f * powf(omegaP / omega, 4)) * powf(3.3f, r);
+
+        // dw/dk = g / (2 w), per unit area of k divides by k
+        return S * g / (2 * omega) / k * cosine * cosine / (float)M_PI;
+    }
+
+    // P(k) = exp (-1 / (k Lw)^2) / k^4 |k dot wind|^2, Lw = V^2 / g, with waves much shorter than Lw damped
+    float Lw = wind * wind / OCEAN_GRAVITY;
+    float damping = Lw / 1000;
+    return expf(-1 / (k * Lw * k * Lw)) / (k * k * k * k) * cosine * cosine * expf(-k * k * damping * damping);
+}
+
+/**
+ * @brief Construct a new Ocean object, drawing the random amplitudes of every wave
+ *
+ * @param n Number of waves (and grid points) along each side of the patch (rounded up to a power of two)
+ * @param length Side of the periodic patch
+ * @param spectrum OCEAN_PHILLIPS or OCEAN_JONSWAP
+ * @param wind Wind speed (m/s)
+ * @param windX x component of the wind direction
+ * @param windZ z component of the wind direction
+ * @param amplitude Scale of the spectrum (1 - as given by the Phillips/JONSWAP formulas)
+ * @param choppiness Scale of the horizontal displacement of the vertices (0 - none)
+ * @param seed Seed of the random amplitudes
+ */
+Ocean::Ocean(int n, float length, OceanSpectrum spectrum, float wind, float windX, float windZ, float amplitude, float choppiness, uint32_t seed) : L(length), choppiness(choppiness), curTime(0), synthesized(false) {
+    this->n = 2;
+    while (this->n < n)
+        this->n *= 2;
+    n = this->n;
+    fft.init(n);
+
+    float windLength = sqrtf(windX * windX + windZ * windZ);
+    if (windLength > 0) {
+        windX /= windLength;
+        windZ /= windLength;
+    }
+
+    int waves = n * n;
+    kx.resize(waves); kz.resize(waves);
+    kxUnit.resize(waves); kzUnit.resize(waves);
+    omega.resize(waves);
+    h0Re.resize(waves); h0Im.resize(waves);
+    h0mRe.resize(waves); h0mIm.resize(waves);
+    phase.resize(waves); sinPhase.resize(waves); cosPhase.resize(waves);
+    for (int g = 0; g < 3; g ++) {
+        gridRe[g].resize(waves);
+        gridIm[g].resize(waves);
+    }
+
+    // h~0(k) = (xi_r + i xi_i) sqrt (P(k) dk^2 / 2), with the Nyquist row and column left empty so every grid comes out real
+    uint32_t state = seed ? seed : 1;
+    float dk = 2 * (float)M_PI / L;
+    for (int v = 0; v < n; v ++) {
+        for (int u = 0; u < n; u ++) {
+            int i = v * n + u;
+            int su = (u < n / 2) ? u : u - n;
+            int sv = (v < n / 2) ? v : v - n;
+            kx[i] = su * dk;
+            kz[i] = sv * dk;
+
+            float k = sqrtf(kx[i] * kx[i] + kz[i] * kz[i]);
+            kxUnit[i] = (k > 0) ? kx[i] / k : 0;
+            kzUnit[i] = (k > 0) ? kz[i] / k : 0;
+            omega[i] = sqrtf(OCEAN_GRAVITY * k);
+
+            float xr = gaussian(state), xi = gaussian(state);
+            if (u == n / 2 || v == n / 2)
+                continue;
+
+            float scale = sqrtf(amplitude * spectrumDensity(spectrum, kx[i], kz[i], wind, windX, windZ) / 2) * dk;
+            h0Re[i] = xr * scale;
+            h0Im[i] = xi * scale;
+        }
+    }
+    for (int v = 0; v < n; v ++) {
+        for (int u = 0; u < n; u ++) {
+            int m = ((n - v) % n) * n + (n - u) % n;
+            h0mRe[v * n + u] = h0Re[m];
+            h0mIm[v * n + u] = 0 - h0Im[m];
+        }
+    }
+}
+
+/**
+ * @brief Evolves rows [first, last) of the spectrum to the current time and packs them, two real grids per complex grid
+ *
+ * @param first First row (v)
+ * @param last One past the last row
+ */
+void Ocean::fillSpectrum(int first, int last) {
+    int i0 = first * n, count = (last - first) * n;
+
+    for (int i = i0; i < i0 + count; i ++)
+        phase[i] = omega[i] * curTime;
+    sincosArray(&phase[i0], &sinPhase[i0], &cosPhase[i0], count);
+
+    for (int i = i0; i < i0 + count; i ++) {
+        float s = sinPhase[i], c = cosPhase[i];
+
+        // h~ = h~0 e^(iwt) + conj(h~0(-k)) e^(-iwt)
+        float hr = (h0Re[i] + h0mRe[i]) * c - (h0Im[i] - h0mIm[i]) * s;
+        float hi = (h0Im[i] + h0mIm[i]) * c + (h0Re[i] - h0mRe[i]) * s;
+
+        // slopes i k h~, displacements -i k / |k| h~, packed as A + iB
+        float ux = kxUnit[i] * choppiness, uz = kzUnit[i] * choppiness;
+        gridRe[0][i] = hr - kx[i] * hr;
+        gridIm[0][i] = hi - kx[i] * hi;
+        gridRe[1][i] = ux * hr - kz[i] * hi;
+        gridIm[1][i] = kz[i] * hr + ux * hi;
+        gridRe[2][i] = uz * hi;
+        gridIm[2][i] = 0 - uz * hr;
+    }
+}
+
+/**
+ * @brief Synthesizes the height, slope and displacement grids at time t: evolves the spectrum (tiles of rows on the pool) then runs three inverse FFTs
+ *
+ * @param t Time elapsed
+ * @param pool Thread pool (NULL - single threaded)
+ */
+void Ocean::setTime(float t, ThreadPool* pool) {
+    if (synthesized && t == curTime)
+        return;
+    curTime = t;
+
+    if (pool) {
+        pool->parallelFor(n, FFT_STRIP, [this](int first, int last) { fillSpectrum(first, last); });
+    } else {
+        fillSpectrum(0, n);
+    }
+
+    for (int g = 0; g < 3; g ++) {
+        fft.inverse2D(gridRe[g].data(), gridIm[g].data(), pool);
+    }
+    synthesized = true;
+}
+
+/**
+ * @brief Samples periodic n x n grids of a patch of side L along a row of points sharing an x coordinate, bilinearly and wrapping around the patch
+ *
+ * @param grids Grids to sample, indexed [ix * n + iz]
+ * @param outs Returned array of count samples per grid (NULL - grid skipped)
+ * @param gridCount Number of grids
+ * @param n Points along each side of the grids (a power of two)
+ * @param L Side of the patch
+ * @param x x coordinate of the row
+ * @param z Array of count z coordinates
+ * @param count Number of points in the row
+ */
+static void sampleGrids(const float* const* grids, float* const* outs, int gridCount, int n, float L, float x, const float* z, int count) {
+    float scale = n / L;
+    int mask = n - 1;   // n is a power of two, so masking wraps negative indices too
+
+    // floor through an int conversion (floorf is a libm call on baseline x86-64)
+    float u = x * scale;
+    int iu = (int)u - (u < (int)u);
+    float a = u - iu;
+    int r0 = iu & mask;
+    int r1 = (r0 + 1) & mask;
+
+    // columns and weights are shared by every grid
+    vector<int> c0(count), c1(count);
+    vector<float> b(count);
+    for (int j = 0; j < count; j ++) {
+        float v = z[j] * scale;
+        int iv = (int)v - (v < (int)v);
+        b[j] = v - iv;
+        c0[j] = iv & mask;
+        c1[j] = (iv + 1) & mask;
+    }
+
+    for (int g = 0; g < gridCount; g ++) {
+        if (!outs[g])
+            continue;
+        const float* row0 = grids[g] + (size_t)r0 * n;
+        const float* row1 = grids[g] + (size_t)r1 * n;
+        float* out = outs[g];
+
+        for (int j = 0; j < count; j ++) {
+            float top = row0[c0[j]] + (row0[c1[j]] - row0[c0[j]]) * b[j];
+            float bottom = row1[c0[j]] + (row1[c1[j]] - row1[c0[j]]) * b[j];
+            out[j] = top + (bottom - top) * a;
+        }
+    }
+}
+
+/**
+ * @brief Samples the grids along a row of points sharing an x coordinate, bilinearly and wrapping around the patch
+ *
+ * @param x x coordinate of the row
+ * @param z Array of count z coordinates
+ * @param count Number of points in the row
+ * @param h Returned array of heights
+ * @param dhdx Returned array of partials in respect to x
+ * @param dhdz Returned array of partials in respect to z
+ * @param dispX Returned array of displacements along x (NULL - not returned)
+ * @param dispZ Returned array of displacements along z (NULL - not returned)
+ */
+void Ocean::sampleRow(float x, const float* z, int count, float* h, float* dhdx, float* dhdz, float* dispX, float* dispZ) const {
+    const float* grids[5] = { heights(), slopesX(), slopesZ(), displacementsX(), displacementsZ() };
+    float* outs[5] = { h, dhdx, dhdz, dispX, dispZ };
+    sampleGrids(grids, outs, 5, n, L, x, z, count);
+}
+
+/**
+ * @brief Copies the height and slope grids at the current time (the displacements stay behind: the normal map has no use for them)
+ *
+ * @param out Returned snapshot
+ */
+void Ocean::snapshot(OceanSnapshot& out) const {
+    size_t points = (size_t)n * n;
+    out.n = n;
+    out.length = L;
+    out.time = curTime;
+    out.heights.assign(heights(), heights() + points);
+    out.slopesX.assign(slopesX(), slopesX() + points);
+    out.slopesZ.assign(slopesZ(), slopesZ() + points);
+}
+
+/**
+ * @brief Samples the copied grids along a row of points sharing an x coordinate, as Ocean::sampleRow does
+ *
+ * @param x x coordinate of the row
+ * @param z Array of count z coordinates
+ * @param count Number of points in the row
+ * @param h Returned array of heights
+ * @param dhdx Returned array of partials in respect to x
+ * @param dhdz Returned array of partials in respect to z
+ */
+void OceanSnapshot::sampleRow(float x, const float* z, int count, float* h, float* dhdx, float* dhdz) const {
+    const float* grids[3] = { heights.data(), slopesX.data(), slopesZ.data() };
+    float* outs[3] = { h, dhdx, dhdz };
+    sampleGrids(grids, outs, 3, n, length, x, z, count);
+}
+
+/**
+ * @brief Sums every wave of the spectrum at grid point (ix, iz) at the current time, in double precision
+ *
+ * @param ix Grid index along x
+ * @param iz Grid index along z
+ * @param h Returned height
+ * @param dhdx Returned partial in respect to x
+ * @param dhdz Returned partial in respect to z
+ * @param dispX Returned displacement along x
+ * @param dispZ Returned displacement along z
+ */
+void Ocean::directSum(int ix, int iz, double& h, double& dhdx, double& dhdz, double& dispX, double& dispZ) const {
+    h = 0; dhdx = 0; dhdz = 0; dispX = 0; dispZ = 0;
+    double x = (double)ix * L / n, z = (double)iz * L / n;
+
+    for (int i = 0; i < n * n; i ++) {
+        double wt = (double)omega[i] * curTime;
+        double c = cos(wt), s = sin(wt);
+        double hr = ((double)h0Re[i] + h0mRe[i]) * c - ((double)h0Im[i] - h0mIm[i]) * s;
+        double hi = ((double)h0Im[i] + h0mIm[i]) * c + ((double)h0Re[i] - h0mRe[i]) * s;
+
+        // real part of h~ e^(ikx) and of its slopes/displacements
+        double kdotx = kx[i] * x + kz[i] * z;
+        double er = cos(kdotx), ei = sin(kdotx);
+        double re = hr * er - hi * ei, im = hr * ei + hi * er;
+        h += re;
+        dhdx -= kx[i] * im;
+        dhdz -= kz[i] * im;
+        dispX += (double)kxUnit[i] * choppiness * im;
+        dispZ += (double)kzUnit[i] * choppiness * im;
+    }
+}
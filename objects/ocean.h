@@ -0,0 +1,109 @@
+/**
+ * @file ocean.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Spectral (Tessendorf) ocean. A Phillips or JONSWAP spectrum of n x n waves is evolved in frequency space and inverse FFT'd every frame
+ *        to periodic grids of height, slope and horizontal displacement, at O(n^2 log n) per frame however many waves there are
+ * @version 0.1
+ * @date 2022-06-19
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef OCEAN_H
+#define OCEAN_H
+
+#include "wavefield.h"
+#include "threadpool.h"
+#include "fft.h"
+
+#include <vector>
+using std::vector;
+
+#include <stdint.h>
+
+// gravitational acceleration (m/s^2)
+#define OCEAN_GRAVITY 9.81f
+
+// distance over which the wind has blown, for the JONSWAP spectrum (m)
+#define OCEAN_FETCH 100000.0f
+
+// wave spectra the ocean can be built from
+enum OceanSpectrum {
+    OCEAN_PHILLIPS=0,   // Phillips spectrum (Tessendorf), fully developed sea
+    OCEAN_JONSWAP=1     // JONSWAP spectrum, fetch limited sea with a sharper peak
+};
+
+/**
+ * @brief Height and slope grids of an ocean at one time, copied out of it (see Ocean::snapshot) so another thread can sample them while the ocean
+ *        moves on. Sampled exactly as the ocean samples itself
+ */
+struct OceanSnapshot {
+    int n;
+    float length;
+    float time;
+    vector<float> heights, slopesX, slopesZ;
+
+    OceanSnapshot() : n(0), length(0), time(0) {}
+
+    void sampleRow(float x, const float* z, int count, float* h, float* dhdx, float* dhdz) const;
+};
+
+/**
+ * @brief Periodic patch of ocean of size length x length built from n x n waves. For wave vectors k of the patch
+ *        h(x, t) = sum of h~(k, t) e^(i k dot x), h~(k, t) = h~0(k) e^(i w(k) t) + conj(h~0(-k)) e^(-i w(k) t), w(k)^2 = g |k|
+ *        and the slopes (i k h~) and choppy displacements (-i k / |k| h~) come out of the same spectrum. Heights are packed two real grids per complex
+ *        FFT, so a frame costs three n x n inverse FFTs
+ */
+class Ocean {
+    public:
+        Ocean(int n, float length, OceanSpectrum spectrum, float wind, float windX, float windZ, float amplitude, float choppiness, uint32_t seed = 1);
+
+        int size() const { return n; }
+        float length() const { return L; }
+        float time() const { return curTime; }
+
+        // synthesizes every grid at time t (does nothing if they already hold time t)
+        void setTime(float t, ThreadPool* pool);
+
+        // bilinear, periodic samples of the grids along a row of points sharing an x coordinate. Either displacement may be NULL
+        void sampleRow(float x, const float* z, int count, float* h, float* dhdx, float* dhdz, float* dispX, float* dispZ) const;
+
+        // copies the height and slope grids at the current time into out (reusing its storage)
+        void snapshot(OceanSnapshot& out) const;
+
+        // direct O(n^2) sum of every wave at grid point (ix, iz), to check the FFT against
+        void directSum(int ix, int iz, double& h, double& dhdx, double& dhdz, double& dispX, double& dispZ) const;
+
+        // grids at the current time, n x n, indexed [ix * n + iz] for the point (ix * length / n, iz * length / n)
+        const float* heights() const { return gridRe[0].data(); }
+        const float* slopesX() const { return gridIm[0].data(); }
+        const float* slopesZ() const { return gridRe[1].data(); }
+        const float* displacementsX() const { return gridIm[1].data(); }
+        const float* displacementsZ() const { return gridRe[2].data(); }
+
+    private:
+        void fillSpectrum(int first, int last);
+
+        int n;
+        float L;            // side of the patch
+        float choppiness;   // scale of the horizontal displacement (0 - none)
+        float curTime;
+        bool synthesized;
+
+        // per wave vector, indexed [v * n + u] for k = 2 pi / L (u, v) (u, v wrapped to [-n / 2, n / 2))
+        AlignedFloats kx, kz;           // wave vector
+        AlignedFloats kxUnit, kzUnit;   // k / |k| (0 for k = 0)
+        AlignedFloats omega;            // angular frequency
+        AlignedFloats h0Re, h0Im;       // h~0(k)
+        AlignedFloats h0mRe, h0mIm;     // conj(h~0(-k))
+
+        // scratch for the sin/cos of w(k) t
+        AlignedFloats phase, sinPhase, cosPhase;
+
+        // packed spectra, then grids: (height, slope x), (slope z, displacement x), (displacement z, unused)
+        AlignedFloats gridRe[3], gridIm[3];
+
+        FFT fft;
+};
+
+#endif
@@ -0,0 +1,309 @@
+/**
+ * @file photons.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Forward caustics on the CPU: a jittered grid of sun rays emitted at the water, refracted by the normal of the waves in SIMD batches,
+ *        followed down to the receiver plane and splatted into per-thread fixed point bins, summed without atomics. Same images as
+ *        CausticReference (1 - the light through still water), so photon counts can be traded against its samples
+ * @version 0.1
+ * @date 2022-07-01
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "photons.h"
+#include "simdmath.h"
+
+#include <string.h>
+#include <math.h>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+// what every photon of a render shares: refraction, depth of the receiver plane and the light space of the image (in texels)
+struct PhotonFrame {
+    float eta, eta2, ior;   // air over water, its square, water over air
+    float depth;
+    float shiftX, shiftZ;   // moves a landing point back up the refracted sunlight of still water, onto the origin of the water
+    float scaleU, scaleV;   // texels per unit along x, z
+    float stillInv;         // 1 / Fresnel transmission of still water
+};
+
+/**
+ * @brief Integer hash (mixes every bit of x into every bit of the result)
+ */
+static uint32_t hashBits(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * @brief Uniform float in [0, 1) from a hash
+ */
+static float unitFloat(uint32_t bits) {
+    return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @brief Unpolarized Fresnel transmission from air into water
+ *
+ * @param cosI Cosine of the incidence angle
+ * @param cosT Cosine of the refraction angle
+ * @param ior Water over air
+ * @return float
+ */
+static float transmission(float cosI, float cosT, float ior) {
+    float a = ior * cosT, b = ior * cosI;
+    float rs = (cosI - a) / (cosI + a);
+    float rp = (b - cosT) / (b + cosT);
+    return 1.0f - (rs * rs + rp * rp) * 0.5f;
+}
+
+/**
+ * @brief Scalar landing kernel: refracts n photons into the water (Snell's law about the normal of the waves where they enter), follows them down
+ *        to the receiver plane and returns where they land in texels and the energy they carry. The same operations, in the same order, as the
+ *        SSE2 kernel
+ *
+ * @param frame Shared parameters
+ * @param x, z Entry points
+ * @param h, dhdx, dhdz Height and partials of the waves there
+ * @param lx, ly, lz Unit directions towards the sun
+ * @param n Photons
+ * @param u, v Returned landing points (texels, centers at integers)
+ * @param energy Returned energy (1 - still water)
+ */
+static void landPhotonsScalar(const PhotonFrame& frame, const float* x, const float* z, const float* h, const float* dhdx, const float* dhdz,
+                              const float* lx, const float* ly, const float* lz, int n, float* u, float* v, float* energy) {
+    for (int k = 0; k < n; k ++) {
+        float inv = 1.0f / sqrtf((dhdx[k] * dhdx[k] + dhdz[k] * dhdz[k]) + 1.0f);
+        float nx = (0 - dhdx[k]) * inv, ny = inv, nz = (0 - dhdz[k]) * inv;
+
+        float cosI = (lx[k] * nx + ly[k] * ny) + lz[k] * nz;
+        float cosT = sqrtf(1.0f - frame.eta2 * (1.0f - cosI * cosI));
+        float m = frame.eta * cosI - cosT;
+        float tx = m * nx - frame.eta * lx[k], ty = m * ny - frame.eta * ly[k], tz = m * nz - frame.eta * lz[k];
+
+        float s = (h[k] + frame.depth) / (0 - ty);
+        u[k] = ((x[k] + tx * s) + frame.shiftX) * frame.scaleU - 0.5f;
+        v[k] = ((z[k] + tz * s) + frame.shiftZ) * frame.scaleV - 0.5f;
+        energy[k] = transmission(cosI, cosT, frame.ior) * frame.stillInv;
+    }
+}
+
+#ifdef SIMD_X86
+
+/**
+ * @brief SSE2 landing kernel, PHOTONS_BATCH photons at a time (the rest go through the scalar kernel). Same arguments as landPhotonsScalar
+ */
+static void landPhotonsSSE2(const PhotonFrame& frame, const float* x, const float* z, const float* h, const float* dhdx, const float* dhdz,
+                            const float* lx, const float* ly, const float* lz, int n, float* u, float* v, float* energy) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    const __m128 eta = _mm_set1_ps(frame.eta), eta2 = _mm_set1_ps(frame.eta2), ior = _mm_set1_ps(frame.ior), depth = _mm_set1_ps(frame.depth);
+    const __m128 shiftX = _mm_set1_ps(frame.shiftX), shiftZ = _mm_set1_ps(frame.shiftZ);
+    const __m128 scaleU = _mm_set1_ps(frame.scaleU), scaleV = _mm_set1_ps(frame.scaleV), stillInv = _mm_set1_ps(frame.stillInv);
+
+    int k = 0;
+    for (; k + PHOTONS_BATCH <= n; k += PHOTONS_BATCH) {
+        __m128 dx = _mm_loadu_ps(dhdx + k), dz = _mm_loadu_ps(dhdz + k);
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), one)));
+        __m128 nx = _mm_mul_ps(_mm_sub_ps(zero, dx), inv), ny = inv, nz = _mm_mul_ps(_mm_sub_ps(zero, dz), inv);
+
+        __m128 sx = _mm_loadu_ps(lx + k), sy = _mm_loadu_ps(ly + k), sz = _mm_loadu_ps(lz + k);
+        __m128 cosI = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, nx), _mm_mul_ps(sy, ny)), _mm_mul_ps(sz, nz));
+        __m128 cosT = _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(eta2, _mm_sub_ps(one, _mm_mul_ps(cosI, cosI)))));
+        __m128 m = _mm_sub_ps(_mm_mul_ps(eta, cosI), cosT);
+        __m128 tx = _mm_sub_ps(_mm_mul_ps(m, nx), _mm_mul_ps(eta, sx));
+        __m128 ty = _mm_sub_ps(_mm_mul_ps(m, ny), _mm_mul_ps(eta, sy));
+        __m128 tz = _mm_sub_ps(_mm_mul_ps(m, nz), _mm_mul_ps(eta, sz));
+
+        __m128 s = _mm_div_ps(_mm_add_ps(_mm_loadu_ps(h + k), depth), _mm_sub_ps(zero, ty));
+        __m128 px = _mm_add_ps(_mm_loadu_ps(x + k), _mm_mul_ps(tx, s));
+        __m128 pz = _mm_add_ps(_mm_loadu_ps(z + k), _mm_mul_ps(tz, s));
+        _mm_storeu_ps(u + k, _mm_sub_ps(_mm_mul_ps(_mm_add_ps(px, shiftX), scaleU), half));
+        _mm_storeu_ps(v + k, _mm_sub_ps(_mm_mul_ps(_mm_add_ps(pz, shiftZ), scaleV), half));
+
+        __m128 a = _mm_mul_ps(ior, cosT), b = _mm_mul_ps(ior, cosI);
+        __m128 rs = _mm_div_ps(_mm_sub_ps(cosI, a), _mm_add_ps(cosI, a));
+        __m128 rp = _mm_div_ps(_mm_sub_ps(b, cosT), _mm_add_ps(b, cosT));
+        __m128 t = _mm_sub_ps(one, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(rs, rs), _mm_mul_ps(rp, rp)), half));
+        _mm_storeu_ps(energy + k, _mm_mul_ps(t, stillInv));
+    }
+
+    landPhotonsScalar(frame, x + k, z + k, h + k, dhdx + k, dhdz + k, lx + k, ly + k, lz + k, n - k, u + k, v + k, energy + k);
+}
+
+#endif
+
+/**
+ * @brief Construct a new PhotonSplatter object
+ *
+ * @param waves Waves of the water (copied)
+ * @param origin x, z of the first vertex of the water
+ * @param size Extent of the water along x, z
+ * @param level Height of still water
+ */
+PhotonSplatter::PhotonSplatter(const WaveField& waves, const glm::vec2& origin, const glm::vec2& size, float level) : waves(waves), origin(origin),
+    size(size), level(level), depth(CAUSTICREF_DEPTH), light(0, 1, 0), sunRadius(CAUSTICREF_SUN_RADIUS), perSide(PHOTONS_PER_SIDE), seed(1),
+    margin(0), emittedCount(0), landedCount(0) {
+
+}
+
+/**
+ * @brief Sets the direction towards the sun
+ *
+ * @param direction Direction (normalized here; must point above the horizon)
+ */
+void PhotonSplatter::setLight(const glm::vec3& direction) {
+    light = glm::normalize(direction);
+}
+
+/**
+ * @brief How far from where still water would land it a photon can land: the sun's disc refracted, plus twice the steepest tilt of the waves
+ *        found over a lattice of the water times how far a tilt turns a refracted ray (1 - 1 / IOR), carried down to the receiver plane
+ *
+ * @param t Water time
+ * @return float
+ */
+float PhotonSplatter::spread(float t) const {
+    int lattice = PHOTONS_SLOPE_LATTICE;
+    vector<float> z(lattice), h(lattice), dhdx(lattice), dhdz(lattice);
+    for (int j = 0; j < lattice; j ++)
+        z[j] = origin.y + (j + 0.5f) * size.y / lattice;
+    float steepest = 0;
+    for (int i = 0; i < lattice; i ++) {
+        waves.evaluateRow(origin.x + (i + 0.5f) * size.x / lattice, &z[0], lattice, t, &h[0], &dhdx[0], &dhdz[0]);
+        for (int j = 0; j < lattice; j ++)
+            steepest = fmaxf(steepest, sqrtf(dhdx[j] * dhdx[j] + dhdz[j] * dhdz[j]));
+    }
+    float angle = fminf(sunRadius / CAUSTICREF_IOR + 2 * atanf(steepest) * (1 - 1 / CAUSTICREF_IOR), 1.0f);
+    return depth * tanf(angle);
+}
+
+/**
+ * @brief Emits a block of rows of photons over the water and its margin: every photon jittered within its cell of the grid and towards a point
+ *        of the sun's disc (both from a hash of its index), the waves evaluated at every entry point of a row at once, the row landed in SIMD
+ *        batches and added (in fixed point) to the texel of the bin of the task it lands in
+ *
+ * @param first First row (along x)
+ * @param last Row past the last
+ * @param t Water time
+ * @param width Columns of the image
+ * @param height Rows of the image
+ * @param bin Returned sums (added to)
+ * @param landed Returned photons that landed on the image (added to)
+ */
+void PhotonSplatter::emitRows(int first, int last, float t, int width, int height, vector<uint32_t>& bin, long& landed) const {
+    glm::vec3 refracted = glm::refract(0.0f - light, glm::vec3(0, 1, 0), 1.0f / CAUSTICREF_IOR);
+    glm::vec3 side = fabsf(light.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 0, 1);
+    glm::vec3 tangent = glm::normalize(glm::cross(light, side));
+    glm::vec3 bitangent = glm::cross(light, tangent);
+
+    PhotonFrame frame;
+    frame.ior = CAUSTICREF_IOR;
+    frame.eta = 1.0f / CAUSTICREF_IOR;
+    frame.eta2 = frame.eta * frame.eta;
+    frame.depth = depth;
+    frame.shiftX = refracted.x / refracted.y * depth - origin.x;
+    frame.shiftZ = refracted.z / refracted.y * depth - origin.y;
+    frame.scaleU = width / size.x;
+    frame.scaleV = height / size.y;
+    frame.stillInv = 1.0f / transmission(light.y, sqrtf(1.0f - frame.eta2 * (1.0f - light.y * light.y)), frame.ior);
+
+    int n = perSide;
+    vector<float> x(n), z(n), h(n), dhdx(n), dhdz(n), lx(n), ly(n), lz(n), phi(n), radius(n), sinPhi(n), cosPhi(n), u(n), v(n), energy(n);
+    glm::vec2 corner = origin - margin;
+    float cellX = (size.x + 2 * margin) / perSide, cellZ = (size.y + 2 * margin) / perSide;
+    bool simd = simdLevel() >= SIMD_SSE2;
+
+    for (int a = first; a < last; a ++) {
+        for (int b = 0; b < n; b ++) {
+            uint32_t state = hashBits(seed * 0x9e3779b9u ^ hashBits((uint32_t)a * perSide + b));
+            x[b] = corner.x + (a + unitFloat(state)) * cellX;
+            state = hashBits(state + 1);
+            z[b] = corner.y + (b + unitFloat(state)) * cellZ;
+            state = hashBits(state + 1);
+            radius[b] = sunRadius * sqrtf(unitFloat(state));
+            state = hashBits(state + 1);
+            phi[b] = 2 * (float)M_PI * unitFloat(state);
+        }
+
+        // a point of the sun's disc for every photon, then the waves at every entry point
+        sincosArray(&phi[0], &sinPhi[0], &cosPhi[0], n);
+        for (int b = 0; b < n; b ++) {
+            glm::vec3 l = glm::normalize(light + radius[b] * (cosPhi[b] * tangent + sinPhi[b] * bitangent));
+            lx[b] = l.x; ly[b] = l.y; lz[b] = l.z;
+        }
+        waves.evaluate(&x[0], &z[0], n, t, &h[0], &dhdx[0], &dhdz[0]);
+
+#ifdef SIMD_X86
+        if (simd)
+            landPhotonsSSE2(frame, &x[0], &z[0], &h[0], &dhdx[0], &dhdz[0], &lx[0], &ly[0], &lz[0], n, &u[0], &v[0], &energy[0]);
+        else
+#endif
+            landPhotonsScalar(frame, &x[0], &z[0], &h[0], &dhdx[0], &dhdz[0], &lx[0], &ly[0], &lz[0], n, &u[0], &v[0], &energy[0]);
+
+        for (int b = 0; b < n; b ++) {
+            // nearest texel center (texels are 1 apart, centers at integers)
+            float fu = floorf(u[b] + 0.5f), fv = floorf(v[b] + 0.5f);
+            if (!(fu >= 0 && fu < width && fv >= 0 && fv < height))
+                continue;
+            landed ++;
+            bin[(size_t)fv * width + (size_t)fu] += (uint32_t)lrintf(energy[b] * PHOTONS_FIXED_ONE);
+        }
+    }
+}
+
+/**
+ * @brief Renders the receiver plane: the rows of photons are split into one block per thread of pool, each splatted into a bin of its own, then
+ *        the bins are summed texel by texel and scaled so still water comes out 1 (photons emitted over the area of a texel times the energy of
+ *        still water)
+ *
+ * @param t Water time
+ * @param width Columns
+ * @param height Rows
+ * @param out Returned image (width x height floats, row major)
+ * @param pool Threads to render on (NULL - calling thread)
+ */
+void PhotonSplatter::render(float t, int width, int height, float* out, ThreadPool* pool) {
+    int tasks = pool ? pool->size() : 1;
+    if (tasks > perSide)
+        tasks = perSide;
+    size_t texels = (size_t)width * height;
+
+    margin = spread(t);
+    bins.resize(tasks);
+    landedBy.assign(tasks, 0);
+    for (int k = 0; k < tasks; k ++)
+        bins[k].assign(texels, 0);
+
+    auto emit = [&](int first, int last) {
+        for (int k = first; k < last; k ++)
+            emitRows(k * perSide / tasks, (k + 1) * perSide / tasks, t, width, height, bins[k], landedBy[k]);
+    };
+    auto reduce = [&](int first, int last) {
+        double cell = (size.x + 2.0 * margin) * (size.y + 2.0 * margin) / ((double)perSide * perSide);
+        double scale = cell / ((double)size.x * size.y / texels) / PHOTONS_FIXED_ONE;
+        for (size_t i = (size_t)first * width; i < (size_t)last * width; i ++) {
+            uint64_t sum = 0;
+            for (int k = 0; k < tasks; k ++)
+                sum += bins[k][i];
+            out[i] = (float)(sum * scale);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(tasks, 1, emit);
+        pool->parallelFor(height, CAUSTICREF_TILE_ROWS, reduce);
+    } else {
+        emit(0, tasks);
+        reduce(0, height);
+    }
+
+    emittedCount = (long)perSide * perSide;
+    landedCount = 0;
+    for (int k = 0; k < tasks; k ++)
+        landedCount += landedBy[k];
+}
@@ -0,0 +1,83 @@
+/**
+ * @file photons.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Forward caustics on the CPU: a jittered grid of sun rays emitted at the water, refracted by the normal of the waves in SIMD batches,
+ *        followed down to the receiver plane and splatted into per-thread fixed point bins, summed without atomics. Same images as
+ *        CausticReference (1 - the light through still water), so photon counts can be traded against its samples
+ * @version 0.1
+ * @date 2022-07-01
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PHOTONS_H
+#define PHOTONS_H
+
+#include "wavefield.h"
+#include "threadpool.h"
+#include "causticref.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using std::vector;
+
+#include <stdint.h>
+
+// photons a side of the grid emitted over the water by default
+#define PHOTONS_PER_SIDE 512
+
+// rays refracted together (one SSE2 vector)
+#define PHOTONS_BATCH 4
+
+// lattice of the water searched for its steepest slope (a side), which sets how far beyond the water photons are emitted
+#define PHOTONS_SLOPE_LATTICE 64
+
+// fixed point of the bins: a photon of the energy of still water adds PHOTONS_FIXED_ONE (integer sums are the same in any order, so images do
+// not depend on how the photons were spread over the threads)
+#define PHOTONS_FIXED_ONE 4096.0f
+
+class PhotonSplatter {
+    public:
+        // caustics under a copy of waves, over the water of the given extent (x, z of its first vertex, extent along x, z) and rest height. Lit
+        // from straight above by a sun of CAUSTICREF_SUN_RADIUS, receivers CAUSTICREF_DEPTH below the water, until set otherwise
+        PhotonSplatter(const WaveField& waves, const glm::vec2& origin, const glm::vec2& size, float level = 0);
+
+        void setLight(const glm::vec3& direction);
+        void setDepth(float depth) { this->depth = depth; }
+        void setSun(float radius) { sunRadius = radius; }
+        void setPhotons(int perSide) { this->perSide = perSide < 1 ? 1 : perSide; }
+        void setSeed(uint32_t seed) { this->seed = seed; }
+
+        // width x height image of the receiver plane, laid out like CausticReference::render (and the caustic map), each texel the average over
+        // its area: perSide x perSide photons over the water and a margin around it, one bin per task of pool (NULL - the calling thread only).
+        // The same for any number of threads
+        void render(float t, int width, int height, float* out, ThreadPool* pool = NULL);
+
+        // photons emitted by the last render, how many of them landed on the image, and how far beyond the water they were emitted
+        long emitted() const { return emittedCount; }
+        long landed() const { return landedCount; }
+        float emissionMargin() const { return margin; }
+
+    private:
+        WaveField waves;
+        glm::vec2 origin, size;
+        float level, depth;
+        glm::vec3 light;
+        float sunRadius;
+        int perSide;
+        uint32_t seed;
+        float margin;
+
+        // one bin per task (reused between renders), and what the tasks of the last render counted
+        vector<vector<uint32_t> > bins;
+        vector<long> landedBy;
+        long emittedCount, landedCount;
+
+        // how far beyond the water photons can come from that land on it at time t
+        float spread(float t) const;
+        // emits photon rows [first, last) into bin
+        void emitRows(int first, int last, float t, int width, int height, vector<uint32_t>& bin, long& landed) const;
+};
+
+#endif
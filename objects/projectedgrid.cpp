@@ -0,0 +1,175 @@
+/**
+ * @file projectedgrid.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Projected grid (Johanson): a fixed grid in screen space, unprojected every frame through the view and projection of the camera onto the
+ *        plane of the water. Vertices land where the water is seen, as densely as the screen is, however large the body of water is and without
+ *        any vertex behind the camera
+ * @version 0.1
+ * @date 2022-06-24
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "projectedgrid.h"
+
+#include <math.h>
+
+/**
+ * @brief Construct a new ProjectedGrid object (not in view until the first update)
+ *
+ * @param columns Vertices across the screen (at least 2)
+ * @param rows Vertices up the screen (at least 2)
+ */
+ProjectedGrid::ProjectedGrid(int columns, int rows) : cols(columns < 2 ? 2 : columns), rowCount(rows < 2 ? 2 : rows), inView(false), lower(0.0f), upper(0.0f) {
+    planar.resize((size_t)cols * rowCount * PROJECTED_STATIC_FLOATS);
+    surface.resize((size_t)cols * rowCount * PROJECTED_DYNAMIC_FLOATS);
+
+    // a strip between every two neighbouring rows, each followed by a restart marker
+    for (int r = 0; r < rowCount - 1; r ++) {
+        for (int c = 0; c < cols; c ++) {
+            for (int k = 0; k < 2; k ++) {
+                indices.push_back(c + cols * (r + k));
+            }
+        }
+        indices.push_back(RESTART_INDEX);
+    }
+}
+
+/**
+ * @brief Unprojects the grid. The range of the screen to cover is found from the frustum: wherever its edges cross the slab of water
+ *        [level - height, level + height] (and wherever its corners lie inside it), the point straight below or above on the plane is projected
+ *        back to the screen. The grid spans the bounding box of those points (up to PROJECTED_OVERSCAN past the screen), and every vertex of it is
+ *        the hit of its ray with the plane, clamped to the far plane for rays that never come down to it
+ *
+ * @param view View matrix of the camera
+ * @param projection Projection matrix of the camera
+ * @param level Height of the plane of the water
+ * @param height Largest displacement of the surface from the plane (either way)
+ * @return bool whether any of the water is in view (nothing is unprojected otherwise)
+ */
+bool ProjectedGrid::update(const glm::mat4& view, const glm::mat4& projection, float level, float height) {
+    glm::mat4 viewProjection = projection * view;
+    glm::mat4 inverse = glm::inverse(viewProjection);
+
+    // corners of the frustum in world space, corner k at (x, y, z) = (k & 1, k & 2, k & 4) of the clip cube
+    glm::vec3 corners[8];
+    for (int k = 0; k < 8; k ++) {
+        glm::vec4 p = inverse * glm::vec4((k & 1) ? 1 : -1, (k & 2) ? 1 : -1, (k & 4) ? 1 : -1, 1);
+        corners[k] = glm::vec3(p) / p.w;
+    }
+
+    // points of the slab inside the frustum, flattened onto the plane
+    vector<glm::vec3> hits;
+    for (int k = 0; k < 8; k ++) {
+        if (fabsf(corners[k].y - level) <= height)
+            hits.push_back(glm::vec3(corners[k].x, level, corners[k].z));
+
+        // the (up to three) edges from corner k to the corners one bit higher
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (k & bit)
+                continue;
+            glm::vec3 a = corners[k], b = corners[k | bit];
+            for (int side = -1; side <= 1; side += 2) {
+                float plane = level + side * height;
+                if ((a.y - plane) * (b.y - plane) >= 0 || a.y == b.y)
+                    continue;
+                glm::vec3 p = a + (b - a) * ((plane - a.y) / (b.y - a.y));
+                hits.push_back(glm::vec3(p.x, level, p.z));
+            }
+        }
+    }
+
+    // part of the screen the water can show up in
+    lower = glm::vec2(1e30f);
+    upper = glm::vec2(-1e30f);
+    for (size_t h = 0; h < hits.size(); h ++) {
+        glm::vec4 clip = viewProjection * glm::vec4(hits[h], 1);
+        if (clip.w <= 0)
+            continue;
+        glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        lower = glm::min(lower, ndc);
+        upper = glm::max(upper, ndc);
+    }
+    lower = glm::max(lower, glm::vec2(-1 - PROJECTED_OVERSCAN));
+    upper = glm::min(upper, glm::vec2(1 + PROJECTED_OVERSCAN));
+
+    inView = (lower.x < upper.x && lower.y < upper.y);
+    if (!inView)
+        return false;
+
+    for (int r = 0; r < rowCount; r ++) {
+        float y = lower.y + (upper.y - lower.y) * r / (rowCount - 1);
+        float* vertex = &planar[(size_t)r * cols * PROJECTED_STATIC_FLOATS];
+        for (int c = 0; c < cols; c ++) {
+            float x = lower.x + (upper.x - lower.x) * c / (cols - 1);
+
+            // ray from the near to the far plane through this point of the screen
+            glm::vec4 nearPoint = inverse * glm::vec4(x, y, -1, 1);
+            glm::vec4 farPoint = inverse * glm::vec4(x, y, 1, 1);
+            glm::vec3 a = glm::vec3(nearPoint) / nearPoint.w, b = glm::vec3(farPoint) / farPoint.w;
+
+            float t = 1;
+            if (a.y != b.y) {
+                float hit = (level - a.y) / (b.y - a.y);
+                if (hit >= 0 && hit < 1)
+                    t = hit;
+            }
+            glm::vec3 p = a + (b - a) * t;
+
+            vertex[0] = p.x;
+            vertex[1] = p.z;
+            vertex += PROJECTED_STATIC_FLOATS;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Evaluates the sum of waves at every vertex of the grid, as unprojected by the last update
+ *
+ * @param field Waves to evaluate
+ * @param t Time
+ * @param pool Thread pool (NULL - single threaded)
+ */
+void ProjectedGrid::evaluate(const WaveField& field, float t, ThreadPool* pool) {
+    if (!inView)
+        return;
+
+    if (pool) {
+        pool->parallelFor(rowCount, PROJECTED_TILE_ROWS, [this, &field, t](int first, int last) { fillRows(field, first, last, t); });
+    } else {
+        fillRows(field, 0, rowCount, t);
+    }
+}
+
+/**
+ * @brief Evaluates rows [first, last) of the grid (the points of a row share no coordinate, so they go to the field as separate x and z)
+ *
+ * @param field Waves to evaluate
+ * @param first First row
+ * @param last One past the last row
+ * @param t Time
+ */
+void ProjectedGrid::fillRows(const WaveField& field, int first, int last, float t) {
+    vector<float> x(cols), z(cols), h(cols), dhdx(cols), dhdz(cols);
+
+    for (int r = first; r < last; r ++) {
+        const float* point = &planar[(size_t)r * cols * PROJECTED_STATIC_FLOATS];
+        for (int c = 0; c < cols; c ++) {
+            x[c] = point[c * PROJECTED_STATIC_FLOATS];
+            z[c] = point[c * PROJECTED_STATIC_FLOATS + 1];
+        }
+
+        field.evaluate(&x[0], &z[0], cols, t, &h[0], &dhdx[0], &dhdz[0]);
+
+        // N = <-dH/dx, -dH/dz, 1>
+        float* vertex = &surface[(size_t)r * cols * PROJECTED_DYNAMIC_FLOATS];
+        for (int c = 0; c < cols; c ++) {
+            vertex[0] = h[c];
+            vertex[1] = 0 - dhdx[c];
+            vertex[2] = 0 - dhdz[c];
+            vertex[3] = 1;
+            vertex += PROJECTED_DYNAMIC_FLOATS;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/**
+ * @file projectedgrid.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Projected grid (Johanson): a fixed grid in screen space, unprojected every frame through the view and projection of the camera onto the
+ *        plane of the water. Vertices land where the water is seen, as densely as the screen is, however large the body of water is and without
+ *        any vertex behind the camera
+ * @version 0.1
+ * @date 2022-06-24
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PROJECTEDGRID_H
+#define PROJECTEDGRID_H
+
+#include "wavefield.h"
+#include "threadpool.h"
+#include "restart.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using std::vector;
+
+// default vertices of the grid across and up the screen
+#define PROJECTED_COLUMNS 256
+#define PROJECTED_ROWS 256
+
+// how far past the edges of the screen (in normalized device coordinates) the grid may reach, to catch crests rising into view from below it
+#define PROJECTED_OVERSCAN 0.25f
+
+// floats per vertex of the static (x, z on the water plane) and dynamic (height, then the normal) streams, the same layout as the streams of Water
+#define PROJECTED_STATIC_FLOATS 2
+#define PROJECTED_DYNAMIC_FLOATS 4
+
+// grid rows per tile when the grid is evaluated on a thread pool
+#define PROJECTED_TILE_ROWS 16
+
+class ProjectedGrid {
+    public:
+        ProjectedGrid(int columns = PROJECTED_COLUMNS, int rows = PROJECTED_ROWS);
+
+        // unprojects the grid onto the plane y = level for the given camera, over the part of the screen where the water can show (the plane
+        // displaced by up to height either way). Returns whether any of it is in view
+        bool update(const glm::mat4& view, const glm::mat4& projection, float level, float height);
+
+        // evaluates the sum of waves at every vertex of the grid at time t (a tile of rows at a time on the pool, if any)
+        void evaluate(const WaveField& field, float t, ThreadPool* pool = NULL);
+
+        bool visible() const { return inView; }
+        int columns() const { return cols; }
+        int rows() const { return rowCount; }
+        int vertices() const { return cols * rowCount; }
+
+        // static stream (x, z) and dynamic stream (height, then the normal) of vertex c of row r (screen row, bottom up) at r * columns + c; both
+        // change every frame
+        vector<float> planar;
+        vector<float> surface;
+
+        // strips between every two neighbouring rows, separated by RESTART_INDEX (static)
+        vector<unsigned int> indices;
+
+        // part of the screen covered by the grid after the last update (normalized device coordinates)
+        glm::vec2 rangeMin() const { return lower; }
+        glm::vec2 rangeMax() const { return upper; }
+
+    private:
+        void fillRows(const WaveField& field, int first, int last, float t);
+
+        int cols, rowCount;
+        bool inView;
+        glm::vec2 lower, upper;
+};
+
+#endif
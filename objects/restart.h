@@ -0,0 +1,18 @@
+/**
+ * @file restart.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Primitive restart index shared by every mesh of the water drawn as strips broken up in a single draw call (the grid, the clipmap levels,
+ *        the projected grid and the culled tiles)
+ * @version 0.1
+ * @date 2022-06-23
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef RESTART_H
+#define RESTART_H
+
+// index that restarts a strip (the fixed restart index of unsigned int indices)
+#define RESTART_INDEX 0xFFFFFFFFu
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file scheduler.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Time-sliced updates of the tiles of the water mesh: every frame only the tiles that matter most (largest on screen, longest since they
+ *        were evaluated) are brought up to date, as many as fit in a budget of milliseconds. Every tile keeps the time it was evaluated at
+ * @version 0.1
+ * @date 2022-06-26
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <math.h>
+
+/**
+ * @brief Construct a new TileScheduler object (no tiles until reset)
+ *
+ * @param budgetMs Milliseconds a frame of updates may take (0 - every candidate every frame)
+ */
+TileScheduler::TileScheduler(double budgetMs) : budget(budgetMs), costPerVertex(0) {
+    frame = SchedulerFrame();
+}
+
+/**
+ * @brief Forgets every tile: all of them are picked first by the next schedule
+ *
+ * @param tiles Number of tiles
+ */
+void TileScheduler::reset(int tiles) {
+    times.assign(tiles, 0.0f);
+    seen.assign(tiles, 0);
+    pickedMask.assign(tiles, 0);
+    picked.clear();
+}
+
+/**
+ * @brief Picks the tiles to update this frame. A tile is as important as it is large on screen (radius of its box over its distance, scaled
+ *        by the projection, squared) times how long ago (in water time) it was last evaluated; tiles entirely behind the camera or outside its
+ *        field of view never are
+ *
+ * @param tiles Tiles of the mesh
+ * @param view View matrix of the camera
+ * @param projection Projection matrix of the camera
+ * @param rowX x coordinate of every row of vertices
+ * @param columnZ z coordinate of every column of vertices
+ * @param bound Largest height of the surface either way
+ * @param time Water time of this update
+ * @param candidates Tiles that may be picked (NULL - every tile)
+ * @return const vector<int>& the tiles picked
+ */
+const vector<int>& TileScheduler::schedule(const TileGrid& tiles, const glm::mat4& view, const glm::mat4& projection, const float* rowX,
+                                           const float* columnZ, float bound, float time, const vector<int>* candidates) {
+    if ((int)times.size() != tiles.count())
+        reset(tiles.count());
+
+    for (size_t k = 0; k < picked.size(); k ++)
+        pickedMask[picked[k]] = 0;
+    picked.clear();
+    order.clear();
+    priority.assign(tiles.count(), 0.0f);
+
+    Frustum frustum(projection * view);
+    int count = candidates ? (int)candidates->size() : tiles.count();
+    for (int k = 0; k < count; k ++) {
+        int t = candidates ? (*candidates)[k] : k;
+
+        glm::vec3 lower, upper;
+        tiles.bounds(t, rowX, columnZ, bound, lower, upper);
+        if (!frustum.intersects(lower, upper))
+            continue;
+
+        // on-screen size of the bounding sphere of the box (fraction of the height of the screen)
+        glm::vec3 center = glm::vec3(view * glm::vec4((lower + upper) * 0.5f, 1));
+        float radius = glm::length(upper - lower) * 0.5f;
+        float distance = std::max(-center.z, radius);
+        float size = radius * projection[1][1] / distance;
+
+        float staleness = seen[t] ? std::max(time - times[t], 0.0f) + SCHEDULER_MIN_STALENESS : INFINITY;
+        priority[t] = size * size * staleness;
+        order.push_back(t);
+    }
+
+    std::sort(order.begin(), order.end(), [this](int a, int b) { return priority[a] > priority[b]; });
+
+    frame = SchedulerFrame();
+    frame.candidates = order.size();
+    for (size_t k = 0; k < order.size(); k ++) {
+        int t = order[k];
+        long vertices = tiles.tileVertices(t);
+        double cost = vertices * costPerVertex;
+
+        // the first tile always goes, then as many as fit (all of them while the cost of a vertex is unknown)
+        if (budget > 0 && costPerVertex > 0 && !picked.empty() && frame.estimatedMs + cost > budget) {
+            float staleness = seen[t] ? time - times[t] : INFINITY;
+            frame.maxStaleness = std::max(frame.maxStaleness, staleness);
+            continue;
+        }
+
+        picked.push_back(t);
+        pickedMask[t] = 1;
+        frame.vertices += vertices;
+        frame.estimatedMs += cost;
+
+        times[t] = time;
+        seen[t] = 1;
+    }
+    frame.scheduled = picked.size();
+    return picked;
+}
+
+/**
+ * @brief Feeds back the time the picked tiles took, into a running average of the cost of a vertex (the first measurement replaces the
+ *        unknown cost outright)
+ *
+ * @param elapsedMs Milliseconds the update took
+ * @param vertices Vertices it evaluated
+ */
+void TileScheduler::record(double elapsedMs, long vertices) {
+    if (vertices <= 0)
+        return;
+
+    double cost = elapsedMs / vertices;
+    costPerVertex = costPerVertex > 0 ? costPerVertex + (cost - costPerVertex) * SCHEDULER_COST_SMOOTHING : cost;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file scheduler.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Time-sliced updates of the tiles of the water mesh: every frame only the tiles that matter most (largest on screen, longest since they
+ *        were evaluated) are brought up to date, as many as fit in a budget of milliseconds. Every tile keeps the time it was evaluated at
+ * @version 0.1
+ * @date 2022-06-26
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "culling.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using std::vector;
+
+// default budget of a frame of updates, in milliseconds
+#define SCHEDULER_BUDGET_MS 2.0
+
+// weight of the latest frame in the running estimate of the cost of a vertex
+#define SCHEDULER_COST_SMOOTHING 0.2
+
+// staleness (seconds of water time) given to every tile, so the tiles of water that just came to a stop keep getting refreshed by size
+#define SCHEDULER_MIN_STALENESS 1e-3f
+
+// one frame of scheduling, for reporting
+struct SchedulerFrame {
+    int candidates;         // tiles that could be updated (in view)
+    int scheduled;          // tiles picked
+    long vertices;          // vertices of the tiles picked
+    double estimatedMs;     // cost of the tiles picked, from the running estimate
+    float maxStaleness;     // largest staleness of a candidate left out (water time)
+};
+
+class TileScheduler {
+    public:
+        TileScheduler(double budgetMs = SCHEDULER_BUDGET_MS);
+
+        // milliseconds a frame of updates may take (0 - every candidate every frame)
+        void setBudget(double budgetMs) { budget = budgetMs; }
+        double budgetMs() const { return budget; }
+
+        // forgets every tile (all of them never evaluated)
+        void reset(int tiles);
+
+        // picks the tiles to update at time: in view of the camera (and in candidates, if given), by descending priority (on-screen size times
+        // staleness, never evaluated tiles first) for as long as their estimated cost fits the budget (at least one tile). Marks them evaluated
+        // at time
+        const vector<int>& schedule(const TileGrid& tiles, const glm::mat4& view, const glm::mat4& projection, const float* rowX, const float* columnZ,
+                                    float bound, float time, const vector<int>* candidates = NULL);
+
+        // tiles picked by the last schedule, as a mask (one entry per tile)
+        const vector<int>& scheduled() const { return picked; }
+        const vector<unsigned char>& scheduledMask() const { return pickedMask; }
+
+        // feeds back how long the picked tiles took to evaluate, for the running estimate of the cost of a vertex
+        void record(double elapsedMs, long vertices);
+        double msPerVertex() const { return costPerVertex; }
+
+        // time tile t was last evaluated at (whether evaluated() yet)
+        float tileTime(int t) const { return times[t]; }
+        bool evaluated(int t) const { return seen[t]; }
+
+        const SchedulerFrame& lastFrame() const { return frame; }
+
+    private:
+        double budget;
+        double costPerVertex;   // 0 - unknown yet, every candidate is picked
+
+        vector<float> times;
+        vector<unsigned char> seen;
+
+        vector<int> picked;
+        vector<unsigned char> pickedMask;
+
+        // scratch: candidates and their priorities
+        vector<int> order;
+        vector<float> priority;
+
+        SchedulerFrame frame;
+};
+
+#endif
@@ -0,0 +1,484 @@
+/**
+ * @file simdmath.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Vectorized single precision sin/cos for whole arrays, with SSE2, AVX2, AVX-512 and scalar implementations. The widest implementation supported by the processor is picked at startup (CPUID)
+ * @version 0.1
+ * @date 2022-06-15
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "simdmath.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+// keep every level on the same sequence of roundings (the AVX-512 target would otherwise contract into fused multiply-adds)
+#pragma GCC optimize ("fp-contract=off")
+
+// Cephes sinf/cosf constants
+#define FOPI 1.27323954473516f          // 4 / pi
+#define DP1 0.78515625f                 // pi / 4 split in three parts (extended precision reduction)
+#define DP2 2.4187564849853515625e-4f
+#define DP3 3.77489497744594108e-8f
+#define SIN0 -1.9515295891e-4f          // sine polynomial on [-pi/4, pi/4]
+#define SIN1 8.3321608736e-3f
+#define SIN2 -1.6666654611e-1f
+#define COS0 2.443315711809948e-5f      // cosine polynomial on [-pi/4, pi/4]
+#define COS1 -1.388731625493765e-3f
+#define COS2 4.166664568298827e-2f
+
+typedef void (*SincosKernel)(const float* x, float* s, float* c, int n);
+
+/**
+ * @brief Scalar sin/cos of a single float. Follows the exact operation order of the vector kernels
+ *
+ * @param x Argument in radians
+ * @param s Returned sine of x
+ * @param c Returned cosine of x
+ */
+void sincosScalar(float x, float& s, float& c) {
+    float ax = fabsf(x);
+    if (!(ax <= SIMD_SINCOS_MAXARG)) {
+        s = sinf(x);
+        c = cosf(x);
+        return;
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(float));
+    uint32_t signSin = bits & 0x80000000u;
+
+    // octant (rounded up to even so the remainder lies in [-pi/4, pi/4])
+    int j = (int)(ax * FOPI);
+    j = (j + 1) & ~1;
+    float y = (float)j;
+
+    uint32_t swapSin = (uint32_t)(j & 4) << 29;
+    uint32_t signCos = (uint32_t)(~(j - 2) & 4) << 29;
+    bool polySwap = (j & 2) != 0;
+    signSin ^= swapSin;
+
+    float r = ((ax - y * DP1) - y * DP2) - y * DP3;
+    float z = r * r;
+
+    float yc = ((COS0 * z + COS1) * z + COS2) * z * z - 0.5f * z + 1.0f;
+    float ys = ((SIN0 * z + SIN1) * z + SIN2) * z * r + r;
+
+    float rs = polySwap ? yc : ys;
+    float rc = polySwap ? ys : yc;
+
+    uint32_t bs, bc;
+    memcpy(&bs, &rs, sizeof(float));
+    memcpy(&bc, &rc, sizeof(float));
+    bs ^= signSin;
+    bc ^= signCos;
+    memcpy(&s, &bs, sizeof(float));
+    memcpy(&c, &bc, sizeof(float));
+}
+
+/**
+ * @brief Scalar array kernel
+ */
+static void sincosKernelScalar(const float* x, float* s, float* c, int n) {
+    for (int i = 0; i < n; i ++) {
+        sincosScalar(x[i], s[i], c[i]);
+    }
+}
+
+/**
+ * @brief Snorm16 of a float already scaled to [-32767, 32767] (clamped, rounded to nearest even)
+ */
+static int16_t toSnorm16(float x) {
+    x = fminf(fmaxf(x, -SIMD_SNORM16_MAX), SIMD_SNORM16_MAX);
+    return (int16_t)lrintf(x);
+}
+
+/**
+ * @brief Scalar surface packing kernel (see packSurfaceArray), the same sequence of operations as the SSE2 kernel
+ */
+static void packKernelScalar(const float* surface, int16_t* packed, int n, float heightScale) {
+    for (int i = 0; i < n; i ++) {
+        const float* v = surface + i * 4;
+
+        // onto the octahedron |x| + |y| + |z| = 1, the lower half folded over the upper one
+        float inv = 1.0f / (fabsf(v[1]) + fabsf(v[2]) + fabsf(v[3]));
+        float ox = v[1] * inv, oy = v[2] * inv;
+        if (v[3] < 0) {
+            float fx = (1.0f - fabsf(oy)) * copysignf(1.0f, ox);
+            float fy = (1.0f - fabsf(ox)) * copysignf(1.0f, oy);
+            ox = fx;
+            oy = fy;
+        }
+
+        int16_t* p = packed + i * 4;
+        p[0] = toSnorm16(v[0] * heightScale);
+        p[1] = toSnorm16(ox * SIMD_SNORM16_MAX);
+        p[2] = toSnorm16(oy * SIMD_SNORM16_MAX);
+        p[3] = 0;
+    }
+}
+
+#ifdef SIMD_X86
+
+/**
+ * @brief SSE2 surface packing kernel, 4 vertices at a time (transposed into a vector per component, then interleaved back into vertices)
+ */
+__attribute__((target("sse2")))
+static void packKernelSSE2(const float* surface, int16_t* packed, int n, float heightScale) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 snormMax = _mm_set1_ps(SIMD_SNORM16_MAX);
+    const __m128 snormMin = _mm_set1_ps(-SIMD_SNORM16_MAX);
+    const __m128 scale = _mm_set1_ps(heightScale);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 h = _mm_loadu_ps(surface + i * 4);
+        __m128 x = _mm_loadu_ps(surface + i * 4 + 4);
+        __m128 y = _mm_loadu_ps(surface + i * 4 + 8);
+        __m128 z = _mm_loadu_ps(surface + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(h, x, y, z);
+
+        __m128 inv = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z)));
+        __m128 ox = _mm_mul_ps(x, inv), oy = _mm_mul_ps(y, inv);
+
+        __m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, oy)), _mm_or_ps(one, _mm_and_ps(signMask, ox)));
+        __m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ox)), _mm_or_ps(one, _mm_and_ps(signMask, oy)));
+        __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        ox = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, ox));
+        oy = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, oy));
+
+        __m128i ih = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(h, scale), snormMin), snormMax));
+        __m128i ix = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(ox, snormMax), snormMin), snormMax));
+        __m128i iy = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(oy, snormMax), snormMin), snormMax));
+
+        // (h0..h3, x0..x3) and (y0..y3, 0..0), interleaved into (h, x, y, 0) per vertex
+        __m128i hx = _mm_packs_epi32(ih, ix);
+        __m128i y0 = _mm_packs_epi32(iy, _mm_setzero_si128());
+        __m128i hy = _mm_unpacklo_epi16(hx, y0);
+        __m128i x0 = _mm_unpackhi_epi16(hx, y0);
+        _mm_storeu_si128((__m128i*)(packed + i * 4), _mm_unpacklo_epi16(hy, x0));
+        _mm_storeu_si128((__m128i*)(packed + i * 4 + 8), _mm_unpackhi_epi16(hy, x0));
+    }
+    packKernelScalar(surface + i * 4, packed + i * 4, n - i, heightScale);
+}
+
+/**
+ * @brief SSE2 array kernel, 4 floats at a time
+ */
+__attribute__((target("sse2")))
+static void sincosKernelSSE2(const float* x, float* s, float* c, int n) {
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    const __m128 maxArg = _mm_set1_ps(SIMD_SINCOS_MAXARG);
+    const __m128i one = _mm_set1_epi32(1), inv1 = _mm_set1_epi32(~1);
+    const __m128i two = _mm_set1_epi32(2), four = _mm_set1_epi32(4);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        __m128 ax = _mm_andnot_ps(signMask, v);
+
+        // out of range (or nan) lanes: scalar fallback for this vector
+        if (_mm_movemask_ps(_mm_cmple_ps(ax, maxArg)) != 0xF) {
+            sincosKernelScalar(x + i, s + i, c + i, 4);
+            continue;
+        }
+
+        __m128 signSin = _mm_and_ps(v, signMask);
+
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(ax, _mm_set1_ps(FOPI)));
+        j = _mm_and_si128(_mm_add_epi32(j, one), inv1);
+        __m128 y = _mm_cvtepi32_ps(j);
+
+        __m128 swapSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29));
+        __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, two), four), 29));
+        __m128 polySwap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, two), two));
+        signSin = _mm_xor_ps(signSin, swapSin);
+
+        __m128 r = _mm_sub_ps(ax, _mm_mul_ps(y, _mm_set1_ps(DP1)));
+        r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(DP2)));
+        r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(DP3)));
+        __m128 z = _mm_mul_ps(r, r);
+
+        __m128 yc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS0), z), _mm_set1_ps(COS1));
+        yc = _mm_add_ps(_mm_mul_ps(yc, z), _mm_set1_ps(COS2));
+        yc = _mm_mul_ps(_mm_mul_ps(yc, z), z);
+        yc = _mm_add_ps(_mm_sub_ps(yc, _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+
+        __m128 ys = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN0), z), _mm_set1_ps(SIN1));
+        ys = _mm_add_ps(_mm_mul_ps(ys, z), _mm_set1_ps(SIN2));
+        ys = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ys, z), r), r);
+
+        __m128 rs = _mm_or_ps(_mm_and_ps(polySwap, yc), _mm_andnot_ps(polySwap, ys));
+        __m128 rc = _mm_or_ps(_mm_and_ps(polySwap, ys), _mm_andnot_ps(polySwap, yc));
+
+        _mm_storeu_ps(s + i, _mm_xor_ps(rs, signSin));
+        _mm_storeu_ps(c + i, _mm_xor_ps(rc, signCos));
+    }
+
+    sincosKernelScalar(x + i, s + i, c + i, n - i);
+}
+
+/**
+ * @brief AVX2 array kernel, 8 floats at a time
+ */
+__attribute__((target("avx2")))
+static void sincosKernelAVX2(const float* x, float* s, float* c, int n) {
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    const __m256 maxArg = _mm256_set1_ps(SIMD_SINCOS_MAXARG);
+    const __m256i one = _mm256_set1_epi32(1), inv1 = _mm256_set1_epi32(~1);
+    const __m256i two = _mm256_set1_epi32(2), four = _mm256_set1_epi32(4);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256 ax = _mm256_andnot_ps(signMask, v);
+
+        if (_mm256_movemask_ps(_mm256_cmp_ps(ax, maxArg, _CMP_LE_OQ)) != 0xFF) {
+            sincosKernelScalar(x + i, s + i, c + i, 8);
+            continue;
+        }
+
+        __m256 signSin = _mm256_and_ps(v, signMask);
+
+        __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(ax, _mm256_set1_ps(FOPI)));
+        j = _mm256_and_si256(_mm256_add_epi32(j, one), inv1);
+        __m256 y = _mm256_cvtepi32_ps(j);
+
+        __m256 swapSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, four), 29));
+        __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, two), four), 29));
+        __m256 polySwap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, two), two));
+        signSin = _mm256_xor_ps(signSin, swapSin);
+
+        __m256 r = _mm256_sub_ps(ax, _mm256_mul_ps(y, _mm256_set1_ps(DP1)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(y, _mm256_set1_ps(DP2)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(y, _mm256_set1_ps(DP3)));
+        __m256 z = _mm256_mul_ps(r, r);
+
+        __m256 yc = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS0), z), _mm256_set1_ps(COS1));
+        yc = _mm256_add_ps(_mm256_mul_ps(yc, z), _mm256_set1_ps(COS2));
+        yc = _mm256_mul_ps(_mm256_mul_ps(yc, z), z);
+        yc = _mm256_add_ps(_mm256_sub_ps(yc, _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+
+        __m256 ys = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN0), z), _mm256_set1_ps(SIN1));
+        ys = _mm256_add_ps(_mm256_mul_ps(ys, z), _mm256_set1_ps(SIN2));
+        ys = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ys, z), r), r);
+
+        __m256 rs = _mm256_blendv_ps(ys, yc, polySwap);
+        __m256 rc = _mm256_blendv_ps(yc, ys, polySwap);
+
+        _mm256_storeu_ps(s + i, _mm256_xor_ps(rs, signSin));
+        _mm256_storeu_ps(c + i, _mm256_xor_ps(rc, signCos));
+    }
+
+    sincosKernelScalar(x + i, s + i, c + i, n - i);
+}
+
+// gcc warns about the undefined passthrough operand inside its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/**
+ * @brief AVX-512 array kernel, 16 floats at a time (AVX-512F only; float bitwise ops go through the integer unit)
+ */
+__attribute__((target("avx512f")))
+static void sincosKernelAVX512(const float* x, float* s, float* c, int n) {
+    const __m512i signMask = _mm512_set1_epi32(0x80000000);
+    const __m512 maxArg = _mm512_set1_ps(SIMD_SINCOS_MAXARG);
+    const __m512i one = _mm512_set1_epi32(1), inv1 = _mm512_set1_epi32(~1);
+    const __m512i two = _mm512_set1_epi32(2), four = _mm512_set1_epi32(4);
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_castps_si512(_mm512_loadu_ps(x + i));
+        __m512 ax = _mm512_castsi512_ps(_mm512_andnot_si512(signMask, v));
+
+        if (_mm512_cmp_ps_mask(ax, maxArg, _CMP_LE_OQ) != 0xFFFF) {
+            sincosKernelScalar(x + i, s + i, c + i, 16);
+            continue;
+        }
+
+        __m512i signSin = _mm512_and_si512(v, signMask);
+
+        __m512i j = _mm512_cvttps_epi32(_mm512_mul_ps(ax, _mm512_set1_ps(FOPI)));
+        j = _mm512_and_si512(_mm512_add_epi32(j, one), inv1);
+        __m512 y = _mm512_cvtepi32_ps(j);
+
+        __m512i swapSin = _mm512_slli_epi32(_mm512_and_si512(j, four), 29);
+        __m512i signCos = _mm512_slli_epi32(_mm512_andnot_si512(_mm512_sub_epi32(j, two), four), 29);
+        __mmask16 polySwap = _mm512_cmpeq_epi32_mask(_mm512_and_si512(j, two), two);
+        signSin = _mm512_xor_si512(signSin, swapSin);
+
+        __m512 r = _mm512_sub_ps(ax, _mm512_mul_ps(y, _mm512_set1_ps(DP1)));
+        r = _mm512_sub_ps(r, _mm512_mul_ps(y, _mm512_set1_ps(DP2)));
+        r = _mm512_sub_ps(r, _mm512_mul_ps(y, _mm512_set1_ps(DP3)));
+        __m512 z = _mm512_mul_ps(r, r);
+
+        __m512 yc = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(COS0), z), _mm512_set1_ps(COS1));
+        yc = _mm512_add_ps(_mm512_mul_ps(yc, z), _mm512_set1_ps(COS2));
+        yc = _mm512_mul_ps(_mm512_mul_ps(yc, z), z);
+        yc = _mm512_add_ps(_mm512_sub_ps(yc, _mm512_mul_ps(_mm512_set1_ps(0.5f), z)), _mm512_set1_ps(1.0f));
+
+        __m512 ys = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(SIN0), z), _mm512_set1_ps(SIN1));
+        ys = _mm512_add_ps(_mm512_mul_ps(ys, z), _mm512_set1_ps(SIN2));
+        ys = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(ys, z), r), r);
+
+        __m512i rs = _mm512_castps_si512(_mm512_mask_blend_ps(polySwap, ys, yc));
+        __m512i rc = _mm512_castps_si512(_mm512_mask_blend_ps(polySwap, yc, ys));
+
+        _mm512_storeu_ps(s + i, _mm512_castsi512_ps(_mm512_xor_si512(rs, signSin)));
+        _mm512_storeu_ps(c + i, _mm512_castsi512_ps(_mm512_xor_si512(rc, signCos)));
+    }
+
+    sincosKernelScalar(x + i, s + i, c + i, n - i);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+/**
+ * @brief Returns the widest level supported by the processor
+ *
+ * @return SimdLevel
+ */
+SimdLevel simdDetect() {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+/**
+ * @brief Returns the kernel implementing a level
+ */
+static SincosKernel kernelFor(SimdLevel level) {
+    switch (level) {
+#ifdef SIMD_X86
+        case SIMD_AVX512:
+            return sincosKernelAVX512;
+        case SIMD_AVX2:
+            return sincosKernelAVX2;
+        case SIMD_SSE2:
+            return sincosKernelSSE2;
+#endif
+        default:
+            return sincosKernelScalar;
+    }
+}
+
+// level and kernel in use, picked once during static initialization
+static SimdLevel activeLevel = simdDetect();
+static SincosKernel activeKernel = kernelFor(activeLevel);
+
+/**
+ * @brief Returns the level currently used by sincosArray
+ *
+ * @return SimdLevel
+ */
+SimdLevel simdLevel() {
+    return activeLevel;
+}
+
+/**
+ * @brief Forces the level used by sincosArray (for benchmarking). Levels wider than the processor supports are clamped. Not safe to call while other threads are evaluating
+ *
+ * @param level Requested level
+ * @return SimdLevel the level actually used
+ */
+SimdLevel simdSetLevel(SimdLevel level) {
+    SimdLevel supported = simdDetect();
+    activeLevel = (level > supported) ? supported : level;
+    activeKernel = kernelFor(activeLevel);
+    return activeLevel;
+}
+
+/**
+ * @brief Returns the human readable name of a level
+ *
+ * @param level
+ * @return const char*
+ */
+const char* simdName(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX512:
+            return "AVX-512";
+        case SIMD_AVX2:
+            return "AVX2";
+        case SIMD_SSE2:
+            return "SSE2";
+        default:
+            return "scalar";
+    }
+}
+
+/**
+ * @brief Computes sin and cos of n floats using the active kernel
+ *
+ * @param x Array of n arguments in radians
+ * @param s Returned array of n sines
+ * @param c Returned array of n cosines
+ * @param n Number of floats
+ */
+void sincosArray(const float* x, float* s, float* c, int n) {
+    activeKernel(x, s, c, n);
+}
+
+/**
+ * @brief Packs n vertices (height, then normal) into 4 snorm16 each: scaled height, octahedral normal and a zero pad. Uses the SSE2 kernel
+ *        whenever the active level is at least SIMD_SSE2
+ *
+ * @param surface Array of n vertices of 4 floats
+ * @param packed Returned array of n vertices of 4 snorm16
+ * @param n Number of vertices
+ * @param heightScale Scale taking heights to [-32767, 32767] (SIMD_SNORM16_MAX over the largest height)
+ */
+void packSurfaceArray(const float* surface, int16_t* packed, int n, float heightScale) {
+#ifdef SIMD_X86
+    if (activeLevel >= SIMD_SSE2) {
+        packKernelSSE2(surface, packed, n, heightScale);
+        return;
+    }
+#endif
+    packKernelScalar(surface, packed, n, heightScale);
+}
+
+/**
+ * @brief Unpacks n vertices packed by packSurfaceArray, exactly as water.vs does (snorm16 to float, then the octahedron unfolded and normalized)
+ *
+ * @param packed Array of n vertices of 4 snorm16
+ * @param surface Returned array of n vertices of 4 floats (height, then a unit normal)
+ * @param n Number of vertices
+ * @param heightScale Scale the heights were packed with
+ */
+void unpackSurfaceArray(const int16_t* packed, float* surface, int n, float heightScale) {
+    for (int i = 0; i < n; i ++) {
+        const int16_t* p = packed + i * 4;
+        float* v = surface + i * 4;
+
+        float ex = fmaxf(p[1] / SIMD_SNORM16_MAX, -1.0f), ey = fmaxf(p[2] / SIMD_SNORM16_MAX, -1.0f);
+        float x = ex, y = ey, z = 1.0f - fabsf(ex) - fabsf(ey);
+        if (z < 0) {
+            x = (1.0f - fabsf(ey)) * copysignf(1.0f, ex);
+            y = (1.0f - fabsf(ex)) * copysignf(1.0f, ey);
+        }
+        float length = sqrtf(x * x + y * y + z * z);
+
+        v[0] = fmaxf(p[0] / SIMD_SNORM16_MAX, -1.0f) * (SIMD_SNORM16_MAX / heightScale);
+        v[1] = x / length;
+        v[2] = y / length;
+        v[3] = z / length;
+    }
+}
@@ -0,0 +1,71 @@
+/**
+ * @file simdmath.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Vectorized single precision sin/cos for whole arrays, with SSE2, AVX2, AVX-512 and scalar implementations. The widest implementation supported by the processor is picked at startup (CPUID)
+ * @version 0.1
+ * @date 2022-06-15
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+
+#include <stdint.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#define SIMD_X86
+#endif
+
+/* ----- SINCOS ERROR BOUNDS ----- *\
+Every level evaluates the same Cephes style algorithm (three part Cody-Waite reduction by pi/4, degree 7 sine / degree 8
+cosine minimax polynomials) with the same sequence of IEEE single precision operations and no fused multiply-adds, so
+all levels return bit-identical results (wherever scalar float math is done in SSE registers, i.e. every x86-64 build).
+
+Measured exhaustively against a double precision reference over every float with |x| <= SIMD_SINCOS_MAXARG, at every level
+(reproduced by ./EWS.exe --bench sincos-exhaustive, which fails above 1.57 / 1.55 ulp or 7.9e-8):
+    sin     max 1.5621 ulp    max absolute error 7.77e-8
+    cos     max 1.5477 ulp    max absolute error 7.82e-8
+The ulp bound is taken where |result| >= 2^-10; closer to the zeros of sin/cos only the absolute bound is meaningful.
+
+Vectors holding any argument outside of the range (or inf/nan) fall back to libm sinf/cosf for that vector only.
+\* ------------------------------- */
+
+// largest argument handled by the polynomial path before falling back to libm
+#define SIMD_SINCOS_MAXARG 8192.0f
+
+// available instruction set levels, from narrowest to widest
+enum SimdLevel {
+    SIMD_SCALAR=0, SIMD_SSE2=1, SIMD_AVX2=2, SIMD_AVX512=3
+};
+
+// widest level supported by the processor (queried once through CPUID)
+SimdLevel simdDetect();
+
+// level currently used by sincosArray (defaults to simdDetect())
+SimdLevel simdLevel();
+
+// forces a level (clamped to simdDetect()), returns the level actually used
+SimdLevel simdSetLevel(SimdLevel level);
+
+// human readable name of a level
+const char* simdName(SimdLevel level);
+
+// s[i] = sin(x[i]), c[i] = cos(x[i]) for n floats. Arrays may have any alignment, and s/c may not alias x
+void sincosArray(const float* x, float* s, float* c, int n);
+
+// scalar version of the same algorithm (bit-identical to sincosArray)
+void sincosScalar(float x, float& s, float& c);
+
+// largest value of a signed normalized 16 bit integer (the OpenGL snorm16 conversion: c / 32767, clamped to -1)
+#define SIMD_SNORM16_MAX 32767.0f
+
+// packs n vertices of 4 floats (height, then a normal, up component last, of any length) into 4 signed normalized 16 bit integers: the height times
+// heightScale, the octahedral encoding of the normal (x, y) and a zero pad. Rounds to nearest even and clamps to [-32767, 32767]; the SSE2 kernel
+// (used from SIMD_SSE2 up) gives results identical to the scalar one
+void packSurfaceArray(const float* surface, int16_t* packed, int n, float heightScale);
+
+// inverse of packSurfaceArray as water.vs decodes it: height divided by heightScale, normal of unit length
+void unpackSurfaceArray(const int16_t* packed, float* surface, int n, float heightScale);
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * @file streambuffer.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Ring of persistently mapped buffer regions for streaming per-frame vertex data. The CPU writes one region while the GPU may still read the
+ *        previous ones; a fence per region keeps the CPU from overwriting data the GPU has not consumed yet. GL calls go through a backend, so the
+ *        fence logic also runs against a fake GPU that counts stalls
+ * @version 0.1
+ * @date 2022-06-21
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "streambuffer.h"
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+/**
+ * @brief Creates an immutable buffer and maps it persistently (needs OpenGL 4.4 or ARB_buffer_storage)
+ *
+ * @param bytes Size of the buffer
+ * @param buffer Returned buffer name
+ * @return void* Mapping of the whole buffer (NULL - unsupported)
+ */
+void* GLStreamBackend::createStorage(size_t bytes, unsigned int& buffer) {
+    buffer = 0;
+    if (!GLEW_VERSION_4_4 && !GLEW_ARB_buffer_storage)
+        return NULL;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+
+    void* mapping = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+    if (!mapping) {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    return mapping;
+}
+
+/**
+ * @brief Unmaps and deletes a buffer made by createStorage
+ *
+ * @param buffer Buffer name
+ */
+void GLStreamBackend::destroyStorage(unsigned int buffer) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glDeleteBuffers(1, &buffer);
+}
+
+/**
+ * @brief Inserts a fence after every command issued so far
+ *
+ * @return void* GLsync of the fence
+ */
+void* GLStreamBackend::fence() {
+    return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * @brief Whether the GPU has passed a fence, without waiting
+ *
+ * @param fence GLsync of the fence
+ * @return bool
+ */
+bool GLStreamBackend::signaled(void* fence) {
+    GLenum result = glClientWaitSync((GLsync)fence, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+/**
+ * @brief Blocks until the GPU has passed a fence, flushing the commands before it so it is bound to be reached
+ *
+ * @param fence GLsync of the fence
+ */
+void GLStreamBackend::wait(void* fence) {
+    GLenum result;
+    do {
+        result = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_NS);
+    } while (result == GL_TIMEOUT_EXPIRED);
+}
+
+/**
+ * @brief Deletes a fence
+ *
+ * @param fence GLsync of the fence
+ */
+void GLStreamBackend::deleteFence(void* fence) {
+    glDeleteSync((GLsync)fence);
+}
+
+/**
+ * @brief Construct a new fake backend
+ *
+ * @param latency Number of fences the fake GPU lags behind the CPU (0 - every fence is passed as soon as it is issued)
+ */
+FakeStreamBackend::FakeStreamBackend(int latency) : latency(latency < 0 ? 0 : latency), issued(0), completed(0), waitCount(0) {
+
+}
+
+/**
+ * @brief Allocates plain memory in place of a mapped buffer
+ *
+ * @param bytes Size of the buffer
+ * @param buffer Returned buffer name (1 based index of the allocation)
+ * @return void* The memory
+ */
+void* FakeStreamBackend::createStorage(size_t bytes, unsigned int& buffer) {
+    storage.push_back(vector<char>(bytes));
+    buffer = storage.size();
+    return storage.back().data();
+}
+
+/**
+ * @brief Frees memory made by createStorage
+ *
+ * @param buffer Buffer name
+ */
+void FakeStreamBackend::destroyStorage(unsigned int buffer) {
+    if (buffer >= 1 && buffer <= storage.size())
+        vector<char>().swap(storage[buffer - 1]);
+}
+
+/**
+ * @brief Issues a fence. Issuing moves the fake GPU along, so it stays latency fences behind
+ *
+ * @return void* Handle of the fence (its 1 based issue number)
+ */
+void* FakeStreamBackend::fence() {
+    issued ++;
+    if (issued > completed + latency)
+        completed = issued - latency;
+    return (void*)(uintptr_t)issued;
+}
+
+/**
+ * @brief Whether the fake GPU has passed a fence
+ *
+ * @param fence Handle of the fence
+ * @return bool
+ */
+bool FakeStreamBackend::signaled(void* fence) {
+    return (size_t)(uintptr_t)fence <= completed;
+}
+
+/**
+ * @brief Lets the fake GPU catch up to a fence, counting the wait
+ *
+ * @param fence Handle of the fence
+ */
+void FakeStreamBackend::wait(void* fence) {
+    size_t id = (size_t)(uintptr_t)fence;
+    if (id > completed)
+        completed = id;
+    waitCount ++;
+}
+
+/**
+ * @brief Fences of the fake backend hold no resources
+ *
+ * @param fence Handle of the fence
+ */
+void FakeStreamBackend::deleteFence(void* fence) {
+
+}
+
+/**
+ * @brief Construct a new (unallocated) StreamBuffer object
+ */
+StreamBuffer::StreamBuffer() : backend(NULL), ownsBackend(false), name(0), mapping(NULL), regionSize(0), current(0), fresh(false), acquireCount(0), stallCount(0) {
+
+}
+
+/**
+ * @brief Destroy the StreamBuffer object, releasing its storage
+ */
+StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+/**
+ * @brief Allocates the ring: regions regionBytes long (rounded up to STREAM_ALIGN) in a single persistently mapped buffer
+ *
+ * @param regionBytes Bytes written per frame
+ * @param regions Number of regions (frames in flight, plus the one being written)
+ * @param backend GL calls to make (NULL - OpenGL, through a GLStreamBackend owned by the ring)
+ * @return bool whether the storage could be mapped
+ */
+bool StreamBuffer::init(size_t regionBytes, int regions, StreamBackend* backend) {
+    release();
+    if (regions < 1 || regionBytes == 0)
+        return false;
+
+    ownsBackend = (backend == NULL);
+    this->backend = ownsBackend ? new GLStreamBackend() : backend;
+
+    regionSize = (regionBytes + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+    mapping = (char*)this->backend->createStorage(regionSize * regions, name);
+    if (!mapping) {
+        release();
+        return false;
+    }
+
+    fences.assign(regions, NULL);
+    current = regions - 1;
+    fresh = false;
+    acquireCount = 0;
+    stallCount = 0;
+    return true;
+}
+
+/**
+ * @brief Waits for the GPU to be done with every region, then frees the storage, the fences and the backend (if owned)
+ */
+void StreamBuffer::release() {
+    if (backend) {
+        for (size_t r = 0; r < fences.size(); r ++) {
+            if (fences[r]) {
+                backend->wait(fences[r]);
+                backend->deleteFence(fences[r]);
+            }
+        }
+        if (mapping)
+            backend->destroyStorage(name);
+        if (ownsBackend)
+            delete backend;
+    }
+
+    backend = NULL;
+    ownsBackend = false;
+    fences.clear();
+    name = 0;
+    mapping = NULL;
+    regionSize = 0;
+}
+
+/**
+ * @brief Moves on to the next region of the ring and returns where to write it. If the GPU may still be reading that region (its fence has not
+ *        been passed) the wait is counted as a stall
+ *
+ * @return void* Start of the region (NULL - not initialized)
+ */
+void* StreamBuffer::acquire() {
+    if (!mapping)
+        return NULL;
+    if (fresh)
+        return mapping + offset();
+
+    current = (current + 1) % regions();
+    void*& f = fences[current];
+    if (f) {
+        if (!backend->signaled(f)) {
+            stallCount ++;
+            backend->wait(f);
+        }
+        backend->deleteFence(f);
+        f = NULL;
+    }
+
+    fresh = true;
+    acquireCount ++;
+    return mapping + offset();
+}
+
+/**
+ * @brief Fences the region last acquired after the commands issued so far. Called after every frame that draws from it (a region drawn again,
+ *        without a new acquire, is fenced again, so the ring always waits on the last read of a region)
+ */
+void StreamBuffer::fence() {
+    if (!mapping)
+        return;
+
+    void*& f = fences[current];
+    if (f)
+        backend->deleteFence(f);
+    f = backend->fence();
+    fresh = false;
+}
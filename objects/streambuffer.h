@@ -0,0 +1,128 @@
+/**
+ * @file streambuffer.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Ring of persistently mapped buffer regions for streaming per-frame vertex data. The CPU writes one region while the GPU may still read the
+ *        previous ones; a fence per region keeps the CPU from overwriting data the GPU has not consumed yet. GL calls go through a backend, so the
+ *        fence logic also runs against a fake GPU that counts stalls
+ * @version 0.1
+ * @date 2022-06-21
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <vector>
+using std::vector;
+
+#include <stddef.h>
+
+// default number of regions of the ring (one being written, up to two still read by the GPU)
+#define STREAM_REGIONS 3
+
+// alignment of the start of every region (bytes)
+#define STREAM_ALIGN 256
+
+// how long a blocking fence wait sleeps in the driver before trying again (ns)
+#define STREAM_WAIT_NS 1000000
+
+// GL calls made by a StreamBuffer. Fences are opaque handles (NULL - no fence)
+class StreamBackend {
+    public:
+        virtual ~StreamBackend() {}
+
+        // creates persistent, coherent, write mapped storage of the given size. Returns the mapping (NULL - unsupported) and the buffer name
+        virtual void* createStorage(size_t bytes, unsigned int& buffer) = 0;
+        virtual void destroyStorage(unsigned int buffer) = 0;
+
+        // fence after every command issued so far, whether it has been passed (without waiting), blocking wait until it is passed, deletion
+        virtual void* fence() = 0;
+        virtual bool signaled(void* fence) = 0;
+        virtual void wait(void* fence) = 0;
+        virtual void deleteFence(void* fence) = 0;
+};
+
+// OpenGL 4.4 (or ARB_buffer_storage) backend: glBufferStorage/glMapBufferRange with persistent, coherent mapping, glFenceSync/glClientWaitSync
+class GLStreamBackend : public StreamBackend {
+    public:
+        void* createStorage(size_t bytes, unsigned int& buffer);
+        void destroyStorage(unsigned int buffer);
+
+        void* fence();
+        bool signaled(void* fence);
+        void wait(void* fence);
+        void deleteFence(void* fence);
+};
+
+// fake GPU running a fixed number of frames (fences) behind the CPU, with plain memory as storage. A blocking wait lets the fake GPU catch up to the fence
+class FakeStreamBackend : public StreamBackend {
+    public:
+        FakeStreamBackend(int latency);
+
+        void* createStorage(size_t bytes, unsigned int& buffer);
+        void destroyStorage(unsigned int buffer);
+
+        void* fence();
+        bool signaled(void* fence);
+        void wait(void* fence);
+        void deleteFence(void* fence);
+
+        // number of blocking waits made so far
+        long waits() const { return waitCount; }
+
+    private:
+        int latency;        // fences the fake GPU lags behind
+        size_t issued;      // fences issued so far (fence handles are 1 .. issued)
+        size_t completed;   // fences passed by the fake GPU so far
+        long waitCount;
+
+        vector<vector<char> > storage;
+};
+
+class StreamBuffer {
+    public:
+        StreamBuffer();
+        ~StreamBuffer();
+
+        // allocates regions of at least regionBytes each. Returns false (and stays unready) if the backend cannot map persistent storage
+        // backend NULL uses (and owns) a GLStreamBackend
+        bool init(size_t regionBytes, int regions = STREAM_REGIONS, StreamBackend* backend = NULL);
+        void release();
+        bool ready() const { return mapping != NULL; }
+
+        // moves on to the next region, waiting for the GPU to be done reading it, and returns where to write it. Calling it again before fence
+        // returns the same region
+        void* acquire();
+
+        // fences the region last acquired once every command reading it has been issued (after the draws of a frame)
+        void fence();
+
+        // buffer name and byte offset of the region last acquired (to point vertex attributes at)
+        unsigned int buffer() const { return name; }
+        size_t offset() const { return (size_t)current * regionSize; }
+
+        int regions() const { return (int)fences.size(); }
+        size_t regionBytes() const { return regionSize; }
+
+        // acquisitions so far, and how many of them had to wait for the GPU
+        long acquired() const { return acquireCount; }
+        long stalls() const { return stallCount; }
+
+    private:
+        StreamBackend* backend;
+        bool ownsBackend;
+
+        unsigned int name;
+        char* mapping;
+        size_t regionSize;
+
+        // fence of the last frame that read each region (NULL - free)
+        vector<void*> fences;
+        int current;
+        bool fresh;         // current region acquired but not fenced yet
+
+        long acquireCount, stallCount;
+};
+
+#endif
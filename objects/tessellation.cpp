@@ -0,0 +1,125 @@
+/**
+ * @file tessellation.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief CPU model of the level of detail policy of the tessellated water (shaders/water.tcs). Every edge of the coarse patch grid gets a factor from
+ *        its on-screen length and its distance to the camera, so the triangles drawn follow the on-screen area of the water instead of a fixed
+ *        lattice. The factors and the triangles they generate are computed the same way as on the GPU, so the policy can be checked without one
+ * @version 0.1
+ * @date 2022-06-22
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "tessellation.h"
+
+#include <math.h>
+
+/**
+ * @brief Construct a new TessellationPolicy object, seen from the origin through a 45 degree, 1080 pixel high view until setView is called
+ *
+ * @param edgePixels On-screen length aimed for every tessellated edge (pixels)
+ * @param maxLevel Highest factor of an edge (at most GL_MAX_TESS_GEN_LEVEL)
+ * @param fadeNear Distance from the camera up to which factors only follow the on-screen length
+ * @param fadeFar Distance from the camera past which every factor is 1
+ */
+TessellationPolicy::TessellationPolicy(float edgePixels, float maxLevel, float fadeNear, float fadeFar) : pixels(edgePixels), level(maxLevel), nearDistance(fadeNear), farDistance(fadeFar), camera(0.0f) {
+    pixelScale = 1080.0f * 0.5f / tanf(glm::radians(22.5f));
+}
+
+/**
+ * @brief Sets the camera the factors are computed for (the uniforms of water.tcs)
+ *
+ * @param projection Projection matrix
+ * @param camera Position of the camera in world space
+ * @param viewportHeight Height of the viewport (pixels)
+ */
+void TessellationPolicy::setView(const glm::mat4& projection, const glm::vec3& camera, float viewportHeight) {
+    pixelScale = projection[1][1] * viewportHeight * 0.5f;
+    this->camera = camera;
+}
+
+/**
+ * @brief Factor of an edge: its on-screen length (as a sphere around the edge seen from the camera, so edges crossing the near plane stay finite)
+ *        over edgePixels, faded down to 1 between fadeNear and fadeFar. Symmetric in a and b
+ *
+ * @param a One end of the edge (world space)
+ * @param b Other end of the edge
+ * @return float Factor from 1 to maxLevel
+ */
+float TessellationPolicy::edgeFactor(const glm::vec3& a, const glm::vec3& b) const {
+    float d = fmaxf(glm::distance((a + b) * 0.5f, camera), 1e-3f);
+    float onScreen = glm::distance(a, b) * pixelScale / d;
+
+    float fade = glm::clamp((farDistance - d) / (farDistance - nearDistance), 0.0f, 1.0f);
+    return glm::clamp(1.0f + fade * (onScreen / pixels - 1.0f), 1.0f, level);
+}
+
+/**
+ * @brief Factors of a quad patch. Outer factors follow the order of the quad domain (edges u = 0, v = 0, u = 1, v = 1) and the inner factors are
+ *        the finest of the two edges they run along
+ *
+ * @param corners Corners at (u, v) = (0, 0), (1, 0), (0, 1), (1, 1)
+ * @param outer Returned gl_TessLevelOuter
+ * @param inner Returned gl_TessLevelInner
+ */
+void TessellationPolicy::patchFactors(const glm::vec3 corners[4], float outer[4], float inner[2]) const {
+    outer[0] = edgeFactor(corners[0], corners[2]);
+    outer[1] = edgeFactor(corners[0], corners[1]);
+    outer[2] = edgeFactor(corners[1], corners[3]);
+    outer[3] = edgeFactor(corners[2], corners[3]);
+    inner[0] = fmaxf(outer[1], outer[3]);
+    inner[1] = fmaxf(outer[0], outer[2]);
+}
+
+/**
+ * @brief Triangles generated by the quad domain with equal_spacing: levels round up to integers, and an inner level of 1 counts as 2 unless every
+ *        level is 1. The inner grid of (n0 - 2) x (n1 - 2) quads is joined to every outer edge of m segments by m + (inner segments) triangles
+ *
+ * @param outer Outer factors
+ * @param inner Inner factors
+ * @return long Number of triangles
+ */
+long TessellationPolicy::patchTriangles(const float outer[4], const float inner[2]) {
+    long m[4];
+    bool ones = true;
+    for (int e = 0; e < 4; e ++) {
+        m[e] = (long)ceilf(outer[e]);
+        ones = ones && m[e] == 1;
+    }
+    long n0 = (long)ceilf(inner[0]), n1 = (long)ceilf(inner[1]);
+    if (ones && n0 == 1 && n1 == 1)
+        return 2;
+    if (n0 < 2) n0 = 2;
+    if (n1 < 2) n1 = 2;
+
+    // edges u = 0 and u = 1 run along v (inner level 1), edges v = 0 and v = 1 along u (inner level 0)
+    return 2 * (n0 - 2) * (n1 - 2) + (m[0] + n1 - 2) + (m[2] + n1 - 2) + (m[1] + n0 - 2) + (m[3] + n0 - 2);
+}
+
+/**
+ * @brief Triangles of the patch grid drawn by Water in the tessellated mode, patch (i, k) covering x from origin.x + i * size.x / patches and
+ *        z from origin.y + k * size.y / patches
+ *
+ * @param origin x, z of the first corner of the grid
+ * @param size Extent of the grid along x, z
+ * @param patches Patches along each side
+ * @return long Number of triangles
+ */
+long TessellationPolicy::gridTriangles(const glm::vec2& origin, const glm::vec2& size, int patches) const {
+    glm::vec2 patchSize = size / (float)patches;
+    long triangles = 0;
+    for (int i = 0; i < patches; i ++) {
+        for (int k = 0; k < patches; k ++) {
+            glm::vec3 corners[4];
+            for (int c = 0; c < 4; c ++) {
+                glm::vec2 p = origin + glm::vec2(i + (c & 1), k + (c >> 1)) * patchSize;
+                corners[c] = glm::vec3(p.x, 0.0f, p.y);
+            }
+
+            float outer[4], inner[2];
+            patchFactors(corners, outer, inner);
+            triangles += patchTriangles(outer, inner);
+        }
+    }
+    return triangles;
+}
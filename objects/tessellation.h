@@ -0,0 +1,66 @@
+/**
+ * @file tessellation.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief CPU model of the level of detail policy of the tessellated water (shaders/water.tcs). Every edge of the coarse patch grid gets a factor from
+ *        its on-screen length and its distance to the camera, so the triangles drawn follow the on-screen area of the water instead of a fixed
+ *        lattice. The factors and the triangles they generate are computed the same way as on the GPU, so the policy can be checked without one
+ * @version 0.1
+ * @date 2022-06-22
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef TESSELLATION_H
+#define TESSELLATION_H
+
+#include <glm/glm.hpp>
+
+// highest tessellation level every OpenGL 4 implementation supports (GL_MAX_TESS_GEN_LEVEL is at least 64)
+#define TESS_MAX_LEVEL 64.0f
+
+// default on-screen length of a tessellated edge (pixels)
+#define TESS_EDGE_PIXELS 12.0f
+
+// default distances from the camera between which the factors fade down to 1
+#define TESS_FADE_NEAR 150.0f
+#define TESS_FADE_FAR 300.0f
+
+// default number of patches along each side of the water
+#define TESS_PATCHES 32
+
+// level of detail policy of the tessellated water. Factors only depend on the two ends of an edge, so neighbouring patches always agree on the edge
+// they share and the surface never cracks
+class TessellationPolicy {
+    public:
+        TessellationPolicy(float edgePixels = TESS_EDGE_PIXELS, float maxLevel = TESS_MAX_LEVEL, float fadeNear = TESS_FADE_NEAR, float fadeFar = TESS_FADE_FAR);
+
+        // camera the factors are computed for: projection matrix, world position and height of the viewport in pixels
+        void setView(const glm::mat4& projection, const glm::vec3& camera, float viewportHeight);
+
+        // factor of the edge from a to b (world space), from 1 to maxLevel
+        float edgeFactor(const glm::vec3& a, const glm::vec3& b) const;
+
+        // outer and inner factors of a quad patch with corners (u, v) = (0, 0), (1, 0), (0, 1), (1, 1), in the order of gl_TessLevelOuter and gl_TessLevelInner
+        void patchFactors(const glm::vec3 corners[4], float outer[4], float inner[2]) const;
+
+        // triangles of a quad patch tessellated with equal_spacing at the given factors
+        static long patchTriangles(const float outer[4], const float inner[2]);
+
+        // triangles of a patches x patches grid over the flat water (y = 0) from origin (x, z) and extending size (x, z)
+        long gridTriangles(const glm::vec2& origin, const glm::vec2& size, int patches) const;
+
+        float edgePixels() const { return pixels; }
+        float maxLevel() const { return level; }
+        float fadeNear() const { return nearDistance; }
+        float fadeFar() const { return farDistance; }
+
+    private:
+        float pixels, level;
+        float nearDistance, farDistance;
+
+        // pixels spanned by a unit length seen from a unit distance (height of the viewport times projection[1][1] over 2)
+        float pixelScale;
+        glm::vec3 camera;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/**
+ * @file threadpool.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Persistent pool of worker threads that split ranges of work (rows of a mesh, etc.) into fixed tiles. Tiles are the same no matter how many threads run them, so any work whose tiles write disjoint outputs gives bit-identical results for every thread count
+ * @version 0.1
+ * @date 2022-06-18
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "threadpool.h"
+
+// whether this thread is running a tile of a job (a parallelFor called from inside a job runs inline instead of waiting on busy workers)
+static thread_local bool insideJob = false;
+
+/**
+ * @brief Construct a new ThreadPool object
+ *
+ * @param threads Number of threads running tiles, including the calling thread (0 - one per hardware thread)
+ */
+ThreadPool::ThreadPool(int threads) : stopping(false), generation(0), busy(0), job(NULL), count(0), grain(1), tiles(0), nextTile(0) {
+    start(threads);
+}
+
+/**
+ * @brief Destroy the ThreadPool object (joins every worker)
+ */
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+/**
+ * @brief Returns the number of hardware threads
+ *
+ * @return int (at least 1)
+ */
+int ThreadPool::hardwareThreads() {
+    int n = (int)std::thread::hardware_concurrency();
+    return (n > 0) ? n : 1;
+}
+
+/**
+ * @brief Changes the number of threads running tiles. Must not be called during parallelFor
+ *
+ * @param threads Number of threads, including the calling thread (0 - one per hardware thread)
+ */
+void ThreadPool::resize(int threads) {
+    stop();
+    start(threads);
+}
+
+/**
+ * @brief Spawns threads - 1 workers
+ */
+void ThreadPool::start(int threads) {
+    if (threads <= 0)
+        threads = hardwareThreads();
+
+    stopping = false;
+    for (int i = 1; i < threads; i ++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+/**
+ * @brief Wakes and joins every worker
+ */
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i ++) {
+        workers[i].join();
+    }
+    workers.clear();
+}
+
+/**
+ * @brief Claims and runs tiles of the current job until none are left
+ */
+void ThreadPool::runTiles() {
+    insideJob = true;
+    int tile;
+    while ((tile = nextTile.fetch_add(1)) < tiles) {
+        int first = tile * grain;
+        int last = (first + grain < count) ? first + grain : count;
+        (*job)(first, last);
+    }
+    insideJob = false;
+}
+
+/**
+ * @brief Body of every worker: waits for a new job, helps run its tiles, reports back
+ */
+void ThreadPool::workerLoop() {
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+
+        lock.unlock();
+        runTiles();
+        lock.lock();
+
+        if (-- busy == 0)
+            done.notify_one();
+    }
+}
+
+/**
+ * @brief Runs job over [0, count) in tiles of grain items, on every thread of the pool (the calling thread included). Blocks until done
+ *
+ * @param count Number of items
+ * @param grain Number of items per tile
+ * @param job Function called with the [first, last) range of each tile. Tiles may run in any order and on any thread. A parallelFor called
+ *        from inside job runs its tiles inline, on the calling thread
+ */
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)>& job) {
+    if (count <= 0)
+        return;
+    if (grain < 1)
+        grain = 1;
+
+    int tiles = (count + grain - 1) / grain;
+
+    // nothing to share, or called from inside a job (the workers are taken by the outer job, and would never pick this one up)
+    if (workers.empty() || tiles == 1 || insideJob) {
+        for (int first = 0; first < count; first += grain) {
+            job(first, (first + grain < count) ? first + grain : count);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        this->count = count;
+        this->grain = grain;
+        this->tiles = tiles;
+        nextTile = 0;
+        busy = (int)workers.size();
+        generation ++;
+    }
+    wake.notify_all();
+
+    runTiles();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return busy == 0; });
+    this->job = NULL;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file threadpool.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Persistent pool of worker threads that split ranges of work (rows of a mesh, etc.) into fixed tiles. Tiles are the same no matter how many threads run them, so any work whose tiles write disjoint outputs gives bit-identical results for every thread count
+ * @version 0.1
+ * @date 2022-06-18
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+using std::vector;
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class ThreadPool {
+    public:
+        ThreadPool(int threads = 0);
+        ~ThreadPool();
+
+        // number of threads that run tiles, including the calling thread
+        int size() const { return (int)workers.size() + 1; }
+        void resize(int threads);
+
+        // runs job(first, last) for every tile [first, last) of [0, count), tiles being grain items long. Blocks until every tile is done. Nested
+        // calls (from inside a job) run inline on the calling thread
+        void parallelFor(int count, int grain, const std::function<void(int, int)>& job);
+
+        // number of hardware threads (at least 1)
+        static int hardwareThreads();
+
+    private:
+        void start(int threads);
+        void stop();
+        void workerLoop();
+        void runTiles();
+
+        vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable wake;   // signals workers that a new job (generation) was posted
+        std::condition_variable done;   // signals the caller that every worker has finished the job
+        bool stopping;
+        unsigned int generation;
+        int busy;                       // workers still running the current job
+
+        // current job
+        const std::function<void(int, int)>* job;
+        int count, grain, tiles;
+        std::atomic<int> nextTile;
+};
+
+#endif
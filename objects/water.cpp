@@ -9,6 +9,9 @@
  */
 
 #include "water.h"
+#include "simdmath.h"
+
+#include <chrono>
 
 /**
  * @brief Return a random float from 0 to x
@@ -35,30 +38,35 @@ float randFloat(float x) {
  * @param rnd Whether or not all waves are rounded or pointed (rounded - true, pointed - false)
  * @param anim Whether or not the water updates with time (default false)
  */
-Water::Water(int px, int pz, int pw, int pl, int pdimx, int pdimz, float maxA, int maxI, bool dir, bool rnd, bool anim=false) : pX(px), pZ(pz), pW(pw), pL(pl), pDimX(pdimx), pDimZ(pdimz), maxA(maxA), maxI(maxI), directional(dir), rounded(rnd), animated(anim) {
+Water::Water(int px, int pz, int pw, int pl, int pdimx, int pdimz, float maxA, int maxI, bool dir, bool rnd, bool anim=false) : pX(px), pZ(pz), pW(pw), pL(pl), pDimX(pdimx), pDimZ(pdimz), maxA(maxA), maxI(maxI), directional(dir), rounded(rnd), animated(anim), evalMode(WAVE_DIRECT), normalMode(WATER_NORMALS_ANALYTIC), drawMode(WATER_DRAW_RESTART), lastDrawCalls(0), heightfield(false), displacing(false), packed(false), compute(NULL), wavesSSBO(0), tessPatches(0), patchVAO(0), cullingEnabled(false), tileIndexStart(0), slicingEnabled(false), spanMask(NULL), spanRows(0, -1), fullUpload(false), loopSeconds(0), cacheFrame(-1), cacheBlend(0), pool(NULL), ocean(NULL), clipmap(NULL), viewer(0.0f), clipVAO(0), clipStaticVBO(0), clipSurfaceVBO(0), clipEBO(0), projgrid(NULL), viewMatrix(1.0f), projectionMatrix(1.0f), projVAO(0), projStaticVBO(0), projSurfaceVBO(0), projEBO(0), ringWritten(false), surfaceOut(NULL), displacementOut(NULL), packedOut(NULL) {
     // use srand to set arbitrary seed (commented out for testing)
     // srand(time(NULL));
     
-    // directional/rounded waves
-    if (dir && rnd) {
-        // define set of waves
-        for (int i = 0; i < maxI; i ++) {
-            Ai.push_back(randFloat(maxA));
-            wi.push_back(randFloat(MAXFREQ)*0.5+MAXFREQ*0.5);
-            Di.push_back(glm::vec2(randFloat(1.0f)*2-1, randFloat(1.0f)*2-1));
-            Si.push_back(randFloat(MAXSPED)*0.5+MAXFREQ*0.5);
-        }
-
-        // initialize internal time
-        internalTime = 0;
+    // define set of waves (circular waves also get a center somewhere over the body of water)
+    for (int i = 0; i < maxI; i ++) {
+        Ai.push_back(randFloat(maxA));
+        wi.push_back(randFloat(MAXFREQ)*0.5+MAXFREQ*0.5);
+        Di.push_back(glm::vec2(randFloat(1.0f)*2-1, randFloat(1.0f)*2-1));
+        Si.push_back(randFloat(MAXSPED)*0.5+MAXFREQ*0.5);
+        Ci.push_back(dir ? glm::vec2(0, 0) : glm::vec2(pX - pW / 2 + randFloat(pW), pZ - pL / 2 + randFloat(pL)));
 
-        // setup wave mesh
-        setupMesh();
+        field.addWave(Ai[i], wi[i], Di[i].x, Di[i].y, Si[i], Ci[i].x, Ci[i].y);
+        gerstner.addWave(Ai[i], wi[i], Di[i].x, Di[i].y, Si[i]);
     }
+
+    // pick the evaluators of this family of waves once, instead of branching per wave and per vertex
+    field.setFamily(dir, rnd);
+
+    // initialize internal time
+    internalTime = 0;
+
+    // setup wave mesh
+    setupMesh();
 }
 
 /**
- * @brief Wave basis equation for some wave i. Follows W(x, y, t) = Ai sin (Di dot (x, y) * wi + Si * wi * t)
+ * @brief Wave basis equation for some wave i. Follows W(x, y, t) = Ai sin (theta i) for rounded waves or 2 Ai ((sin (theta i) + 1) / 2)^k for pointed
+ *        waves, theta i = Di dot (x, y) * wi + Si * wi * t for directional waves or |(x, y) - Ci| * wi + Si * wi * t for circular waves
  * 
  * @param i ith wave in the set of waves. Assumed to be within bounds
  * @param x x coordinate of the point of evaluation
@@ -67,14 +75,9 @@ Water::Water(int px, int pz, int pw, int pl, int pdimx, int pdimz, float maxA, i
  * @return float 
  */
 float Water::W(int i, float x, float y, float t) {
-    float A = Ai.at(i);
-    float w = wi.at(i);
-    glm::vec2 D = Di.at(i);
-    float S = Si.at(i);
-
-    if (directional && rounded) {    
-        return A * sin (glm::dot(D, glm::vec2(x, y)) * w + S * w * t);
-    }
+    float w, dwdx, dwdy;
+    field.evaluateWave(i, x, y, t, w, dwdx, dwdy);
+    return w;
 }
 
 /**
@@ -87,11 +90,9 @@ float Water::W(int i, float x, float y, float t) {
  */
 float Water::H(float x, float y, float t) {
     // does not change based off of wave type (H is always the sum of all waves Wi)
-    float summ = 0;
-    for (int i = 0; i < maxI; i ++) {
-        summ += W(i, x, y, t);
-    }
-    return summ;
+    float h, dhdx, dhdy;
+    field.evaluatePoint(x, y, t, h, dhdx, dhdy);
+    return h;
 }
 
 /**
@@ -104,15 +105,9 @@ float Water::H(float x, float y, float t) {
  * @return float 
  */
 float Water::ddxW(int i, float x, float y, float t) {
-    // wi * Di.x * Ai * cos (Di dot (x, y) * wi + Si * wi * t)
-    float A = Ai.at(i);
-    float w = wi.at(i);
-    glm::vec2 D = Di.at(i);
-    float S = Si.at(i);
-
-    if (directional && rounded) {
-        return w * D.x * A * cos(glm::dot(D, glm::vec2(x, y)) * w + S * w * t);
-    }
+    float w, dwdx, dwdy;
+    field.evaluateWave(i, x, y, t, w, dwdx, dwdy);
+    return dwdx;
 }
 
 /**
@@ -125,11 +120,9 @@ float Water::ddxW(int i, float x, float y, float t) {
  */
 float Water::ddxH(float x, float y, float t) {
     // does not change based off of wave type (H is always the sum of all waves Wi)
-    float summ = 0;
-    for (int i = 0; i < maxI; i ++) {
-        summ += ddxW(i, x, y, t);
-    }
-    return summ;
+    float h, dhdx, dhdy;
+    field.evaluatePoint(x, y, t, h, dhdx, dhdy);
+    return dhdx;
 }
 
 /**
@@ -142,15 +135,9 @@ float Water::ddxH(float x, float y, float t) {
  * @return float 
  */
 float Water::ddyW(int i, float x, float y, float t) {
-    // wi * Di.y * Ai * cos (Di dot (x, y) * wi + Si * wi * t)
-    float A = Ai.at(i);
-    float w = wi.at(i);
-    glm::vec2 D = Di.at(i);
-    float S = Si.at(i);
-
-    if (directional && rounded) {
-        return w * D.y * A * cos(glm::dot(D, glm::vec2(x, y)) * w + S * w * t);
-    }
+    float w, dwdx, dwdy;
+    field.evaluateWave(i, x, y, t, w, dwdx, dwdy);
+    return dwdy;
 }
 
 /**
@@ -162,11 +149,9 @@ float Water::ddyW(int i, float x, float y, float t) {
  * @return float 
  */
 float Water::ddyH(float x, float y, float t) {
-    float summ = 0;
-    for (int i = 0; i < maxI; i ++) {
-        summ += ddyW(i, x, y, t);
-    }
-    return summ;
+    float h, dhdx, dhdy;
+    field.evaluatePoint(x, y, t, h, dhdx, dhdy);
+    return dhdy;
 }
 
 /**
@@ -204,7 +189,10 @@ glm::vec3 Water::T(float x, float y, float t) {
  * @return glm::vec3 
  */
 glm::vec3 Water::N(float x, float y, float t) {
-    glm::vec3 returned = glm::vec3(0 - ddxH(x, y, t), 0 - ddyH(x, y, t), 1);
+    // both partials come out of a single pass over the waves
+    float h, dhdx, dhdy;
+    field.evaluatePoint(x, y, t, h, dhdx, dhdy);
+    glm::vec3 returned = glm::vec3(0 - dhdx, 0 - dhdy, 1);
     return returned;
 }
 
@@ -217,109 +205,1590 @@ void Water::updateTime(float dT) {
     internalTime += dT;
 }
 
+/**
+ * @brief Sets how rows of the mesh are evaluated by later calls to updateMesh. The basis mode caches the spatial sin/cos of every wave at
+ *        every vertex here (once, since x and z of the mesh never change). It is no faster than WAVE_DIRECT on the default mesh (see WaveBasis),
+ *        so it is kept for comparison (--bench basis) rather than as an optimization. Circular or pointed waves are always evaluated directly
+ * 
+ * @param mode WAVE_DIRECT (sin/cos of every phase), WAVE_RECURRENCE (angle-addition rotations along each row) or WAVE_BASIS (cached spatial
+ *        basis, one matrix-vector product per frame)
+ */
+void Water::setEvalMode(WaveEvalMode mode) {
+    // the recurrence and the basis rely on phases linear in x and y and on plain sines
+    if (!directional || !rounded)
+        mode = WAVE_DIRECT;
+    evalMode = mode;
+
+    if (mode == WAVE_BASIS) {
+        if (!basis.built())
+            basis.build(field, &rowX[0], pDimX, &rowZ[0], pDimZ);
+    } else {
+        basis.clear();
+    }
+}
+
+/**
+ * @brief Sets the thread pool used by updateMesh. The mesh is split into fixed tiles of WATER_TILE_ROWS rows, so the result is bit-identical
+ *        for any number of threads
+ * 
+ * @param pool Thread pool (NULL - single threaded)
+ */
+void Water::setThreadPool(ThreadPool* pool) {
+    this->pool = pool;
+}
+
+/**
+ * @brief Replaces the sum of waves with a spectral (FFT) ocean. The mesh keeps its own grid and samples the periodic ocean patch, vertices being
+ *        displaced horizontally by the choppiness of the ocean. Evaluation modes only apply to the sum of waves
+ * 
+ * @param ocean Spectral ocean (NULL - back to the sum of waves)
+ */
+void Water::setOcean(Ocean* ocean) {
+    this->ocean = ocean;
+
+    // refresh the mesh right away (still water is never updated otherwise)
+    if (!rowX.empty())
+        refreshMesh();
+}
+
+/**
+ * @brief Draws the sum of waves from a geometry clipmap that follows the viewer (see setViewer) instead of the mesh: nested levels of the same
+ *        number of vertices, each twice as coarse as the one inside it, so the water can reach kilometres away at a constant number of vertices.
+ *        Outer levels evaluate fewer waves. The waves of this water are handed to the clipmap. The mesh keeps being drawn for the spectral ocean
+ *        and Gerstner waves
+ * 
+ * @param clipmap Clipmap (NULL - back to the mesh)
+ */
+void Water::setClipmap(Clipmap* clipmap) {
+    this->clipmap = clipmap;
+
+    if (clipmap) {
+        clipmap->clearWaves();
+        for (size_t i = 0; i < Ai.size(); i ++)
+            clipmap->addWave(Ai[i], wi[i], Di[i].x, Di[i].y, Si[i], Ci[i].x, Ci[i].y);
+        clipmap->setFamily(directional, rounded);
+
+        if (!clipVAO) {
+            size_t points = (size_t)clipmap->levels() * clipmap->resolution() * clipmap->resolution();
+            createStreams(points, clipmap->indices(), clipVAO, clipStaticVBO, clipSurfaceVBO, clipEBO);
+        }
+    }
+
+    refreshMesh();
+}
+
+/**
+ * @brief Draws the sum of waves from a grid fixed in screen space and unprojected onto the water plane through the camera every update (see
+ *        setView) instead of the mesh, so vertices are spent on the water in view, as densely as it shows on screen, however far it reaches
+ * 
+ * @param grid Projected grid (NULL - back to the mesh)
+ */
+void Water::setProjectedGrid(ProjectedGrid* grid) {
+    projgrid = grid;
+
+    if (projgrid && !projVAO)
+        createStreams(projgrid->vertices(), projgrid->indices, projVAO, projStaticVBO, projSurfaceVBO, projEBO);
+
+    refreshMesh();
+}
+
+/**
+ * @brief Sets the camera, for the projected grid to be unprojected through and the clipmap to center on at the next update
+ * 
+ * @param view View matrix of the camera
+ * @param projection Projection matrix of the camera
+ */
+void Water::setView(const glm::mat4& view, const glm::mat4& projection) {
+    viewMatrix = view;
+    projectionMatrix = projection;
+    setViewer(glm::vec3(glm::inverse(view)[3]));
+}
+
+/**
+ * @brief Creates a vertex array with the same streams as the mesh: x, z (attribute 0), then height (attribute 2) and normal (attribute 1), never
+ *        displaced horizontally, over static indices
+ * 
+ * @param points Number of vertices
+ * @param indexList Indices
+ * @param vao Vertex array created
+ * @param staticBuffer Buffer of the static stream created
+ * @param surfaceBuffer Buffer of the dynamic stream created
+ * @param indexBuffer Index buffer created
+ */
+void Water::createStreams(size_t points, const vector<unsigned int>& indexList, unsigned int& vao, unsigned int& staticBuffer, unsigned int& surfaceBuffer, unsigned int& indexBuffer) {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &staticBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, staticBuffer);
+    glBufferData(GL_ARRAY_BUFFER, points * WATER_STATIC_FLOATS * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, WATER_STATIC_FLOATS * sizeof(float), (void*)0);
+
+    glGenBuffers(1, &surfaceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, surfaceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, points * WATER_DYNAMIC_FLOATS * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, WATER_DYNAMIC_FLOATS * sizeof(float), (void*)(1 * sizeof(float)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, WATER_DYNAMIC_FLOATS * sizeof(float), (void*)0);
+
+    glDisableVertexAttribArray(3);
+    glVertexAttrib2f(3, 0, 0);
+
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexList.size() * sizeof(unsigned int), &indexList[0], GL_STATIC_DRAW);
+}
+
+/**
+ * @brief Sets where the viewer is, for the clipmap to center on at the next update
+ * 
+ * @param position Position of the camera
+ */
+void Water::setViewer(const glm::vec3& position) {
+    viewer = position;
+}
+
+/**
+ * @brief Whether the water is drawn from the clipmap
+ * 
+ * @return bool
+ */
+bool Water::clipmapped() const {
+    return mode() == WATER_MODE_CLIPMAP;
+}
+
+/**
+ * @brief Whether the water is drawn from the projected grid
+ * 
+ * @return bool
+ */
+bool Water::projected() const {
+    return mode() == WATER_MODE_PROJECTED;
+}
+
+/**
+ * @brief Sets how the normals of the mesh are computed by later calls to updateMesh
+ * 
+ * @param mode WATER_NORMALS_ANALYTIC (partials summed over every wave) or WATER_NORMALS_FINITE (central differences of the grid of heights, which
+ *        costs the same per vertex however many waves there are). Direct rows gain little from finite normals: sin and cos come from the same
+ *        sincos, so only the multiply-adds of the partials are saved (0.89x to 1.2x of analytic normals at 80 waves, between runs)
+ */
+void Water::setNormalMode(WaterNormalMode mode) {
+    normalMode = mode;
+    if (mode == WATER_NORMALS_FINITE)
+        heights.resize((size_t)pDimX * pDimZ);
+    else
+        heights.clear();
+}
+
+/**
+ * @brief Sets the steepness of the waves. Above 0 the mesh is made of Gerstner (trochoidal) waves instead of the sum of sines: vertices move
+ *        horizontally towards the crests, which sharpen. Takes effect at the next updateMesh. Only applies to directional, rounded waves
+ * 
+ * @param Q Steepness from 0 (sum of sines, rows evaluated by the evaluation mode) to 1 (sharpest crests)
+ */
+void Water::setSteepness(float Q) {
+    // only directional, rounded waves have a trochoidal form
+    if (!directional || !rounded)
+        return;
+    gerstner.setSteepness(Q);
+}
+
+/**
+ * @brief Sets how draw submits the strips of the mesh. Every mode draws from the same index buffer
+ * 
+ * @param mode WATER_DRAW_ROWS (a draw call per strip), WATER_DRAW_MULTI (glMultiDrawElements) or WATER_DRAW_RESTART (a single strip broken up
+ *        by primitive restart)
+ */
+void Water::setDrawMode(WaterDrawMode mode) {
+    drawMode = mode;
+}
+
+/**
+ * @brief Frees the CPU copy of the static stream (x, z of every vertex). The mesh is already uploaded and updates never read it back
+ */
+void Water::dropStaticCopy() {
+    vector<float>().swap(planar);
+}
+
+/**
+ * @brief Streams the dynamic vertex streams through a ring of STREAM_REGIONS persistently mapped regions: every update writes straight into
+ *        GPU visible memory, without the copy of glBufferSubData, and only waits if the GPU is still reading the region it comes back to. The
+ *        CPU copies of the dynamic streams are freed while streaming
+ * 
+ * @param enable Whether to stream through the ring (false - back to plain buffers updated with glBufferSubData)
+ * @return bool whether the mesh streams through the ring (false if persistent mapping is unsupported, OpenGL 4.4 or ARB_buffer_storage)
+ */
+bool Water::setStreaming(bool enable) {
+    size_t points = (size_t)pDimX * pDimZ;
+
+    if (enable && !ring.ready()) {
+        if (!ring.init(points * (WATER_DYNAMIC_FLOATS + WATER_DISPLACEMENT_FLOATS) * sizeof(float)))
+            return false;
+        vector<float>().swap(surface);
+        vector<float>().swap(displacement);
+    } else if (!enable && ring.ready()) {
+        ring.release();
+        surface.resize(points * WATER_DYNAMIC_FLOATS);
+    } else {
+        return ring.ready();
+    }
+
+    // the new streams have to be filled before the next draw
+    refreshMesh();
+    return ring.ready();
+}
+
+/**
+ * @brief Evaluates rows [first, last) of the mesh at the current internal time. Writes directly into the dynamic streams, which must already hold
+ *        pDimX * pDimZ vertices. Rows are independent, so tiles of rows may run concurrently. With finite difference normals, only the grid of
+ *        heights is filled (fillNormals writes the dynamic stream)
+ * 
+ * @param first First row
+ * @param last One past the last row
+ */
+void Water::fillRows(int first, int last) {
+    vector<float> rowH(pDimZ), rowDx(pDimZ), rowDz(pDimZ);
+    WaterMode current = mode();
+    bool choppy = (current == WATER_MODE_OCEAN);
+    vector<float> rowDispX(choppy ? pDimZ : 0), rowDispZ(choppy ? pDimZ : 0);
+    bool useBasis = (evalMode == WAVE_BASIS);
+    bool finite = finiteNormals();
+
+    for (int i = first; i < last; i ++) {
+        float x = rowX[i];
+
+        // trochoidal waves write their own (displaced) vertices
+        if (current == WATER_MODE_GERSTNER) {
+            gerstner.evaluateRow(x, &rowZ[0], pDimZ, internalTime, surfaceOut + (size_t)i * pDimZ * WATER_DYNAMIC_FLOATS,
+                displacementOut + (size_t)i * pDimZ * WATER_DISPLACEMENT_FLOATS);
+            continue;
+        }
+
+        // heights only, into the grid of heights (the dynamic stream is written later, by fillNormals)
+        if (finite) {
+            float* h = &heights[(size_t)i * pDimZ];
+            if (useBasis)
+                basis.evaluateRow(i, h, NULL, NULL);
+            else if (evalMode == WAVE_RECURRENCE)
+                field.evaluateRowRecurrence(x, rowZ[0], (float)pL / pDimZ, pDimZ, internalTime, h, NULL, NULL);
+            else
+                field.evaluateRow(x, &rowZ[0], pDimZ, internalTime, h, NULL, NULL);
+            continue;
+        }
+
+        // compute H and its partials for the whole row
+        if (choppy)
+            ocean->sampleRow(x, &rowZ[0], pDimZ, &rowH[0], &rowDx[0], &rowDz[0], &rowDispX[0], &rowDispZ[0]);
+        else if (useBasis)
+            basis.evaluateRow(i, &rowH[0], &rowDx[0], &rowDz[0]);
+        else if (evalMode == WAVE_RECURRENCE)
+            field.evaluateRowRecurrence(x, rowZ[0], (float)pL / pDimZ, pDimZ, internalTime, &rowH[0], &rowDx[0], &rowDz[0]);
+        else
+            field.evaluateRow(x, &rowZ[0], pDimZ, internalTime, &rowH[0], &rowDx[0], &rowDz[0]);
+
+        float* vertex = surfaceOut + (size_t)i * pDimZ * WATER_DYNAMIC_FLOATS;
+        for (int j = 0; j < pDimZ; j ++) {
+            // update heights (x and z live in the static stream)
+            vertex[0] = rowH[j];
+
+            // update normals (N = <-dH/dx, -dH/dz, 1>)
+            vertex[1] = 0 - rowDx[j];
+            vertex[2] = 0 - rowDz[j];
+            vertex[3] = 1;
+
+            vertex += WATER_DYNAMIC_FLOATS;
+        }
+
+        // choppy waves move vertices towards the crests
+        if (choppy) {
+            float* offset = displacementOut + (size_t)i * pDimZ * WATER_DISPLACEMENT_FLOATS;
+            for (int j = 0; j < pDimZ; j ++) {
+                offset[0] = rowDispX[j];
+                offset[1] = rowDispZ[j];
+                offset += WATER_DISPLACEMENT_FLOATS;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Evaluates every vertex of the mesh at the current internal time, a tile of rows at a time (on the thread pool if one is set). A spectral
+ *        ocean is synthesized once for the whole mesh first
+ */
+void Water::fillVertices() {
+    // a baked loop plays instead: only the pair of frames around this time goes up, when it changes (see uploadVertices)
+    if (cached()) {
+        if (culling())
+            tiles.cull(Frustum(projectionMatrix * viewMatrix), &rowX[0], &rowZ[0], heightBound());
+        return;
+    }
+
+    if (ringStreaming()) {
+        // both streams go straight into the next region of the ring (displacements after the heights and normals)
+        surfaceOut = (float*)ring.acquire();
+        ringWritten = true;
+        displacementOut = surfaceOut + (size_t)pDimX * pDimZ * WATER_DYNAMIC_FLOATS;
+    } else {
+        // the displacement stream only exists while vertices move sideways
+        if (displaced())
+            displacement.resize((size_t)pDimX * pDimZ * WATER_DISPLACEMENT_FLOATS);
+        else
+            displacement.clear();
+
+        // time-sliced updates of a streaming mesh keep a CPU copy of their own
+        if (timeSliced())
+            surface.resize((size_t)pDimX * pDimZ * WATER_DYNAMIC_FLOATS);
+
+        surfaceOut = surface.data();
+        displacementOut = displacement.data();
+    }
+
+    // packed vertices are evaluated into the CPU copy of the dynamic stream, and packed from there into the ring or the packed copy
+    packedOut = NULL;
+    if (packedVertices()) {
+        size_t points = (size_t)pDimX * pDimZ;
+        surface.resize(points * WATER_DYNAMIC_FLOATS);
+        if (ringStreaming()) {
+            packedOut = (int16_t*)surfaceOut;
+        } else {
+            packedSurface.resize(points * WATER_PACKED_SHORTS);
+            packedOut = packedSurface.data();
+        }
+        surfaceOut = surface.data();
+    }
+
+    // tiles outside the frustum can never show, whatever the waves do
+    if (culling())
+        tiles.cull(Frustum(projectionMatrix * viewMatrix), &rowX[0], &rowZ[0], heightBound());
+
+    if (culledSynthesis()) {
+        // the tiles kept by the cull, or only the ones the budget allows (the others keep the vertices of their last update)
+        spanMask = &tiles.visibleMask();
+        spanRows = glm::ivec2(tiles.visibleRowBegin(), tiles.visibleRowEnd());
+        if (timeSliced()) {
+            const vector<int>& picked = slicer.schedule(tiles, viewMatrix, projectionMatrix, &rowX[0], &rowZ[0], heightBound(), internalTime,
+                culling() ? &tiles.visible() : NULL);
+            spanMask = &slicer.scheduledMask();
+            spanRows = glm::ivec2(pDimX, -1);
+            for (size_t k = 0; k < picked.size(); k ++)
+                spanRows = glm::ivec2(std::min(spanRows.x, tiles.rowBegin(picked[k])), std::max(spanRows.y, tiles.rowEnd(picked[k])));
+        }
+
+        // only the spans of the rows under those tiles, packed as they go
+        auto start = std::chrono::steady_clock::now();
+        if (pool) {
+            pool->parallelFor(pDimX, WATER_TILE_ROWS, [this](int first, int last) { fillSpans(first, last); });
+        } else {
+            fillSpans(0, pDimX);
+        }
+        if (timeSliced()) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            slicer.record(elapsed.count(), slicer.lastFrame().vertices);
+        }
+        return;
+    }
+
+    if (mode() == WATER_MODE_OCEAN)
+        ocean->setTime(internalTime, pool);
+    else if (evalMode == WAVE_BASIS)
+        basis.setTime(field, internalTime);
+
+    if (pool) {
+        pool->parallelFor(pDimX, WATER_TILE_ROWS, [this](int first, int last) { fillRows(first, last); });
+    } else {
+        fillRows(0, pDimX);
+    }
+
+    // stencil pass over the finished grid of heights (each row reads its neighbours, so every height must be known first)
+    if (finiteNormals()) {
+        if (pool) {
+            pool->parallelFor(pDimX, WATER_TILE_ROWS, [this](int first, int last) { fillNormals(first, last); });
+        } else {
+            fillNormals(0, pDimX);
+        }
+    }
+
+    if (packedOut) {
+        if (pool) {
+            pool->parallelFor(pDimX, WATER_TILE_ROWS, [this](int first, int last) { packRows(first, last); });
+        } else {
+            packRows(0, pDimX);
+        }
+    }
+}
+
+/**
+ * @brief Evaluates the parts of rows [first, last) of the mesh under the tiles of this update, kept by the cull or picked by the scheduler
+ *        (analytic normals, direct or recurrence rows), packing them too when the stream is packed. The rest of the dynamic stream is left as it was, and is not drawn
+ * 
+ * @param first First row
+ * @param last One past the last row
+ */
+void Water::fillSpans(int first, int last) {
+    vector<float> rowH(pDimZ), rowDx(pDimZ), rowDz(pDimZ);
+    vector<glm::ivec2> spans;
+
+    float bound = heightBound();
+    float scale = bound > 0 ? SIMD_SNORM16_MAX / bound : 0;
+
+    for (int i = first; i < last; i ++) {
+        if (i < spanRows.x || i > spanRows.y)
+            continue;
+        float x = rowX[i];
+
+        tiles.spans(i, *spanMask, spans);
+        for (size_t s = 0; s < spans.size(); s ++) {
+            int j0 = spans[s].x, n = spans[s].y - spans[s].x + 1;
+
+            if (evalMode == WAVE_RECURRENCE)
+                field.evaluateRowRecurrence(x, rowZ[j0], (float)pL / pDimZ, n, internalTime, &rowH[0], &rowDx[0], &rowDz[0]);
+            else
+                field.evaluateRow(x, &rowZ[j0], n, internalTime, &rowH[0], &rowDx[0], &rowDz[0]);
+
+            size_t offset = (size_t)i * pDimZ + j0;
+            float* vertex = surfaceOut + offset * WATER_DYNAMIC_FLOATS;
+            for (int j = 0; j < n; j ++) {
+                // N = <-dH/dx, -dH/dz, 1>
+                vertex[0] = rowH[j];
+                vertex[1] = 0 - rowDx[j];
+                vertex[2] = 0 - rowDz[j];
+                vertex[3] = 1;
+                vertex += WATER_DYNAMIC_FLOATS;
+            }
+
+            if (packedOut)
+                packSurfaceArray(surfaceOut + offset * WATER_DYNAMIC_FLOATS, packedOut + offset * WATER_PACKED_SHORTS, n, scale);
+        }
+    }
+}
+
+/**
+ * @brief Whether the next update only evaluates the vertices under kept or scheduled tiles (the basis and finite difference normals work on whole
+ *        rows, so they evaluate every vertex and only the draw is culled)
+ * 
+ * @return bool
+ */
+bool Water::culledSynthesis() const {
+    return (culling() || timeSliced()) && !finiteNormals() && (evalMode == WAVE_DIRECT || evalMode == WAVE_RECURRENCE);
+}
+
+/**
+ * @brief Whether the dynamic streams are written straight into the ring. Time-sliced updates keep them in the CPU copies instead, as the tiles
+ *        an update skips have to keep the vertices of their last update
+ * 
+ * @return bool
+ */
+bool Water::ringStreaming() const {
+    return ring.ready() && !timeSliced() && !cached();
+}
+
+/**
+ * @brief Packs the dynamic stream of rows [first, last) of the mesh into WATER_PACKED_SHORTS per vertex (see packSurfaceArray)
+ * 
+ * @param first First row
+ * @param last One past the last row
+ */
+void Water::packRows(int first, int last) {
+    // flat water (no waves) packs to zero heights
+    float bound = heightBound();
+    float scale = bound > 0 ? SIMD_SNORM16_MAX / bound : 0;
+
+    size_t offset = (size_t)first * pDimZ;
+    packSurfaceArray(surfaceOut + offset * WATER_DYNAMIC_FLOATS, packedOut + offset * WATER_PACKED_SHORTS, (last - first) * pDimZ, scale);
+}
+
+/**
+ * @brief Writes the heights and normals of rows [first, last) of the mesh, the normals from central differences of the grid of heights
+ * 
+ * @param first First row
+ * @param last One past the last row
+ */
+void Water::fillNormals(int first, int last) {
+    vector<float> dhdx((size_t)(last - first) * pDimZ), dhdz((size_t)(last - first) * pDimZ);
+    gridSlopes(&heights[0], pDimX, pDimZ, (float)pW / pDimX, (float)pL / pDimZ, first, last, &dhdx[0], &dhdz[0]);
+
+    const float* h = &heights[(size_t)first * pDimZ];
+    float* vertex = surfaceOut + (size_t)first * pDimZ * WATER_DYNAMIC_FLOATS;
+    for (size_t k = 0; k < dhdx.size(); k ++) {
+        // N = <-dH/dx, -dH/dz, 1>
+        vertex[0] = h[k];
+        vertex[1] = 0 - dhdx[k];
+        vertex[2] = 0 - dhdz[k];
+        vertex[3] = 1;
+        vertex += WATER_DYNAMIC_FLOATS;
+    }
+}
+
+/**
+ * @brief Whether the normals of the next update come from finite differences (only for the sum of sines; the ocean and Gerstner waves keep their
+ *        analytic normals)
+ * 
+ * @return bool
+ */
+bool Water::finiteNormals() const {
+    return normalMode == WATER_NORMALS_FINITE && !displaced();
+}
+
+/**
+ * @brief Whether the next update moves vertices horizontally (choppy ocean or Gerstner waves), so the displacement stream has to be streamed too
+ * 
+ * @return bool
+ */
+bool Water::displaced() const {
+    WaterMode current = mode();
+    return current == WATER_MODE_OCEAN || current == WATER_MODE_GERSTNER;
+}
+
 /**
  * @brief Setup the mesh after wave functions have been initialized
  */
 void Water::setupMesh() {
-    // setup vertices
+    // setup row scratch
+    rowX.resize(pDimX);
+    for (int i = 0; i < pDimX; i ++) {
+        rowX[i] = pX - pW / 2 + (float)i * pW / pDimX;
+    }
+    rowZ.resize(pDimZ);
+    for (int j = 0; j < pDimZ; j ++) {
+        rowZ[j] = pZ - pL / 2 + (float)j * pL / pDimZ;
+    }
+
+    // setup the dynamic stream, filled in place from now on
+    if (!ring.ready())
+        surface.resize((size_t)pDimX * pDimZ * WATER_DYNAMIC_FLOATS);
+    fillVertices();
+
+    // vertex and index buffers, or textures for the heightfield mode
+    if (heightfield)
+        setupTextures();
+    else
+        setupBuffers();
+    uploadVertices();
+}
+
+/**
+ * @brief Creates the static stream and the indices of the mesh and registers the vertex buffers of every stream
+ */
+void Water::setupBuffers() {
+    // setup the static stream (x and z never change)
+    planar.resize((size_t)pDimX * pDimZ * WATER_STATIC_FLOATS);
     for (int i = 0; i < pDimX; i ++) {
+        float* vertex = &planar[(size_t)i * pDimZ * WATER_STATIC_FLOATS];
         for (int j = 0; j < pDimZ; j ++) {
-            // evaluate x and z (or just use i and j)
-            float x = pX - pW / 2 + (float)i * pW / pDimX;
-            float z = pZ - pL / 2 + (float)j * pL / pDimZ;
-            
-            // compute H / update vertices
-            float y = H(x, z, internalTime);
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-
-            // compute N / update normals
-            glm::vec3 normal = N(x, z, internalTime);
-            vertices.push_back(normal.x);
-            vertices.push_back(normal.y);
-            vertices.push_back(normal.z);
+            vertex[0] = rowX[i];
+            vertex[1] = rowZ[j];
+            vertex += WATER_STATIC_FLOATS;
         }
     }
 
-    // setup indices
-    for(int i = 0; i < pDimZ - 1; i ++) {
-        for(int j = 0; j < pDimX; j ++) {
+    // setup indices: a strip between every two neighbouring rows of the mesh, each followed by a restart marker
+    indices.clear();
+    stripCounts.clear();
+    stripOffsets.clear();
+    for(int i = 0; i < pDimX - 1; i ++) {
+        stripCounts.push_back(2 * pDimZ);
+        stripOffsets.push_back((const void*)(indices.size() * sizeof(unsigned int)));
+        for(int j = 0; j < pDimZ; j ++) {
             for(int k = 0; k < 2; k ++) {
-                indices.push_back(j + pDimX * (i + k));
+                indices.push_back(j + pDimZ * (i + k));
             }
         }
+        indices.push_back(RESTART_INDEX);
     }
 
+    // strips of every tile, for culling
+    tileIndexStart = indices.size();
+    if (cullingEnabled)
+        tiles.buildIndices(indices);
+
     // register/update buffers
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
 
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_DYNAMIC_DRAW);
+    // static stream: x, z (attribute 0), uploaded once
+    glGenBuffers(1, &staticVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, staticVBO);
+    glBufferData(GL_ARRAY_BUFFER, planar.size() * sizeof(float), &planar[0], GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, WATER_STATIC_FLOATS * sizeof(float), (void*)0);
+
+    // dynamic stream: normal (attribute 1) after the height (attribute 2), pointed at by uploadVertices
+    glGenBuffers(1, &surfaceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)pDimX * pDimZ * WATER_DYNAMIC_FLOATS * sizeof(float), NULL, GL_DYNAMIC_DRAW);
 
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    // horizontal displacement (attribute 3), only enabled while vertices move sideways
+    glGenBuffers(1, &displacementVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, displacementVBO);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)pDimX * pDimZ * WATER_DISPLACEMENT_FLOATS * sizeof(float), NULL, GL_DYNAMIC_DRAW);
     
     glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+}
+
+/**
+ * @brief Deletes the vertex and index buffers along with the static stream and the indices
+ */
+void Water::releaseBuffers() {
+    unsigned int buffers[4] = { staticVBO, surfaceVBO, displacementVBO, EBO };
+    glDeleteBuffers(4, buffers);
+    glDeleteVertexArrays(1, &VAO);
+
+    vector<float>().swap(planar);
+    vector<unsigned int>().swap(indices);
+    vector<int>().swap(stripCounts);
+    vector<const void*>().swap(stripOffsets);
+}
+
+/**
+ * @brief Creates the textures of the heightfield mode (height and normal as RGBA, displacement as RG, one texel per vertex) and the vertex array
+ *        without attributes the grid is drawn from
+ */
+void Water::setupTextures() {
+    glGenVertexArrays(1, &gridVAO);
+
+    glGenTextures(1, &surfaceTex);
+    glBindTexture(GL_TEXTURE_2D, surfaceTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, pDimZ, pDimX, 0, GL_RGBA, GL_FLOAT, NULL);
+
+    glGenTextures(1, &displacementTex);
+    glBindTexture(GL_TEXTURE_2D, displacementTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, pDimZ, pDimX, 0, GL_RG, GL_FLOAT, NULL);
+}
+
+/**
+ * @brief Deletes the textures and vertex array of the heightfield mode
+ */
+void Water::releaseTextures() {
+    unsigned int textures[2] = { surfaceTex, displacementTex };
+    glDeleteTextures(2, textures);
+    glDeleteVertexArrays(1, &gridVAO);
+}
+
+/**
+ * @brief Switches between drawing the mesh from vertex and index buffers and drawing it from the heightfield texture. In the heightfield mode only
+ *        the dynamic streams go up every frame, as textures; water.vs generates x, z of every vertex from gl_VertexID and gl_InstanceID, so the
+ *        static stream and the index buffer are freed
+ * 
+ * @param enable Whether to draw from the heightfield texture
+ */
+void Water::setHeightfieldMode(bool enable) {
+    if (enable == heightfield)
+        return;
+
+    if (enable) {
+        releaseBuffers();
+        setupTextures();
+    } else {
+        releaseTextures();
+        setupBuffers();
+    }
+    heightfield = enable;
+    uploadVertices();
+}
+
+/**
+ * @brief Packs the dynamic stream of the mesh before it goes up: the height as a 16 bit fraction of heightBound and the normal octahedrally
+ *        encoded into two more, 8 bytes per vertex instead of 16 (water.vs unpacks them). The waves are still evaluated in floats, then packed a
+ *        tile of rows at a time. Only the mesh of the sum of waves is packed; the heightfield mode, the spectral ocean and Gerstner waves keep
+ *        the float stream
+ * 
+ * @param enable Whether to pack the dynamic stream
+ * @return bool whether the mesh is drawn packed (false if the water is not drawn from the mesh of the sum of waves, see mode, or plays the baked
+ *         loop, which is always packed)
+ */
+bool Water::setPackedVertices(bool enable) {
+    packed = enable;
+    refreshMesh();
+    return packedVertices();
+}
+
+/**
+ * @brief Splits the mesh into tiles of CULL_TILE_QUADS quads a side, bounded by boxes as high as heightBound, and skips the tiles whose box is
+ *        outside the frustum of the camera (see setView; the model matrix of the water must be the identity): their strips are not drawn.
+ *        Their vertices are only left unevaluated with analytic normals and direct or recurrence rows (see culledSynthesis); the basis and finite
+ *        difference normals work on whole rows, so with those every vertex is still evaluated and culling only saves the draw. Only the mesh of
+ *        the sum of waves is culled
+ * 
+ * @param enable Whether to cull
+ * @return bool whether tiles are culled (false if the water is not drawn from the mesh of the sum of waves or the baked loop, see mode)
+ */
+bool Water::setCulling(bool enable) {
+    cullingEnabled = enable;
+    if (enable && !tiles.count())
+        tiles = TileGrid(pDimX, pDimZ, CULL_TILE_QUADS);
+
+    // the strips of the tiles follow the strips of the rows in the index buffer
+    if (!heightfield) {
+        indices.resize(tileIndexStart);
+        if (enable)
+            tiles.buildIndices(indices);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    }
+
+    refreshMesh();
+    return culling();
+}
+
+/**
+ * @brief Snaps the waves to a loop: every wave vector to the lattice of (2 pi / pW, 2 pi / pL) and every angular speed to a multiple of
+ *        2 pi / period (see snapToLoop), so the surface repeats every pW along x, every pL along z (directional waves) and every period seconds.
+ *        The frames of one period can then be baked once and played back forever (see setWaveCache)
+ * 
+ * @param period Seconds the waves repeat over (not above 0 - waves left as they are)
+ * @return bool whether the water drawn repeats (false if the waves were left as they are, or the spectral ocean replaces the sum of waves, see
+ *         mode)
+ */
+bool Water::setPeriodicWaves(float period) {
+    if (period <= 0)
+        return false;
+
+    loopSeconds = period;
+    for (size_t i = 0; i < Ai.size(); i ++)
+        snapToLoop(wi[i], Di[i].x, Di[i].y, Si[i], (float)pW, (float)pL, period, directional);
+    rebuildWaves();
+
+    // frames baked from the old waves no longer match
+    cache.close();
+    refreshMesh();
+    return mode() != WATER_MODE_OCEAN;
+}
+
+/**
+ * @brief Plays the mesh from one period of baked frames instead of evaluating the waves. The cache at path is mapped if it holds this loop
+ *        (same waves, grid, period and frames), otherwise it is baked there first (every frame evaluated once). Every update then only uploads
+ *        the two frames around the current time, straight from the mapping and only when they change, and water.vs blends between them. Needs
+ *        periodic waves (see setPeriodicWaves) and the mesh of the sum of waves (plays as the packed stream, whatever setPackedVertices says)
+ * 
+ * @param path Cache file (NULL - back to evaluating the waves)
+ * @param frames Frames baked over the period
+ * @return bool whether the mesh plays the baked loop (false if no cache could be mapped, or the water is not drawn from the mesh, see mode)
+ */
+bool Water::setWaveCache(const char* path, int frames) {
+    cache.close();
+
+    if (path && loopSeconds > 0 && frames > 0 && !displaced()) {
+        WaveCacheInfo info = loopInfo(frames);
+        if (!cache.open(path, info) && WaveCache::bake(path, info, [this](float t, float* out) { evaluateFrame(t, out); }))
+            cache.open(path, info);
+    }
+
+    refreshMesh();
+    return cached();
+}
+
+/**
+ * @brief Whether the mesh plays the baked loop
+ * 
+ * @return bool
+ */
+bool Water::cached() const {
+    return mode() == WATER_MODE_LOOP;
+}
+
+/**
+ * @brief What a cache of this loop holds: the grid, the frames over the period, the height bound, and a hash (FNV-1a) of the waves, their
+ *        family, the placement of the mesh and the normal mode
+ * 
+ * @param frames Frames over the period
+ * @return WaveCacheInfo
+ */
+WaveCacheInfo Water::loopInfo(int frames) const {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, size_t bytes) {
+        for (size_t k = 0; k < bytes; k ++) {
+            hash ^= ((const unsigned char*)data)[k];
+            hash *= 16777619u;
+        }
+    };
+    for (size_t i = 0; i < Ai.size(); i ++) {
+        float wave[7] = { Ai[i], wi[i], Di[i].x, Di[i].y, Si[i], Ci[i].x, Ci[i].y };
+        mix(wave, sizeof(wave));
+    }
+    int layout[7] = { pX, pZ, pW, pL, directional, rounded, normalMode };
+    mix(layout, sizeof(layout));
+
+    WaveCacheInfo info = { pDimX, pDimZ, frames, loopSeconds, heightBound(), hash };
+    return info;
+}
+
+/**
+ * @brief Evaluates the whole dynamic stream of the mesh at a time into out (for baking), leaving the current update alone
+ * 
+ * @param t Water time
+ * @param out pDimX * pDimZ vertices of WATER_DYNAMIC_FLOATS
+ */
+void Water::evaluateFrame(float t, float* out) {
+    float* savedSurface = surfaceOut;
+    float* savedDisplacement = displacementOut;
+    float savedTime = internalTime;
+    surfaceOut = out;
+    displacementOut = NULL;
+    internalTime = t;
+
+    if (evalMode == WAVE_BASIS)
+        basis.setTime(field, t);
+    if (pool) {
+        pool->parallelFor(pDimX, WATER_TILE_ROWS, [this](int first, int last) { fillRows(first, last); });
+        if (finiteNormals())
+            pool->parallelFor(pDimX, WATER_TILE_ROWS, [this](int first, int last) { fillNormals(first, last); });
+    } else {
+        fillRows(0, pDimX);
+        if (finiteNormals())
+            fillNormals(0, pDimX);
+    }
+
+    surfaceOut = savedSurface;
+    displacementOut = savedDisplacement;
+    internalTime = savedTime;
+}
+
+/**
+ * @brief Hands the wave information (Ai, wi, Di, Si, Ci) again to everything that keeps a copy of it, after it changed
+ */
+void Water::rebuildWaves() {
+    field.clear();
+    gerstner.clear();
+    for (size_t i = 0; i < Ai.size(); i ++) {
+        field.addWave(Ai[i], wi[i], Di[i].x, Di[i].y, Si[i], Ci[i].x, Ci[i].y);
+        gerstner.addWave(Ai[i], wi[i], Di[i].x, Di[i].y, Si[i]);
+    }
+    field.setFamily(directional, rounded);
+
+    if (basis.built()) {
+        basis.clear();
+        setEvalMode(evalMode);
+    }
+    if (clipmap) {
+        clipmap->clearWaves();
+        for (size_t i = 0; i < Ai.size(); i ++)
+            clipmap->addWave(Ai[i], wi[i], Di[i].x, Di[i].y, Si[i], Ci[i].x, Ci[i].y);
+        clipmap->setFamily(directional, rounded);
+    }
+    if (wavesSSBO) {
+        glDeleteBuffers(1, &wavesSSBO);
+        wavesSSBO = 0;
+        setupWaveTable();
+    }
 }
 
 /**
- * @brief Updates the mesh given current internal time and wave functions
+ * @brief Amortizes updates of the mesh over frames: every update only evaluates the tiles (see setCulling) a TileScheduler picks, the largest on
+ *        screen and longest since their last update first, for as long as their cost (measured as they go) fits the budget. The other tiles
+ *        keep the vertices of their last update, and the scheduler keeps the time every tile was evaluated at. Only for the mesh of the sum of
+ *        waves with analytic normals and direct or recurrence rows; the dynamic streams then go up from their CPU copies instead of the ring
+ * 
+ * @param ms Milliseconds an update may take (0 - off, every tile every update)
+ * @return bool whether updates are time sliced (false if the current mode or evaluation does not allow it, see timeSliced)
+ */
+bool Water::setUpdateBudget(double ms) {
+    slicingEnabled = ms > 0;
+    slicer.setBudget(ms);
+    if (slicingEnabled) {
+        if (!tiles.count())
+            tiles = TileGrid(pDimX, pDimZ, CULL_TILE_QUADS);
+        slicer.reset(tiles.count());
+        fullUpload = true;
+    }
+
+    refreshMesh();
+    return timeSliced();
+}
+
+/**
+ * @brief Whether updates are time sliced (budget set, evaluating the mesh of the sum of waves with analytic normals, direct or recurrence rows,
+ *        no baked loop playing)
+ * 
+ * @return bool
+ */
+bool Water::timeSliced() const {
+    return slicingEnabled && mode() == WATER_MODE_MESH && normalMode == WATER_NORMALS_ANALYTIC
+        && (evalMode == WAVE_DIRECT || evalMode == WAVE_RECURRENCE);
+}
+
+/**
+ * @brief Whether the mesh of the sum of waves is culled (culling on, drawing the mesh from vertex buffers or playing the baked loop)
+ * 
+ * @return bool
+ */
+bool Water::culling() const {
+    WaterMode current = mode();
+    return cullingEnabled && (current == WATER_MODE_MESH || current == WATER_MODE_LOOP);
+}
+
+/**
+ * @brief Whether the mesh is drawn from the packed dynamic stream (packing on, evaluating the mesh of the sum of waves into vertex buffers; the
+ *        baked loop always plays packed)
+ * 
+ * @return bool
+ */
+bool Water::packedVertices() const {
+    return packed && mode() == WATER_MODE_MESH;
+}
+
+/**
+ * @brief Largest height the sum of waves can reach either way: every wave at its crest (2 Ai for pointed crests, which range over [0, 2 Ai])
+ * 
+ * @return float
+ */
+float Water::heightBound() const {
+    float bound = 0;
+    for (size_t i = 0; i < Ai.size(); i ++)
+        bound += fabsf(Ai[i]);
+    return rounded ? bound : 2 * bound;
+}
+
+/**
+ * @brief Moves the synthesis of the sum of waves onto the GPU. The compute shader (shaders/water.cs) evaluates H and N at every vertex straight
+ *        into the heightfield texture, which water.vs draws and rocks.fs samples, so nothing is uploaded per frame. Turns on the heightfield
+ *        mode. The spectral ocean and Gerstner waves are still synthesized on the CPU
+ * 
+ * @param shader Compute shader program of shaders/water.cs (NULL - back to the CPU)
+ */
+void Water::setComputeShader(Shader* shader) {
+    compute = shader;
+
+    if (compute) {
+        setHeightfieldMode(true);
+        setupWaveTable();
+    }
+
+    refreshMesh();
+}
+
+/**
+ * @brief Uploads the wave table read by the compute shader and water.tes, once (it never changes): two vec4 per wave, (A, w, Dx, Dy) then
+ *        (S * w, Cx, Cy, 0)
+ */
+void Water::setupWaveTable() {
+    if (wavesSSBO)
+        return;
+
+    vector<float> table;
+    for (size_t i = 0; i < Ai.size(); i ++) {
+        float wave[8] = { Ai[i], wi[i], Di[i].x, Di[i].y, Si[i] * wi[i], Ci[i].x, Ci[i].y, 0 };
+        table.insert(table.end(), wave, wave + 8);
+    }
+    table.resize(table.size() + 8);     // never empty
+
+    glGenBuffers(1, &wavesSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, wavesSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, table.size() * sizeof(float), &table[0], GL_STATIC_DRAW);
+}
+
+/**
+ * @brief Draws the sum of waves as a coarse grid of patches tessellated on the GPU instead of the fixed pDimX x pDimZ mesh. water.tcs picks the
+ *        factor of every patch edge from its on-screen length and distance to the camera (see TessellationPolicy), and water.tes evaluates the
+ *        waves at every generated vertex, so triangles follow the on-screen area of the water. The mesh is not synthesized on the CPU meanwhile
+ *        (except for the heightfield texture, which the rocks keep sampling). The spectral ocean and Gerstner waves are drawn from the mesh
+ * 
+ * @param patches Patches along each side of the water (0 - back to the mesh)
+ * @param policy Level of detail policy of the patch edges
+ */
+void Water::setTessellation(int patches, const TessellationPolicy& policy) {
+    tessPatches = patches > 0 ? patches : 0;
+    tessPolicy = policy;
+
+    if (tessPatches) {
+        setupWaveTable();
+        if (!patchVAO)
+            glGenVertexArrays(1, &patchVAO);
+    }
+
+    // the mesh has gone stale if it was skipped while tessellated
+    refreshMesh();
+}
+
+/**
+ * @brief What the water is drawn from and how updates synthesize it, the one place the setters are resolved. The spectral ocean, then Gerstner
+ *        waves, replace the sum of waves whatever else is set. The sum of waves is drawn as tessellated patches, then from the projected grid, then
+ *        from the clipmap, otherwise from the mesh: the heightfield texture (synthesized by the compute shader if one is set), the baked loop if one
+ *        is mapped, or the vertex buffers
+ * 
+ * @return WaterMode
+ */
+WaterMode Water::mode() const {
+    if (ocean)
+        return WATER_MODE_OCEAN;
+    if (gerstner.steepness() > 0)
+        return WATER_MODE_GERSTNER;
+    if (tessPatches > 0)
+        return WATER_MODE_TESSELLATED;
+    if (projgrid)
+        return WATER_MODE_PROJECTED;
+    if (clipmap)
+        return WATER_MODE_CLIPMAP;
+    if (heightfield)
+        return compute ? WATER_MODE_COMPUTE : WATER_MODE_HEIGHTFIELD;
+    return cache.ready() ? WATER_MODE_LOOP : WATER_MODE_MESH;
+}
+
+/**
+ * @brief Whether the water is drawn as tessellated patches
+ * 
+ * @return bool
+ */
+bool Water::tessellated() const {
+    return mode() == WATER_MODE_TESSELLATED;
+}
+
+/**
+ * @brief Synthesizes the heightfield texture at the current internal time on the GPU, a WATER_COMPUTE_GROUP square of vertices per work group
+ */
+void Water::dispatchCompute() {
+    compute->use();
+    compute->setInt("waveCount", Ai.size());
+    compute->setBool("directional", directional);
+    compute->setBool("rounded", rounded);
+    compute->setInt("sharpness", WAVEFIELD_SHARPNESS);
+    compute->setFloat("time", internalTime);
+    compute->setVec2("gridOrigin", gridOrigin());
+    compute->setVec2("gridSpacing", (float)pW / pDimX, (float)pL / pDimZ);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, wavesSSBO);
+    glBindImageTexture(0, surfaceTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glDispatchCompute((pDimZ + WATER_COMPUTE_GROUP - 1) / WATER_COMPUTE_GROUP, (pDimX + WATER_COMPUTE_GROUP - 1) / WATER_COMPUTE_GROUP, 1);
+
+    // the texture fetches of water.vs and rocks.fs must see the writes
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    displacing = false;
+}
+
+/**
+ * @brief Updates the mesh given current internal time and wave functions. Does nothing for water that does not animate
  */
 void Water::updateMesh() {
-    // clear vertices/indices
-    vertices.clear();
-    indices.clear();
+    // the clipmap and the projected grid also follow the viewer over still water
+    if (!animated && !clipmapped() && !projected())
+        return;
 
-    // setup vertices
-    for (int i = 0; i < pDimX; i ++) {
-        for (int j = 0; j < pDimZ; j ++) {
-            // evaluate x and z (or just use i and j)
-            float x = pX - pW / 2 + (float)i * pW / pDimX;
-            float z = pZ - pL / 2 + (float)j * pL / pDimZ;
-            
-            // compute H / update vertices
-            float y = H(x, z, internalTime);
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-
-            // compute N / update normals
-            glm::vec3 normal = N(x, z, internalTime);
-            vertices.push_back(normal.x);
-            vertices.push_back(normal.y);
-            vertices.push_back(normal.z);
+    // recompute the dynamic streams in place (indices and the static stream never change)
+    refreshMesh();
+}
+
+/**
+ * @brief Synthesizes the mesh at the current internal time, on the GPU if the compute shader can, otherwise on the CPU followed by an upload
+ */
+void Water::refreshMesh() {
+    switch (mode()) {
+        case WATER_MODE_TESSELLATED:
+            // water.tes evaluates the waves itself
+            break;
+        case WATER_MODE_PROJECTED:
+            // the waves can lift the surface into view from below the screen by at most heightBound
+            if (projgrid->update(viewMatrix, projectionMatrix, 0, heightBound())) {
+                projgrid->evaluate(field, internalTime, pool);
+                uploadProjected();
+            }
+            break;
+        case WATER_MODE_CLIPMAP:
+            clipmap->update(viewer.x, viewer.z, internalTime, pool);
+            uploadClipmap();
+            break;
+        case WATER_MODE_COMPUTE:
+            dispatchCompute();
+            return;
+        default:
+            fillVertices();
+            uploadVertices();
+            return;
+    }
+
+    // the heightfield texture is still synthesized for the rocks
+    if (!heightfield)
+        return;
+    if (compute) {
+        dispatchCompute();
+        return;
+    }
+    fillVertices();
+    uploadVertices();
+}
+
+/**
+ * @brief Uploads the dynamic streams: heights and normals, and the horizontal displacements while there are any (the displacement attribute
+ *        otherwise reads a constant (0, 0), so still x, z cost no bandwidth). While streaming, the streams are already in the region of the ring
+ *        acquired for this frame and only the attributes move to it
+ */
+void Water::uploadVertices() {
+    bool moving = displaced();
+    displacing = moving;
+
+    if (heightfield) {
+        // texel rows are rows of the mesh, so the streams go up as they are (out of the ring, as a pixel buffer, while streaming)
+        const char* surfaceData = (const char*)surfaceOut;
+        const char* displacementData = (const char*)displacementOut;
+        if (ringStreaming()) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer());
+            surfaceData = (const char*)ring.offset();
+            displacementData = surfaceData + (size_t)pDimX * pDimZ * WATER_DYNAMIC_FLOATS * sizeof(float);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, surfaceTex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pDimZ, pDimX, GL_RGBA, GL_FLOAT, surfaceData);
+        if (moving) {
+            glBindTexture(GL_TEXTURE_2D, displacementTex);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pDimZ, pDimX, GL_RG, GL_FLOAT, displacementData);
         }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
     }
 
-    // update buffers
     glBindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), &vertices[0]);
+    if (cached()) {
+        // this frame (heights and normals, attributes 2 and 1) and the next (attributes 5 and 4), straight out of the mapping
+        float blend;
+        int frame = cache.frameAt(internalTime, blend);
+        size_t bytes = cache.frameBytes();
+        cacheBlend = blend;
+
+        glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
+        if (frame != cacheFrame) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, cache.frame(frame));
+            glBufferSubData(GL_ARRAY_BUFFER, bytes, bytes, cache.frame(frame + 1));
+            cacheFrame = frame;
+        }
+        glVertexAttribPointer(2, 1, GL_SHORT, GL_TRUE, WAVECACHE_VERTEX_BYTES, (void*)0);
+        glVertexAttribPointer(1, 2, GL_BYTE, GL_TRUE, WAVECACHE_VERTEX_BYTES, (void*)sizeof(int16_t));
+        glVertexAttribPointer(5, 1, GL_SHORT, GL_TRUE, WAVECACHE_VERTEX_BYTES, (void*)bytes);
+        glVertexAttribPointer(4, 2, GL_BYTE, GL_TRUE, WAVECACHE_VERTEX_BYTES, (void*)(bytes + sizeof(int16_t)));
+        glEnableVertexAttribArray(4);
+        glEnableVertexAttribArray(5);
+        glDisableVertexAttribArray(3);
+        glVertexAttrib2f(3, 0, 0);
+        return;
+    }
+
+    // back from the baked loop: the buffer holds its frames instead of the dynamic stream
+    if (cacheFrame >= 0) {
+        glDisableVertexAttribArray(4);
+        glDisableVertexAttribArray(5);
+        cacheFrame = -1;
+        fullUpload = true;
+    }
+
+    if (packedVertices()) {
+        // height (attribute 2) and octahedral normal (attribute 1) as normalized shorts, decoded by water.vs; never displaced
+        unsigned int packedBuffer = surfaceVBO;
+        size_t packedOffset = 0;
+        if (ringStreaming()) {
+            packedBuffer = ring.buffer();
+            packedOffset = ring.offset();
+        } else {
+            size_t first, count;
+            uploadRange(first, count);
+            glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, first * WATER_PACKED_SHORTS * sizeof(int16_t), count * WATER_PACKED_SHORTS * sizeof(int16_t),
+                &packedSurface[first * WATER_PACKED_SHORTS]);
+            fullUpload = false;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, packedBuffer);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, WATER_PACKED_SHORTS * sizeof(int16_t), (void*)(packedOffset + 1 * sizeof(int16_t)));
+        glVertexAttribPointer(2, 1, GL_SHORT, GL_TRUE, WATER_PACKED_SHORTS * sizeof(int16_t), (void*)packedOffset);
+        glDisableVertexAttribArray(3);
+        glVertexAttrib2f(3, 0, 0);
+        return;
+    }
+
+    unsigned int surfaceBuffer = surfaceVBO, displacementBuffer = displacementVBO;
+    size_t surfaceOffset = 0, displacementOffset = 0;
+    if (ringStreaming()) {
+        surfaceBuffer = ring.buffer();
+        displacementBuffer = ring.buffer();
+        surfaceOffset = ring.offset();
+        displacementOffset = surfaceOffset + (size_t)pDimX * pDimZ * WATER_DYNAMIC_FLOATS * sizeof(float);
+    } else {
+        size_t first, count;
+        uploadRange(first, count);
+        glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, first * WATER_DYNAMIC_FLOATS * sizeof(float), count * WATER_DYNAMIC_FLOATS * sizeof(float),
+            &surface[first * WATER_DYNAMIC_FLOATS]);
+        fullUpload = false;
+
+        if (moving) {
+            glBindBuffer(GL_ARRAY_BUFFER, displacementVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, displacement.size() * sizeof(float), &displacement[0]);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, surfaceBuffer);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, WATER_DYNAMIC_FLOATS * sizeof(float), (void*)(surfaceOffset + 1 * sizeof(float)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, WATER_DYNAMIC_FLOATS * sizeof(float), (void*)surfaceOffset);
+
+    if (moving) {
+        glBindBuffer(GL_ARRAY_BUFFER, displacementBuffer);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, WATER_DISPLACEMENT_FLOATS * sizeof(float), (void*)displacementOffset);
+        glEnableVertexAttribArray(3);
+    } else {
+        glDisableVertexAttribArray(3);
+        glVertexAttrib2f(3, 0, 0);
+    }
 }
 
 /**
- * @brief Draws the mesh
+ * @brief Vertices of the dynamic stream to upload: every one, or only the rows under the tiles the update evaluated (every one again on the
+ *        first time-sliced update, so the tiles it skips hold the CPU copy rather than whatever the buffer held)
  * 
- * @param shader 
+ * @param first Returned first vertex
+ * @param count Returned number of vertices
  */
-void Water::draw(Shader* shader, unsigned int cubeTexture) {
-    glBindVertexArray(VAO);
+void Water::uploadRange(size_t& first, size_t& count) const {
+    first = 0;
+    count = (size_t)pDimX * pDimZ;
+    if (culledSynthesis() && !fullUpload) {
+        int begin = spanRows.x, end = spanRows.y;
+        first = begin <= end ? (size_t)begin * pDimZ : 0;
+        count = begin <= end ? (size_t)(end - begin + 1) * pDimZ : 0;
+    }
+}
 
+/**
+ * @brief Draws the water from whatever its mode draws it from, then fences the region of the ring the last update wrote, if it wrote one
+ * 
+ * @param shader Program of the mode (see tessellated)
+ * @param cubeTexture Cube map of the sky
+ */
+void Water::draw(Shader* shader, unsigned int cubeTexture) {
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTexture);
 
-    // render the mesh triangle strip by triangle strip - each row at a time
-    for(int i = 0; i < pDimZ-1; i ++) {
-        glDrawElements(GL_TRIANGLE_STRIP, pDimX, GL_UNSIGNED_INT, 
-            (void*)(sizeof(unsigned int) * pDimX * i));
+    WaterMode current = mode();
+    if (current == WATER_MODE_TESSELLATED) {
+        drawPatches(shader);
+    } else {
+        // the samplers of the heightfield mode keep units of their own even when unused (a sampler2D left on the unit of the samplerCube fails every draw)
+        bool meshed = (current != WATER_MODE_PROJECTED && current != WATER_MODE_CLIPMAP);
+        shader->setInt("surfaceMap", 1);
+        shader->setInt("displacementMap", 2);
+        shader->setBool("heightfield", heightfield && meshed);
+        shader->setBool("packedSurface", packedVertices() || current == WATER_MODE_LOOP);
+        shader->setFloat("heightBound", heightBound());
+        shader->setFloat("loopBlend", current == WATER_MODE_LOOP ? cacheBlend : 0.0f);
+
+        if (current == WATER_MODE_PROJECTED)
+            drawProjected();
+        else if (current == WATER_MODE_CLIPMAP)
+            drawClipmap();
+        else
+            drawMesh(shader);
+    }
+
+    // the region of the ring just drawn from (or uploaded to the heightfield texture from) may not be written again until these commands are done
+    if (ringWritten) {
+        ring.fence();
+        ringWritten = false;
+    }
+}
+
+/**
+ * @brief Draws the mesh, from the heightfield texture or from the vertex buffers (culled, or submitted as the draw mode says)
+ * 
+ * @param shader Program of water.vs (model, view, projection and the samplers already set)
+ */
+void Water::drawMesh(Shader* shader) {
+    if (heightfield) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, surfaceTex);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, displacementTex);
+
+        shader->setBool("displaced", displacing);
+        shader->setVec2("gridOrigin", gridOrigin());
+        shader->setVec2("gridSpacing", (float)pW / pDimX, (float)pL / pDimZ);
+
+        // a strip per pair of neighbouring rows (instances), the vertices of each generated from gl_VertexID; no vertex or index buffer
+        glBindVertexArray(gridVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * pDimZ, pDimX - 1);
+        lastDrawCalls = 1;
+        return;
+    }
+
+    glBindVertexArray(VAO);
+
+    int strips = stripCounts.size();
+    if (culling()) {
+        // the strips of every kept tile in one call, broken up at every RESTART_INDEX
+        const vector<int>& kept = tiles.visible();
+        tileCounts.resize(kept.size());
+        tileOffsets.resize(kept.size());
+        for (size_t k = 0; k < kept.size(); k ++) {
+            tileCounts[k] = tiles.indexCount(kept[k]);
+            tileOffsets[k] = (const void*)((tileIndexStart + tiles.offset(kept[k])) * sizeof(unsigned int));
+        }
+
+        lastDrawCalls = 0;
+        if (!kept.empty()) {
+            glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+            glMultiDrawElements(GL_TRIANGLE_STRIP, &tileCounts[0], GL_UNSIGNED_INT, &tileOffsets[0], kept.size());
+            glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+            lastDrawCalls = 1;
+        }
+    } else if (drawMode == WATER_DRAW_RESTART) {
+        // the whole mesh in one call, strips broken up at every RESTART_INDEX
+        glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+        glDrawElements(GL_TRIANGLE_STRIP, indices.size(), GL_UNSIGNED_INT, (void*)0);
+        glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+        lastDrawCalls = 1;
+    } else if (drawMode == WATER_DRAW_MULTI) {
+        // every strip in one call
+        glMultiDrawElements(GL_TRIANGLE_STRIP, &stripCounts[0], GL_UNSIGNED_INT, &stripOffsets[0], strips);
+        lastDrawCalls = 1;
+    } else {
+        // render the mesh triangle strip by triangle strip - each row at a time
+        for(int i = 0; i < strips; i ++) {
+            glDrawElements(GL_TRIANGLE_STRIP, stripCounts[i], GL_UNSIGNED_INT, stripOffsets[i]);
+        }
+        lastDrawCalls = strips;
+    }
+}
+
+/**
+ * @brief Draws the tessellated patch grid (a patch per instance, its corners generated from gl_VertexID) over the same extent as the mesh
+ * 
+ * @param shader Tessellation program (model, view, projection and cameraPos already set)
+ */
+void Water::drawPatches(Shader* shader) {
+    // on-screen lengths are measured in the current viewport
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    shader->setVec2("gridOrigin", gridOrigin());
+    shader->setVec2("patchSize", gridSize() / (float)tessPatches);
+    shader->setInt("patches", tessPatches);
+    shader->setFloat("viewportHeight", (float)viewport[3]);
+    shader->setFloat("edgePixels", tessPolicy.edgePixels());
+    shader->setFloat("maxLevel", tessPolicy.maxLevel());
+    shader->setFloat("fadeNear", tessPolicy.fadeNear());
+    shader->setFloat("fadeFar", tessPolicy.fadeFar());
+
+    shader->setInt("waveCount", Ai.size());
+    shader->setBool("directional", directional);
+    shader->setBool("rounded", rounded);
+    shader->setInt("sharpness", WAVEFIELD_SHARPNESS);
+    shader->setFloat("time", internalTime);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, wavesSSBO);
+
+    glBindVertexArray(patchVAO);
+    glPatchParameteri(GL_PATCH_VERTICES, 4);
+    glDrawArraysInstanced(GL_PATCHES, 0, 4, tessPatches * tessPatches);
+    lastDrawCalls = 1;
+}
+
+/**
+ * @brief Uploads the dynamic stream of every level of the clipmap, and the static stream when a level moved
+ */
+void Water::uploadClipmap() {
+    if (clipmap->moved()) {
+        glBindBuffer(GL_ARRAY_BUFFER, clipStaticVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, clipmap->planar.size() * sizeof(float), &clipmap->planar[0]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, clipSurfaceVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, clipmap->surface.size() * sizeof(float), &clipmap->surface[0]);
+}
+
+/**
+ * @brief Draws every level of the clipmap, each with the index variant that leaves out its hole (a draw call per level)
+ */
+void Water::drawClipmap() {
+    int n = clipmap->resolution();
+
+    glBindVertexArray(clipVAO);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    for (int l = 0; l < clipmap->levels(); l ++) {
+        int v = clipmap->variant(l);
+        glDrawElementsBaseVertex(GL_TRIANGLE_STRIP, clipmap->variantCount(v), GL_UNSIGNED_INT,
+            (void*)(clipmap->variantOffset(v) * sizeof(unsigned int)), l * n * n);
     }
-}
\ No newline at end of file
+    glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    lastDrawCalls = clipmap->levels();
+}
+
+/**
+ * @brief Uploads both streams of the projected grid (its vertices move with the camera)
+ */
+void Water::uploadProjected() {
+    glBindBuffer(GL_ARRAY_BUFFER, projStaticVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, projgrid->planar.size() * sizeof(float), &projgrid->planar[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, projSurfaceVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, projgrid->surface.size() * sizeof(float), &projgrid->surface[0]);
+}
+
+/**
+ * @brief Draws the projected grid in one call, strips broken up at every RESTART_INDEX (nothing while no water is in view)
+ */
+void Water::drawProjected() {
+    lastDrawCalls = 0;
+    if (!projgrid->visible())
+        return;
+
+    glBindVertexArray(projVAO);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glDrawElements(GL_TRIANGLE_STRIP, projgrid->indices.size(), GL_UNSIGNED_INT, (void*)0);
+    glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    lastDrawCalls = 1;
+}
+
+/**
+ * @brief Construct a new Gerstner object with no waves and a steepness of 0
+ */
+Gerstner::Gerstner() : Q(0) {
+
+}
+
+/**
+ * @brief Removes every wave
+ */
+void Gerstner::clear() {
+    A.clear(); w.clear(); Dx.clear(); Dy.clear(); Sw.clear();
+    Ax.clear(); Ay.clear();
+    QAx.clear(); QAy.clear();
+    QWxx.clear(); QWxy.clear(); QWyy.clear();
+}
+
+/**
+ * @brief Adds a wave. The steepness of every wave is rebalanced, as it depends on the number of waves
+ * 
+ * @param A Amplitude
+ * @param w Frequency
+ * @param Dx x component of the direction
+ * @param Dy y component of the direction
+ * @param S Phase-constant
+ */
+void Gerstner::addWave(float A, float w, float Dx, float Dy, float S) {
+    this->A.push_back(A);
+    this->w.push_back(w);
+    this->Dx.push_back(Dx);
+    this->Dy.push_back(Dy);
+    this->Sw.push_back(S * w);
+    this->Ax.push_back(w * Dx * A);
+    this->Ay.push_back(w * Dy * A);
+
+    updateSteepness();
+}
+
+/**
+ * @brief Sets the steepness of every wave
+ * 
+ * @param Q Steepness from 0 (sum of sines) to 1 (sharpest crests that do not loop over)
+ */
+void Gerstner::setSteepness(float Q) {
+    this->Q = (Q < 0) ? 0 : Q;
+    updateSteepness();
+}
+
+/**
+ * @brief Recomputes the displacement amplitudes of every wave, Qi = Q / (wi Ai |Di|^2 numWaves). The partials of the displacement then sum to at
+ *        most Q in magnitude, so the surface never folds over itself for Q <= 1
+ */
+void Gerstner::updateSteepness() {
+    int waves = count();
+    QAx.resize(waves); QAy.resize(waves);
+    QWxx.resize(waves); QWxy.resize(waves); QWyy.resize(waves);
+
+    for (int i = 0; i < waves; i ++) {
+        float d2 = Dx[i] * Dx[i] + Dy[i] * Dy[i];
+        float qw = (d2 > 0) ? Q / (d2 * waves) : 0;     // Qi * wi * Ai
+        float qa = (w[i] > 0) ? qw / w[i] : 0;          // Qi * Ai
+
+        QAx[i] = qa * Dx[i];
+        QAy[i] = qa * Dy[i];
+        QWxx[i] = qw * Dx[i] * Dx[i];
+        QWxy[i] = qw * Dx[i] * Dy[i];
+        QWyy[i] = qw * Dy[i] * Dy[i];
+    }
+}
+
+/**
+ * @brief Evaluates a row of n points sharing an x coordinate, writing the heights, exact normals and horizontal displacements straight into vertex streams.
+ *        The sin/cos of every phase are batched through sincosArray (simdmath.h) a chunk of points at a time. The normal is the cross product of
+ *        the partials of P, which reduces to <-dH/dx, -dH/dy, 1> (the layout of Water) for a steepness of 0
+ * 
+ * @param x x coordinate of the row
+ * @param z Array of n z coordinates
+ * @param n Number of points
+ * @param t time elapsed
+ * @param surface Returned n vertices of WATER_DYNAMIC_FLOATS floats (height then normal)
+ * @param displacement Returned n horizontal displacements of WATER_DISPLACEMENT_FLOATS floats (along x then z)
+ */
+void Gerstner::evaluateRow(float x, const float* z, int n, float t, float* surface, float* displacement) const {
+    alignas(WAVEFIELD_ALIGN) float phase[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float s[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float c[WAVEFIELD_CHUNK];
+
+    // sums over the waves of the current chunk
+    alignas(WAVEFIELD_ALIGN) float h[WAVEFIELD_CHUNK], hx[WAVEFIELD_CHUNK], hy[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float px[WAVEFIELD_CHUNK], py[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float bxx[WAVEFIELD_CHUNK], bxy[WAVEFIELD_CHUNK], byy[WAVEFIELD_CHUNK];
+
+    int waves = count();
+    for (int j0 = 0; j0 < n; j0 += WAVEFIELD_CHUNK) {
+        int m = (n - j0 < WAVEFIELD_CHUNK) ? n - j0 : WAVEFIELD_CHUNK;
+
+        for (int j = 0; j < m; j ++) {
+            h[j] = 0; hx[j] = 0; hy[j] = 0;
+            px[j] = 0; py[j] = 0;
+            bxx[j] = 0; bxy[j] = 0; byy[j] = 0;
+        }
+
+        for (int i = 0; i < waves; i ++) {
+            float f = w[i], dy = Dy[i];
+            float pdx = Dx[i] * x;
+            float st = Sw[i] * t;
+
+            for (int j = 0; j < m; j ++) {
+                phase[j] = (pdx + dy * z[j0 + j]) * f + st;
+            }
+            sincosArray(phase, s, c, m);
+
+            float a = A[i], ax = Ax[i], ay = Ay[i];
+            float qax = QAx[i], qay = QAy[i];
+            float qxx = QWxx[i], qxy = QWxy[i], qyy = QWyy[i];
+            for (int j = 0; j < m; j ++) {
+                h[j] += a * s[j];
+                hx[j] += ax * c[j];
+                hy[j] += ay * c[j];
+                px[j] += qax * c[j];
+                py[j] += qay * c[j];
+                bxx[j] += qxx * s[j];
+                bxy[j] += qxy * s[j];
+                byy[j] += qyy * s[j];
+            }
+        }
+
+        // dP/dx = <1 - bxx, -bxy, hx>, dP/dy = <-bxy, 1 - byy, hy>, N = dP/dx cross dP/dy
+        float* vertex = surface + (size_t)j0 * WATER_DYNAMIC_FLOATS;
+        float* offset = displacement + (size_t)j0 * WATER_DISPLACEMENT_FLOATS;
+        for (int j = 0; j < m; j ++) {
+            vertex[0] = h[j];
+            vertex[1] = 0 - bxy[j] * hy[j] - hx[j] * (1 - byy[j]);
+            vertex[2] = 0 - hx[j] * bxy[j] - (1 - bxx[j]) * hy[j];
+            vertex[3] = (1 - bxx[j]) * (1 - byy[j]) - bxy[j] * bxy[j];
+
+            offset[0] = px[j];
+            offset[1] = py[j];
+
+            vertex += WATER_DYNAMIC_FLOATS;
+            offset += WATER_DISPLACEMENT_FLOATS;
+        }
+    }
+}
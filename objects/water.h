@@ -12,6 +12,17 @@
 #define WATER_H
 
 #include "helper.h"
+#include "wavefield.h"
+#include "threadpool.h"
+#include "ocean.h"
+#include "streambuffer.h"
+#include "tessellation.h"
+#include "restart.h"
+#include "clipmap.h"
+#include "projectedgrid.h"
+#include "culling.h"
+#include "scheduler.h"
+#include "wavecache.h"
 
 #include <vector>
 #include <stdlib.h>
@@ -21,11 +32,94 @@
 #define MAXFREQ 1.0f
 #define MAXSPED 0.005f
 
-//TODO: reimplement Water class using tesselation shaders
+// number of mesh rows per tile when the mesh is updated on a thread pool
+#define WATER_TILE_ROWS 16
+
+// floats per vertex of each vertex stream: static (x, z), dynamic (height, then the normal) and horizontal displacement (x, z)
+#define WATER_STATIC_FLOATS 2
+#define WATER_DYNAMIC_FLOATS 4
+#define WATER_DISPLACEMENT_FLOATS 2
+
+// shorts per vertex of the packed dynamic stream: snorm16 height (over the amplitude bound), octahedral normal (x, y) and a pad, 8 bytes instead of
+// the 16 of the float stream
+#define WATER_PACKED_SHORTS 4
+
+// how the normals of the mesh are computed
+enum WaterNormalMode {
+    WATER_NORMALS_ANALYTIC=0,   // partials summed over every wave, alongside the heights
+    WATER_NORMALS_FINITE=1      // central differences of the grid of heights (O(1) per vertex instead of O(waves))
+};
+
+// how the strips of the mesh are submitted
+enum WaterDrawMode {
+    WATER_DRAW_ROWS=0,      // one glDrawElements per strip (one draw call per row of the mesh)
+    WATER_DRAW_MULTI=1,     // every strip in a single glMultiDrawElements
+    WATER_DRAW_RESTART=2    // a single glDrawElements over every strip, separated by primitive restart markers
+};
+
+// what the water is drawn from and how updates synthesize it (see Water::mode). The spectral ocean and Gerstner waves are drawn from the mesh,
+// as vertex buffers or the heightfield texture
+enum WaterMode {
+    WATER_MODE_MESH=0,          // sum of waves evaluated on the CPU into the vertex buffers of the mesh
+    WATER_MODE_HEIGHTFIELD=1,   // sum of waves evaluated on the CPU into the heightfield texture
+    WATER_MODE_COMPUTE=2,       // sum of waves synthesized into the heightfield texture by the compute shader
+    WATER_MODE_OCEAN=3,         // spectral ocean
+    WATER_MODE_GERSTNER=4,      // Gerstner waves
+    WATER_MODE_TESSELLATED=5,   // sum of waves evaluated by water.tes over tessellated patches
+    WATER_MODE_CLIPMAP=6,       // sum of waves over the levels of the clipmap
+    WATER_MODE_PROJECTED=7,     // sum of waves over the projected grid
+    WATER_MODE_LOOP=8           // mesh played from the frames of the baked loop
+};
+
+// side of the work groups of shaders/water.cs (its local_size_x and local_size_y)
+#define WATER_COMPUTE_GROUP 16
+
+// random float from 0 to x
+float randFloat(float x);
+
+// rougher seas. variations on intensity
+// Gerstner (trochoidal) waves: the same sum of waves, but every wave also moves the points of the surface horizontally, towards its crests
+//     P(x, y, t) = (x + sum of Qi Ai Di.x cos (theta i), y + sum of Qi Ai Di.y cos (theta i), sum of Ai sin (theta i)), theta i = Di dot (x, y) * wi + Si * wi * t
+// with Qi = Q / (wi Ai |Di|^2 numWaves), so steepness Q = 0 gives the plain sum of sines and Q = 1 the sharpest crests that never loop over
+class Gerstner {
+    public:
+        Gerstner();
+
+        void clear();
+        void addWave(float A, float w, float Dx, float Dy, float S);
+        int count() const { return A.size(); }
+
+        void setSteepness(float Q);
+        float steepness() const { return Q; }
+
+        // row of n points sharing the same x coordinate, written straight into the vertex streams of Water: height then normal (up component last)
+        // into surface, horizontal displacement into displacement
+        void evaluateRow(float x, const float* z, int n, float t, float* surface, float* displacement) const;
+
+    private:
+        void updateSteepness();
+
+        float Q;
+
+        // wave table (one entry per wave)
+        AlignedFloats A, w, Dx, Dy, Sw;
+        AlignedFloats Ax, Ay;               // slope amplitudes (w * Dx * A, w * Dy * A)
+        AlignedFloats QAx, QAy;             // horizontal displacement amplitudes (Qi * A * Dx, Qi * A * Dy)
+        AlignedFloats QWxx, QWxy, QWyy;     // amplitudes of the partials of the displacement (Qi * w * A * Dx * Dx, ...)
+};
+
 // generally calmer water. options for rounded/pointed peaks or directional/circular waves
 class Water {
     public:
-        vector<float> vertices;
+        // static stream: x, z of every vertex, uploaded once (empty once dropped, see dropStaticCopy)
+        vector<float> planar;
+
+        // dynamic stream: height, then the normal of every vertex, rewritten in place by every update (empty while streaming, see setStreaming)
+        vector<float> surface;
+
+        // horizontal displacement of every vertex (only filled while the ocean or Gerstner waves move vertices sideways, empty while streaming)
+        vector<float> displacement;
+
         vector<unsigned int> indices;
 
         Water(int px, int pz, int pw, int pl, int pdimx, int pdimz, float maxA, int maxI, bool dir, bool rnd, bool anim);
@@ -33,6 +127,84 @@ class Water {
         void setupMesh();
         void updateMesh();
         void updateTime(float dT);
+        void setEvalMode(WaveEvalMode mode);
+        void setNormalMode(WaterNormalMode mode);
+        void setThreadPool(ThreadPool* pool);
+        void setOcean(Ocean* ocean);
+        void setSteepness(float Q);
+        void dropStaticCopy();
+        bool setStreaming(bool enable);
+        void setDrawMode(WaterDrawMode mode);
+        void setHeightfieldMode(bool enable);
+        bool setPackedVertices(bool enable);
+        bool setCulling(bool enable);
+        bool setUpdateBudget(double ms);
+        bool setPeriodicWaves(float period);
+        bool setWaveCache(const char* path, int frames = WAVECACHE_FRAMES);
+        void setComputeShader(Shader* shader);
+        void setTessellation(int patches, const TessellationPolicy& policy = TessellationPolicy());
+
+        void setClipmap(Clipmap* clipmap);
+        void setViewer(const glm::vec3& position);
+
+        void setProjectedGrid(ProjectedGrid* grid);
+        void setView(const glm::mat4& view, const glm::mat4& projection);
+
+        // what the water is drawn from, resolved from the setters above (see WaterMode)
+        WaterMode mode() const;
+
+        // whether the water is drawn from the levels of the clipmap around the viewer instead of the mesh
+        bool clipmapped() const;
+
+        // whether the water is drawn from the grid projected from the screen onto the water plane instead of the mesh
+        bool projected() const;
+
+        // whether the mesh is drawn from the packed dynamic stream (see setPackedVertices)
+        bool packedVertices() const;
+
+        // whether tiles of the mesh outside the frustum of the camera (see setView) are skipped by updates and draws
+        bool culling() const;
+
+        // totals of the tiles and vertices culled so far
+        const CullStats& cullStats() const { return tiles.stats(); }
+
+        // whether updates only evaluate the tiles their budget allows (see setUpdateBudget), and the scheduler picking them (which keeps the
+        // time every tile was evaluated at)
+        bool timeSliced() const;
+        const TileScheduler& updateScheduler() const { return slicer; }
+
+        // seconds after which the waves repeat, as they also repeat every pW along x and pL along z (0 - free waves, see setPeriodicWaves)
+        float loopPeriod() const { return loopSeconds; }
+
+        // whether the mesh plays the frames of the baked loop (see setWaveCache) instead of evaluating the waves
+        bool cached() const;
+
+        // largest height the sum of waves can reach either way (sum of the amplitudes, twice that for pointed crests)
+        float heightBound() const;
+
+        // whether draw takes the tessellation program (shaders/water_tess.vs, water.tcs, water.tes and water.fs) instead of the water.vs one
+        bool tessellated() const;
+
+        // texture of the height and normal of every vertex (texel (j, i) for vertex j of row i) in the heightfield mode (0 - other modes)
+        unsigned int heightfieldTexture() const { return heightfield ? surfaceTex : 0; }
+
+        // x, z of the first vertex of the mesh and the extent of the mesh along x, z
+        glm::vec2 gridOrigin() const { return glm::vec2(pX - pW / 2, pZ - pL / 2); }
+        glm::vec2 gridSize() const { return glm::vec2(pW, pL); }
+
+        // sum of waves of the water (not the ocean), and the water time it was last updated to
+        const WaveField& waveField() const { return field; }
+        float time() const { return internalTime; }
+
+        // the same waves in trochoidal form (drawn while their steepness is above 0), and the spectral ocean replacing them (NULL - none)
+        const Gerstner& gerstnerWaves() const { return gerstner; }
+        const Ocean* spectralOcean() const { return ocean; }
+
+        // whether the water updates with time (still water is only synthesized when its mode changes)
+        bool animates() const { return animated; }
+
+        // draw calls issued by the last call to draw
+        int drawCalls() const { return lastDrawCalls; }
 
         void draw(Shader* shader, unsigned int cubeTexture);
 
@@ -53,7 +225,40 @@ class Water {
 
     private:
         float internalTime;
-        unsigned int VAO, VBO, EBO;
+        unsigned int VAO, staticVBO, surfaceVBO, displacementVBO, EBO;
+
+        // heightfield mode: vertex array without attributes, and the textures the dynamic streams are uploaded to
+        unsigned int gridVAO, surfaceTex, displacementTex;
+
+        void setupBuffers();
+        void releaseBuffers();
+        void setupTextures();
+        void releaseTextures();
+
+        void refreshMesh();
+        void fillVertices();
+        void uploadVertices();
+        void dispatchCompute();
+        void setupWaveTable();
+        void rebuildWaves();
+        WaveCacheInfo loopInfo(int frames) const;
+        void evaluateFrame(float t, float* out);
+        void drawMesh(Shader* shader);
+        void drawPatches(Shader* shader);
+        void createStreams(size_t points, const vector<unsigned int>& indexList, unsigned int& vao, unsigned int& staticBuffer, unsigned int& surfaceBuffer, unsigned int& indexBuffer);
+        void uploadClipmap();
+        void drawClipmap();
+        void uploadProjected();
+        void drawProjected();
+        void fillRows(int first, int last);
+        void fillNormals(int first, int last);
+        void packRows(int first, int last);
+        void fillSpans(int first, int last);
+        bool culledSynthesis() const;
+        bool ringStreaming() const;
+        void uploadRange(size_t& first, size_t& count) const;
+        bool finiteNormals() const;
+        bool displaced() const;
         
         // px - x position of center of water in world
         // pz - z position of center of water in world
@@ -68,6 +273,83 @@ class Water {
         bool rounded;
         bool animated;
 
+        // how rows of the mesh are evaluated (see WaveEvalMode)
+        WaveEvalMode evalMode;
+
+        // how normals of the mesh are computed (see WaterNormalMode)
+        WaterNormalMode normalMode;
+
+        // how the strips of the mesh are submitted (see WaterDrawMode)
+        WaterDrawMode drawMode;
+        int lastDrawCalls;
+
+        // whether vertices come from the heightfield texture and gl_VertexID instead of vertex and index buffers
+        bool heightfield;
+
+        // whether the displacement stream went up with the last upload
+        bool displacing;
+
+        // whether the dynamic stream of the mesh is packed (WATER_PACKED_SHORTS per vertex) before it goes up, and the CPU copy it is packed into
+        // (unused while streaming)
+        bool packed;
+        vector<int16_t> packedSurface;
+
+        // compute shader that synthesizes the sum of waves straight into the heightfield texture (NULL - synthesized on the CPU)
+        Shader* compute;
+
+        // storage buffer of the wave table read by the compute shader and water.tes
+        unsigned int wavesSSBO;
+
+        // tessellated mode: patches along each side of the coarse grid (0 - off), the vertex array without attributes it is drawn from, and the
+        // level of detail policy of water.tcs
+        int tessPatches;
+        unsigned int patchVAO;
+        TessellationPolicy tessPolicy;
+
+        // index count and byte offset of every strip in the index buffer (for WATER_DRAW_ROWS and WATER_DRAW_MULTI)
+        vector<int> stripCounts;
+        vector<const void*> stripOffsets;
+
+        // culling: tiles of the mesh (their strips follow the strips of the rows in the index buffer, from tileIndexStart on), and the index count
+        // and byte offset of every tile kept by the last cull
+        bool cullingEnabled;
+        TileGrid tiles;
+        size_t tileIndexStart;
+        vector<int> tileCounts;
+        vector<const void*> tileOffsets;
+
+        // time slicing: budgeted updates of the tiles that matter most (off - every tile every update), the tiles the current update evaluates
+        // (kept by the cull, or picked by the scheduler) and the rows they span
+        bool slicingEnabled;
+        TileScheduler slicer;
+        const vector<unsigned char>* spanMask;
+        glm::ivec2 spanRows;
+        bool fullUpload;
+
+        // looping: seconds the waves were snapped to repeat over (0 - free waves), the frames of one period baked to a mapped file, the frame
+        // whose pair (it and the next one) the dynamic buffer holds (-1 - none) and how far the current time is towards the next one
+        float loopSeconds;
+        WaveCache cache;
+        int cacheFrame;
+        float cacheBlend;
+
+        // pool used to update the mesh a tile of rows at a time (NULL - single threaded)
+        ThreadPool* pool;
+
+        // spectral ocean that replaces the sum of waves when set (NULL - sum of waves)
+        Ocean* ocean;
+
+        // levels of the sum of waves centered on the viewer, drawn instead of the mesh when set (NULL - mesh), and their buffers
+        Clipmap* clipmap;
+        glm::vec3 viewer;
+        unsigned int clipVAO, clipStaticVBO, clipSurfaceVBO, clipEBO;
+
+        // grid of the screen unprojected onto the water plane through the camera, drawn instead of the mesh when set (NULL - mesh), the camera it
+        // is unprojected through and its buffers
+        ProjectedGrid* projgrid;
+        glm::mat4 viewMatrix, projectionMatrix;
+        unsigned int projVAO, projStaticVBO, projSurfaceVBO, projEBO;
+
         // wave information
         // wave: W(x, y, t) = Ai sin (Di dot (x, y) * wi + Si * wi * t)
         // surface: H(x, y, t) = sum of all waves i
@@ -75,11 +357,35 @@ class Water {
         vector<float> wi;       // frequency of wave
         vector<glm::vec2> Di;   // horizontal direction vector of wave
         vector<float> Si;       // phase-constant = S * 2/L = S * w
-};
+        vector<glm::vec2> Ci;   // center of circular waves
 
-// rougher seas. variations on intensity
-class Gerstner {
+        // batched copy of the wave information above, used to evaluate whole rows of the mesh at a time
+        WaveField field;
+
+        // trochoidal copy of the wave information above, used instead of the sum of sines when its steepness is above 0
+        Gerstner gerstner;
+
+        // spatial sin/cos of every wave at every vertex (only built for WAVE_BASIS)
+        WaveBasis basis;
+
+        // coordinates of the mesh (x is constant along a row of the mesh, z is shared by every row)
+        vector<float> rowX, rowZ;
+
+        // row major grid of heights of the mesh (only kept for finite difference normals)
+        vector<float> heights;
+
+        // persistently mapped ring the dynamic streams are written straight into when streaming (unready - plain buffers and glBufferSubData)
+        StreamBuffer ring;
+
+        // whether the last update wrote into a region of the ring that draw has not fenced yet
+        bool ringWritten;
+
+        // where the current update writes the dynamic streams (the CPU copies, or the region of the ring acquired for this frame)
+        float* surfaceOut;
+        float* displacementOut;
 
+        // where the current update packs the dynamic stream (NULL - not packed)
+        int16_t* packedOut;
 };
 
 #endif
\ No newline at end of file
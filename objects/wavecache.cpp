@@ -0,0 +1,258 @@
+/**
+ * @file wavecache.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Baked loop of a periodic sum of waves: one period of frames of the mesh, packed to 4 bytes a vertex (snorm16 height, snorm8 octahedral
+ *        normal), written to a file once and memory-mapped from then on, so playing the loop costs no evaluation at all
+ * @version 0.1
+ * @date 2022-06-27
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "wavecache.h"
+#include "simdmath.h"
+
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::vector;
+
+// a file: magic, version, then the info, then every frame
+struct WaveCacheHeader {
+    uint32_t magic, version;
+    WaveCacheInfo info;
+};
+
+/**
+ * @brief Snaps a wave to the loop: with every wave vector on the lattice of (2 pi / width, 2 pi / length) and every angular speed a multiple of
+ *        2 pi / period, the sum of waves repeats over the width x length of the mesh and over the period. Circular waves only repeat in time
+ *
+ * @param w Frequency (kept)
+ * @param Dx Returned x component of the direction
+ * @param Dy Returned y component of the direction
+ * @param S Returned speed
+ * @param width Extent of the mesh along x
+ * @param length Extent of the mesh along y
+ * @param period Seconds of the loop
+ * @param directional Whether the wave is directional (circular waves keep their direction)
+ */
+void snapToLoop(float w, float& Dx, float& Dy, float& S, float width, float length, float period, bool directional) {
+    const float tau = 2 * (float)M_PI;
+    if (w <= 0 || period <= 0)
+        return;
+
+    if (directional && width > 0 && length > 0) {
+        float kx = w * Dx, ky = w * Dy;
+        float m = roundf(kx * width / tau), n = roundf(ky * length / tau);
+
+        // a wave that would flatten out keeps one period along its main axis
+        if (m == 0 && n == 0) {
+            if (fabsf(kx) * width >= fabsf(ky) * length)
+                m = kx >= 0 ? 1 : -1;
+            else
+                n = ky >= 0 ? 1 : -1;
+        }
+        Dx = tau * m / width / w;
+        Dy = tau * n / length / w;
+    }
+
+    float cycles = fmaxf(1.0f, roundf(S * w * period / tau));
+    S = tau * cycles / period / w;
+}
+
+/**
+ * @brief Whether two caches hold the same frames (every field equal)
+ *
+ * @param other Info to compare with
+ * @return bool
+ */
+bool WaveCacheInfo::operator==(const WaveCacheInfo& other) const {
+    return rows == other.rows && columns == other.columns && frames == other.frames && period == other.period && bound == other.bound
+        && waves == other.waves;
+}
+
+/**
+ * @brief Construct a new, closed WaveCache object
+ */
+WaveCache::WaveCache() : mapping(NULL), mappedBytes(0) {
+    memset(&header, 0, sizeof(header));
+}
+
+/**
+ * @brief Destroy the WaveCache object, unmapping its file
+ */
+WaveCache::~WaveCache() {
+    close();
+}
+
+/**
+ * @brief Evaluates every frame of the loop, packs it to WAVECACHE_VERTEX_BYTES a vertex and writes it after the header. A file left incomplete
+ *        (write error) is removed, and open rejects any file shorter than its header says anyway
+ *
+ * @param path File to write
+ * @param info What the cache holds (frames are evaluated at f * period / frames)
+ * @param produce Fills the float dynamic stream of the mesh (height, then normal) at a time
+ * @return bool whether the whole file was written
+ */
+bool WaveCache::bake(const char* path, const WaveCacheInfo& info, const std::function<void(float t, float* surface)>& produce) {
+    if (info.rows <= 0 || info.columns <= 0 || info.frames <= 0 || info.period <= 0)
+        return false;
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    WaveCacheHeader head = { WAVECACHE_MAGIC, WAVECACHE_VERSION, info };
+    bool written = fwrite(&head, sizeof(head), 1, file) == 1;
+
+    size_t points = (size_t)info.rows * info.columns;
+    vector<float> surface(points * 4);
+    vector<int16_t> packed(points * 4);
+    vector<unsigned char> frame(points * WAVECACHE_VERTEX_BYTES);
+    float scale = info.bound > 0 ? SIMD_SNORM16_MAX / info.bound : 0;
+
+    for (int f = 0; f < info.frames && written; f ++) {
+        produce(f * info.period / info.frames, &surface[0]);
+        packSurfaceArray(&surface[0], &packed[0], (int)points, scale);
+
+        // the octahedral normal goes down to snorm8
+        for (size_t k = 0; k < points; k ++) {
+            int8_t normal[2] = { (int8_t)lrintf(packed[4 * k + 1] * 127.0f / SIMD_SNORM16_MAX), (int8_t)lrintf(packed[4 * k + 2] * 127.0f / SIMD_SNORM16_MAX) };
+            memcpy(&frame[k * WAVECACHE_VERTEX_BYTES], &packed[4 * k], sizeof(int16_t));
+            memcpy(&frame[k * WAVECACHE_VERTEX_BYTES + sizeof(int16_t)], normal, sizeof(normal));
+        }
+        written = fwrite(&frame[0], frame.size(), 1, file) == 1;
+    }
+
+    written = (fclose(file) == 0) && written;
+    if (!written)
+        remove(path);
+    return written;
+}
+
+/**
+ * @brief Maps the cache at path read only. Rejected (left closed) unless it is complete and holds exactly what info describes
+ *
+ * @param path File to map
+ * @param info What the cache must hold
+ * @return bool whether the file is mapped
+ */
+bool WaveCache::open(const char* path, const WaveCacheInfo& info) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(WaveCacheHeader)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // the view keeps the mapping (and the file) open once both handles are closed
+    HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (map)
+        CloseHandle(map);
+    CloseHandle(file);
+    if (!view)
+        return false;
+    size_t bytes = (size_t)size.QuadPart;
+#else
+    int file = ::open(path, O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < (off_t)sizeof(WaveCacheHeader)) {
+        ::close(file);
+        return false;
+    }
+
+    // the mapping outlives the descriptor
+    void* view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    ::close(file);
+    if (view == MAP_FAILED)
+        return false;
+    size_t bytes = (size_t)status.st_size;
+#endif
+
+    mapping = view;
+    mappedBytes = bytes;
+
+    WaveCacheHeader head;
+    memcpy(&head, mapping, sizeof(head));
+    header = head.info;
+    if (head.magic != WAVECACHE_MAGIC || head.version != WAVECACHE_VERSION || !(head.info == info)
+        || mappedBytes != sizeof(WaveCacheHeader) + (size_t)header.frames * frameBytes()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Unmaps the file (nothing if closed)
+ */
+void WaveCache::close() {
+    if (mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, mappedBytes);
+#endif
+    }
+    mapping = NULL;
+    mappedBytes = 0;
+    memset(&header, 0, sizeof(header));
+}
+
+/**
+ * @brief Frame f of the loop, wrapped around the period (pages are read from the file as the frame is first touched)
+ *
+ * @param f Frame
+ * @return const unsigned char* the frame in the mapping (NULL - closed)
+ */
+const unsigned char* WaveCache::frame(int f) const {
+    if (!mapping)
+        return NULL;
+    f %= header.frames;
+    if (f < 0)
+        f += header.frames;
+    return (const unsigned char*)mapping + sizeof(WaveCacheHeader) + (size_t)f * frameBytes();
+}
+
+/**
+ * @brief Frame at or before a time, wrapped around the period
+ *
+ * @param t Water time
+ * @param blend Returned position of t between that frame and the next ([0, 1))
+ * @return int frame
+ */
+int WaveCache::frameAt(float t, float& blend) const {
+    blend = 0;
+    if (!mapping)
+        return 0;
+
+    float phase = fmodf(t, header.period) / header.period * header.frames;
+    if (phase < 0)
+        phase += header.frames;
+    int f = (int)phase;
+    blend = phase - f;
+    if (f >= header.frames) {
+        f = 0;
+        blend = 0;
+    }
+    return f;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file wavecache.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Baked loop of a periodic sum of waves: one period of frames of the mesh, packed to 4 bytes a vertex (snorm16 height, snorm8 octahedral
+ *        normal), written to a file once and memory-mapped from then on, so playing the loop costs no evaluation at all
+ * @version 0.1
+ * @date 2022-06-27
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef WAVECACHE_H
+#define WAVECACHE_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+// default period of a looping sea (seconds of water time), and frames baked over it (the frames in between are blended by water.vs)
+#define WAVECACHE_PERIOD 30.0f
+#define WAVECACHE_FRAMES 120
+
+// bytes of every vertex of a frame: snorm16 height (over the height bound), then the octahedral normal as two snorm8
+#define WAVECACHE_VERTEX_BYTES 4
+
+// first bytes of a cache file, and the version of its layout
+#define WAVECACHE_MAGIC 0x43535745u
+#define WAVECACHE_VERSION 1u
+
+// what a cache holds; a file is only used if every field matches the water playing it
+struct WaveCacheInfo {
+    int32_t rows, columns;      // vertices of every frame (rows of the mesh, vertices along each row)
+    int32_t frames;             // frames over the period
+    float period;               // seconds of water time the loop lasts
+    float bound;                // height every snorm16 height is a fraction of
+    uint32_t waves;             // hash of the wave set, the family and the grid the frames were evaluated over
+
+    bool operator==(const WaveCacheInfo& other) const;
+};
+
+// snaps a wave (frequency w, direction (Dx, Dy), speed S) to repeat every period seconds, and (directional waves) every width along x and length
+// along y: the wave vector w * D moves to the nearest non-zero multiple of (2 pi / width, 2 pi / length), the angular speed S * w to the nearest
+// non-zero multiple of 2 pi / period. w is kept, D and S absorb the change
+void snapToLoop(float w, float& Dx, float& Dy, float& S, float width, float length, float period, bool directional);
+
+class WaveCache {
+    public:
+        WaveCache();
+        ~WaveCache();
+
+        // evaluates every frame of a loop (produce fills the float dynamic stream of the mesh, height then normal, at time t), packs it and
+        // writes it to path. Returns whether the whole file was written
+        static bool bake(const char* path, const WaveCacheInfo& info, const std::function<void(float t, float* surface)>& produce);
+
+        // maps the cache at path, if it holds exactly what info describes (and is complete). Returns whether it is mapped
+        bool open(const char* path, const WaveCacheInfo& info);
+        void close();
+        bool ready() const { return mapping != NULL; }
+
+        const WaveCacheInfo& info() const { return header; }
+        size_t frameBytes() const { return (size_t)header.rows * header.columns * WAVECACHE_VERTEX_BYTES; }
+
+        // frame f (wrapped around the period) in the mapping
+        const unsigned char* frame(int f) const;
+
+        // frame at or before time t and how far t is towards the next one ([0, 1))
+        int frameAt(float t, float& blend) const;
+
+    private:
+        WaveCacheInfo header;
+
+        // the whole file, mapped read only (NULL - closed)
+        void* mapping;
+        size_t mappedBytes;
+};
+
+#endif
@@ -0,0 +1,731 @@
+/**
+ * @file wavefield.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Batched evaluator for sums of sine waves. Stores the wave table as aligned structure-of-arrays and evaluates the height and both partials of the surface for whole rows (or tiles) of points in one call.
+ * @version 0.1
+ * @date 2022-06-14
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include "wavefield.h"
+#include "simdmath.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * @brief Construct a new empty AlignedFloats object
+ */
+AlignedFloats::AlignedFloats() : raw(NULL), ptr(NULL), count(0), capacity(0) {
+
+}
+
+/**
+ * @brief Construct a new AlignedFloats object holding a copy of another
+ *
+ * @param other Array to copy
+ */
+AlignedFloats::AlignedFloats(const AlignedFloats& other) : raw(NULL), ptr(NULL), count(0), capacity(0) {
+    *this = other;
+}
+
+/**
+ * @brief Replaces the contents of this array with a copy of another
+ *
+ * @param other Array to copy
+ * @return AlignedFloats& this array
+ */
+AlignedFloats& AlignedFloats::operator=(const AlignedFloats& other) {
+    if (this != &other) {
+        resize(other.count);
+        if (other.count > 0)
+            memcpy(ptr, other.ptr, other.count * sizeof(float));
+    }
+    return *this;
+}
+
+/**
+ * @brief Destroy the AlignedFloats object
+ */
+AlignedFloats::~AlignedFloats() {
+    free(raw);
+}
+
+/**
+ * @brief Grows the storage so that at least n floats fit. Existing contents are kept
+ *
+ * @param n Number of floats required
+ */
+void AlignedFloats::reserve(int n) {
+    if (n <= capacity)
+        return;
+
+    // round capacity up to a whole number of aligned blocks so vector loops may safely read past the end
+    int block = WAVEFIELD_ALIGN / sizeof(float);
+    int newCapacity = (n + block - 1) / block * block;
+
+    void* newRaw = malloc(newCapacity * sizeof(float) + WAVEFIELD_ALIGN);
+    float* newPtr = (float*)(((uintptr_t)newRaw + WAVEFIELD_ALIGN - 1) & ~(uintptr_t)(WAVEFIELD_ALIGN - 1));
+    memset(newPtr, 0, newCapacity * sizeof(float));
+    if (count > 0)
+        memcpy(newPtr, ptr, count * sizeof(float));
+
+    free(raw);
+    raw = newRaw;
+    ptr = newPtr;
+    capacity = newCapacity;
+}
+
+/**
+ * @brief Resizes the array to n floats. New entries are zeroed
+ *
+ * @param n New number of floats
+ */
+void AlignedFloats::resize(int n) {
+    reserve(n);
+    if (n > count)
+        memset(ptr + count, 0, (n - count) * sizeof(float));
+    count = n;
+}
+
+/**
+ * @brief Appends a float to the end of the array
+ *
+ * @param v Value to append
+ */
+void AlignedFloats::push_back(float v) {
+    if (count == capacity)
+        reserve(capacity == 0 ? WAVEFIELD_ALIGN / sizeof(float) : capacity * 2);
+    ptr[count ++] = v;
+}
+
+/**
+ * @brief Construct a new empty WaveField object (directional, rounded waves)
+ */
+WaveField::WaveField() : directional(true), rounded(true) {
+    selectKernels();
+}
+
+/**
+ * @brief Removes all waves from the field
+ */
+void WaveField::clear() {
+    A.clear(); w.clear(); Dx.clear(); Dy.clear();
+    Sw.clear(); Ax.clear(); Ay.clear();
+    Cx.clear(); Cy.clear();
+}
+
+/**
+ * @brief Adds a wave to the field. Follows W(x, y, t) = A sin (D dot (x, y) * w + S * w * t) for directional, rounded waves
+ *
+ * @param A Amplitude of the wave
+ * @param w Frequency of the wave
+ * @param Dx x component of the horizontal direction of the wave (directional waves)
+ * @param Dy y component of the horizontal direction of the wave (directional waves)
+ * @param S Phase-constant of the wave
+ * @param Cx x component of the center of the wave (circular waves)
+ * @param Cy y component of the center of the wave (circular waves)
+ */
+void WaveField::addWave(float A, float w, float Dx, float Dy, float S, float Cx, float Cy) {
+    this->A.push_back(A);
+    this->w.push_back(w);
+    this->Dx.push_back(Dx);
+    this->Dy.push_back(Dy);
+    this->Sw.push_back(S * w);
+    this->Ax.push_back(w * Dx * A);
+    this->Ay.push_back(w * Dy * A);
+    this->Cx.push_back(Cx);
+    this->Cy.push_back(Cy);
+}
+
+/**
+ * @brief Sets the family of every wave of the field, picking the evaluators specialized for it
+ *
+ * @param directional Whether waves are directional or circular (directional - true, circular - false)
+ * @param rounded Whether crests are rounded or pointed (rounded - true, pointed - false)
+ */
+void WaveField::setFamily(bool directional, bool rounded) {
+    this->directional = directional;
+    this->rounded = rounded;
+    selectKernels();
+}
+
+/**
+ * @brief Picks the evaluators of one family
+ */
+template <bool Directional, bool Rounded>
+void WaveField::selectKernels() {
+    waveKernel = &WaveField::waveKernelT<Directional, Rounded>;
+    pointKernel = &WaveField::pointKernelT<Directional, Rounded>;
+    pointsKernel = &WaveField::pointsKernelT<Directional, Rounded, false>;
+    rowKernel = &WaveField::pointsKernelT<Directional, Rounded, true>;
+}
+
+/**
+ * @brief Picks the evaluators specialized for the current family
+ */
+void WaveField::selectKernels() {
+    if (directional && rounded)
+        selectKernels<true, true>();
+    else if (directional)
+        selectKernels<true, false>();
+    else if (rounded)
+        selectKernels<false, true>();
+    else
+        selectKernels<false, false>();
+}
+
+/**
+ * @brief Returns b^(WAVEFIELD_SHARPNESS - 1), the factor shared by a pointed wave and its derivative
+ */
+static inline float sharpPower(float b) {
+    float p = 1;
+    for (int k = 1; k < WAVEFIELD_SHARPNESS; k ++)
+        p *= b;
+    return p;
+}
+
+/**
+ * @brief Phase of wave i at a point and its partials. Circular waves have a phase gradient of w times the unit vector away from their center
+ *        (0 at the center itself); directional waves have the constant gradient w * D
+ */
+#define WAVEFIELD_CIRCULAR_PHASE(i, px, py, phase, gx, gy) { \
+    float ddx = (px) - Cx[i], ddy = (py) - Cy[i]; \
+    float r = sqrtf(ddx * ddx + ddy * ddy); \
+    float inv = (r > 0) ? w[i] / r : 0; \
+    phase = r * w[i] + Sw[i] * t; \
+    gx = ddx * inv; gy = ddy * inv; \
+}
+
+/**
+ * @brief Evaluates a single wave and both of its partials at a single point
+ *
+ * @param i Wave to evaluate. Assumed to be within bounds
+ * @param x x coordinate of the point of evaluation
+ * @param y y coordinate of the point of evaluation
+ * @param t time elapsed
+ * @param h returned height of the wave
+ * @param dhdx returned partial of the wave in respect to x
+ * @param dhdy returned partial of the wave in respect to y
+ */
+template <bool Directional, bool Rounded>
+void WaveField::waveKernelT(int i, float x, float y, float t, float& h, float& dhdx, float& dhdy) const {
+    float phase, gx, gy;
+    if (Directional) {
+        phase = (Dx[i] * x + Dy[i] * y) * w[i] + Sw[i] * t;
+        gx = w[i] * Dx[i]; gy = w[i] * Dy[i];
+    } else {
+        WAVEFIELD_CIRCULAR_PHASE(i, x, y, phase, gx, gy);
+    }
+
+    float s, c;
+    sincosScalar(phase, s, c);
+
+    // dW/dtheta
+    float slope;
+    if (Rounded) {
+        h = A[i] * s;
+        slope = A[i] * c;
+    } else {
+        float b = (s + 1) * 0.5f;
+        float p = sharpPower(b);
+        h = 2 * A[i] * b * p;
+        slope = WAVEFIELD_SHARPNESS * A[i] * p * c;
+    }
+    dhdx = slope * gx;
+    dhdy = slope * gy;
+}
+
+/**
+ * @brief Evaluates the surface and both partials at a single point. The waves are vectorized instead of the points
+ *
+ * @param x x coordinate of the point of evaluation
+ * @param y y coordinate of the point of evaluation
+ * @param t time elapsed
+ * @param h returned height of the surface
+ * @param dhdx returned partial of the surface in respect to x
+ * @param dhdy returned partial of the surface in respect to y
+ */
+template <bool Directional, bool Rounded>
+void WaveField::pointKernelT(float x, float y, float t, float& h, float& dhdx, float& dhdy) const {
+    alignas(WAVEFIELD_ALIGN) float phase[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float gx[WAVEFIELD_CHUNK], gy[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float s[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float c[WAVEFIELD_CHUNK];
+
+    h = 0; dhdx = 0; dhdy = 0;
+
+    int waves = count();
+    for (int i0 = 0; i0 < waves; i0 += WAVEFIELD_CHUNK) {
+        int m = (waves - i0 < WAVEFIELD_CHUNK) ? waves - i0 : WAVEFIELD_CHUNK;
+
+        for (int i = 0; i < m; i ++) {
+            if (Directional)
+                phase[i] = (Dx[i0 + i] * x + Dy[i0 + i] * y) * w[i0 + i] + Sw[i0 + i] * t;
+            else
+                WAVEFIELD_CIRCULAR_PHASE(i0 + i, x, y, phase[i], gx[i], gy[i]);
+        }
+        sincosArray(phase, s, c, m);
+
+        // summed in wave order with the same expressions as the row evaluators, so both agree bit for bit
+        for (int i = 0; i < m; i ++) {
+            int k = i0 + i;
+            if (Directional && Rounded) {
+                h += A[k] * s[i];
+                dhdx += Ax[k] * c[i];
+                dhdy += Ay[k] * c[i];
+            } else if (Directional) {
+                float b = (s[i] + 1) * 0.5f;
+                float p = sharpPower(b);
+                h += 2 * A[k] * b * p;
+                dhdx += Ax[k] * WAVEFIELD_SHARPNESS * p * c[i];
+                dhdy += Ay[k] * WAVEFIELD_SHARPNESS * p * c[i];
+            } else {
+                float slope;
+                if (Rounded) {
+                    h += A[k] * s[i];
+                    slope = A[k] * c[i];
+                } else {
+                    float b = (s[i] + 1) * 0.5f;
+                    float p = sharpPower(b);
+                    h += 2 * A[k] * b * p;
+                    slope = A[k] * WAVEFIELD_SHARPNESS * p * c[i];
+                }
+                dhdx += slope * gx[i];
+                dhdy += slope * gy[i];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Evaluates the surface and both partials at n points, either arbitrary (Row false) or along a row sharing the x coordinate x[0] (Row true).
+ *        Points are processed in chunks small enough for the phases and their sin/cos to stay in cache; waves are the outer loop so the inner loops
+ *        stream over the points with the wave constants held in registers
+ *
+ * @param x Array of n x coordinates (Row false) or the single x coordinate of the row (Row true)
+ * @param y Array of n y coordinates
+ * @param n Number of points
+ * @param t time elapsed
+ * @param h Returned array of n heights
+ * @param dhdx Returned array of n partials in respect to x (NULL - heights only)
+ * @param dhdy Returned array of n partials in respect to y (NULL - heights only)
+ */
+template <bool Directional, bool Rounded, bool Row>
+void WaveField::pointsKernelT(const float* x, const float* y, int n, float t, float* h, float* dhdx, float* dhdy) const {
+    alignas(WAVEFIELD_ALIGN) float phase[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float gx[WAVEFIELD_CHUNK], gy[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float s[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float c[WAVEFIELD_CHUNK];
+
+    bool partials = (dhdx != NULL);
+
+    int waves = count();
+    for (int j0 = 0; j0 < n; j0 += WAVEFIELD_CHUNK) {
+        int m = (n - j0 < WAVEFIELD_CHUNK) ? n - j0 : WAVEFIELD_CHUNK;
+        float* ch = h + j0; float* cdx = NULL; float* cdy = NULL;
+        const float* cy = y + j0;
+
+        for (int j = 0; j < m; j ++) {
+            ch[j] = 0;
+        }
+        // the partials are only offset when there are any (NULL + j0 is undefined)
+        if (partials) {
+            cdx = dhdx + j0; cdy = dhdy + j0;
+            for (int j = 0; j < m; j ++) {
+                cdx[j] = 0; cdy[j] = 0;
+            }
+        }
+
+        for (int i = 0; i < waves; i ++) {
+            float f = w[i], st = Sw[i] * t;
+
+            if (Directional) {
+                float dx = Dx[i], dy = Dy[i];
+                if (Row) {
+                    float px = dx * x[0];
+                    for (int j = 0; j < m; j ++)
+                        phase[j] = (px + dy * cy[j]) * f + st;
+                } else {
+                    for (int j = 0; j < m; j ++)
+                        phase[j] = (dx * x[j0 + j] + dy * cy[j]) * f + st;
+                }
+            } else {
+                for (int j = 0; j < m; j ++)
+                    WAVEFIELD_CIRCULAR_PHASE(i, Row ? x[0] : x[j0 + j], cy[j], phase[j], gx[j], gy[j]);
+            }
+            sincosArray(phase, s, c, m);
+
+            if (!partials) {
+                if (Rounded) {
+                    float a = A[i];
+                    for (int j = 0; j < m; j ++)
+                        ch[j] += a * s[j];
+                } else {
+                    float a2 = 2 * A[i];
+                    for (int j = 0; j < m; j ++) {
+                        float b = (s[j] + 1) * 0.5f;
+                        ch[j] += a2 * b * sharpPower(b);
+                    }
+                }
+            } else if (Directional && Rounded) {
+                accumulate(i, s, c, m, ch, cdx, cdy);
+            } else if (Directional) {
+                float a2 = 2 * A[i], ax = Ax[i] * WAVEFIELD_SHARPNESS, ay = Ay[i] * WAVEFIELD_SHARPNESS;
+                for (int j = 0; j < m; j ++) {
+                    float b = (s[j] + 1) * 0.5f;
+                    float p = sharpPower(b);
+                    ch[j] += a2 * b * p;
+                    cdx[j] += ax * p * c[j];
+                    cdy[j] += ay * p * c[j];
+                }
+            } else if (Rounded) {
+                float a = A[i];
+                for (int j = 0; j < m; j ++) {
+                    ch[j] += a * s[j];
+                    cdx[j] += a * c[j] * gx[j];
+                    cdy[j] += a * c[j] * gy[j];
+                }
+            } else {
+                float a2 = 2 * A[i], ak = A[i] * WAVEFIELD_SHARPNESS;
+                for (int j = 0; j < m; j ++) {
+                    float b = (s[j] + 1) * 0.5f;
+                    float p = sharpPower(b);
+                    ch[j] += a2 * b * p;
+                    cdx[j] += ak * p * c[j] * gx[j];
+                    cdy[j] += ak * p * c[j] * gy[j];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Evaluates the surface and both partials along a row of n evenly spaced points that share an x coordinate. Along the row, the phase of
+ *        each wave grows by a constant step, so sin/cos are only evaluated once per wave at the start of every chunk; every other point is
+ *        rotated forward from an earlier point by the angle-addition identities
+ *            sin(a + b) = sin a cos b + cos a sin b
+ *            cos(a + b) = cos a cos b - sin a sin b
+ *        The first WAVEFIELD_LANES points of a chunk are rotated one step at a time, the rest WAVEFIELD_LANES steps at a time (independent
+ *        chains, so that loop vectorizes). Drift is bounded by reseeding from an exact sin/cos at the start of every chunk
+ *
+ * @param x x coordinate of the row
+ * @param y0 y coordinate of the first point
+ * @param dy Spacing between consecutive points
+ * @param n Number of points
+ * @param t time elapsed
+ * @param h Returned array of n heights
+ * @param dhdx Returned array of n partials in respect to x (NULL - heights only)
+ * @param dhdy Returned array of n partials in respect to y (NULL - heights only)
+ */
+void WaveField::evaluateRowRecurrence(float x, float y0, float dy, int n, float t, float* h, float* dhdx, float* dhdy) const {
+    alignas(WAVEFIELD_ALIGN) float s[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float c[WAVEFIELD_CHUNK];
+
+    // per wave constants of the current block of waves
+    alignas(WAVEFIELD_ALIGN) float arg[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float stepS[WAVEFIELD_CHUNK], stepC[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float laneS[WAVEFIELD_CHUNK], laneC[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float seedS[WAVEFIELD_CHUNK], seedC[WAVEFIELD_CHUNK];
+
+    bool partials = (dhdx != NULL);
+    for (int j = 0; j < n; j ++) {
+        h[j] = 0;
+        if (partials) {
+            dhdx[j] = 0; dhdy[j] = 0;
+        }
+    }
+
+    int waves = count();
+    for (int i0 = 0; i0 < waves; i0 += WAVEFIELD_CHUNK) {
+        int bw = (waves - i0 < WAVEFIELD_CHUNK) ? waves - i0 : WAVEFIELD_CHUNK;
+
+        // rotations by one point and by WAVEFIELD_LANES points
+        for (int b = 0; b < bw; b ++) {
+            arg[b] = Dy[i0 + b] * dy * w[i0 + b];
+        }
+        sincosArray(arg, stepS, stepC, bw);
+        for (int b = 0; b < bw; b ++) {
+            arg[b] *= WAVEFIELD_LANES;
+        }
+        sincosArray(arg, laneS, laneC, bw);
+
+        for (int j0 = 0; j0 < n; j0 += WAVEFIELD_CHUNK) {
+            int m = (n - j0 < WAVEFIELD_CHUNK) ? n - j0 : WAVEFIELD_CHUNK;
+            int seeds = (m < WAVEFIELD_LANES) ? m : WAVEFIELD_LANES;
+
+            // exact phase of every wave at the first point of the chunk
+            float y = y0 + (float)j0 * dy;
+            for (int b = 0; b < bw; b ++) {
+                int i = i0 + b;
+                arg[b] = (Dx[i] * x + Dy[i] * y) * w[i] + Sw[i] * t;
+            }
+            sincosArray(arg, seedS, seedC, bw);
+
+            for (int b = 0; b < bw; b ++) {
+                float sS = stepS[b], cS = stepC[b];
+                float sL = laneS[b], cL = laneC[b];
+
+                // seed the chains one step at a time
+                s[0] = seedS[b]; c[0] = seedC[b];
+                for (int j = 1; j < seeds; j ++) {
+                    s[j] = s[j - 1] * cS + c[j - 1] * sS;
+                    c[j] = c[j - 1] * cS - s[j - 1] * sS;
+                }
+
+                // rotate every chain forward by WAVEFIELD_LANES points at a time, accumulating as we go
+                float a = A[i0 + b], ax = Ax[i0 + b], ay = Ay[i0 + b];
+                float* ch = h + j0;
+                if (partials) {
+                    // the partials are only offset when there are any (NULL + j0 is undefined)
+                    float* cdx = dhdx + j0; float* cdy = dhdy + j0;
+                    accumulate(i0 + b, s, c, seeds, ch, cdx, cdy);
+
+                    for (int j = WAVEFIELD_LANES; j < m; j ++) {
+                        float sj = s[j - WAVEFIELD_LANES] * cL + c[j - WAVEFIELD_LANES] * sL;
+                        float cj = c[j - WAVEFIELD_LANES] * cL - s[j - WAVEFIELD_LANES] * sL;
+                        s[j] = sj; c[j] = cj;
+                        ch[j] += a * sj;
+                        cdx[j] += ax * cj;
+                        cdy[j] += ay * cj;
+                    }
+                } else {
+                    for (int j = 0; j < seeds; j ++)
+                        ch[j] += a * s[j];
+
+                    for (int j = WAVEFIELD_LANES; j < m; j ++) {
+                        float sj = s[j - WAVEFIELD_LANES] * cL + c[j - WAVEFIELD_LANES] * sL;
+                        float cj = c[j - WAVEFIELD_LANES] * cL - s[j - WAVEFIELD_LANES] * sL;
+                        s[j] = sj; c[j] = cj;
+                        ch[j] += a * sj;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds wave i to m points given the sin and cos of its phase at each point
+ *
+ * @param i Index of the wave
+ * @param s Array of m sines of the phase
+ * @param c Array of m cosines of the phase
+ * @param m Number of points
+ * @param h Array of m heights to add to
+ * @param dhdx Array of m partials in respect to x to add to
+ * @param dhdy Array of m partials in respect to y to add to
+ */
+void WaveField::accumulate(int i, const float* s, const float* c, int m, float* h, float* dhdx, float* dhdy) const {
+    float a = A[i], ax = Ax[i], ay = Ay[i];
+    for (int j = 0; j < m; j ++) {
+        h[j] += a * s[j];
+        dhdx[j] += ax * c[j];
+        dhdy[j] += ay * c[j];
+    }
+}
+
+/**
+ * @brief Evaluates the surface and both partials over a tile of nx rows by ny points
+ *
+ * @param x Array of nx row x coordinates
+ * @param nx Number of rows
+ * @param y Array of ny y coordinates (shared by every row)
+ * @param ny Number of points per row
+ * @param t time elapsed
+ * @param h Returned array of nx * ny heights
+ * @param dhdx Returned array of nx * ny partials in respect to x
+ * @param dhdy Returned array of nx * ny partials in respect to y
+ */
+void WaveField::evaluateTile(const float* x, int nx, const float* y, int ny, float t, float* h, float* dhdx, float* dhdy) const {
+    for (int i = 0; i < nx; i ++) {
+        evaluateRow(x[i], y, ny, t, h + i * ny, dhdx + i * ny, dhdy + i * ny);
+    }
+}
+
+/**
+ * @brief Construct a new empty WaveBasis object
+ */
+WaveBasis::WaveBasis() : nx(0), ny(0), waves(0), pitch(0) {
+
+}
+
+/**
+ * @brief Releases the cached basis
+ */
+void WaveBasis::clear() {
+    nx = 0; ny = 0; waves = 0; pitch = 0;
+    basis.resize(0);
+}
+
+/**
+ * @brief Returns the size of the cached basis in bytes
+ *
+ * @return size_t
+ */
+size_t WaveBasis::bytes() const {
+    return (size_t)nx * 2 * waves * pitch * sizeof(float);
+}
+
+/**
+ * @brief Computes and caches the sin/cos of the spatial phase of every wave at every point of a grid
+ *
+ * @param field Waves to cache
+ * @param x Array of nx row x coordinates
+ * @param nx Number of rows
+ * @param y Array of ny y coordinates (shared by every row)
+ * @param ny Number of points per row
+ */
+void WaveBasis::build(const WaveField& field, const float* x, int nx, const float* y, int ny) {
+    alignas(WAVEFIELD_ALIGN) float phase[WAVEFIELD_CHUNK];
+
+    clear();
+    int block = WAVEFIELD_ALIGN / sizeof(float);
+    this->nx = nx;
+    this->ny = ny;
+    this->waves = field.count();
+    this->pitch = (ny + block - 1) / block * block;
+
+    size_t rowPitch = (size_t)2 * waves * pitch;
+    basis.resize(nx * rowPitch);
+
+    for (int i = 0; i < nx; i ++) {
+        for (int k = 0; k < waves; k ++) {
+            float px = field.Dx[k] * x[i];
+            size_t sinCol = i * rowPitch + (size_t)k * pitch;
+            size_t cosCol = i * rowPitch + (size_t)(waves + k) * pitch;
+
+            for (int j0 = 0; j0 < ny; j0 += WAVEFIELD_CHUNK) {
+                int m = (ny - j0 < WAVEFIELD_CHUNK) ? ny - j0 : WAVEFIELD_CHUNK;
+                for (int j = 0; j < m; j ++) {
+                    phase[j] = (px + field.Dy[k] * y[j0 + j]) * field.w[k];
+                }
+                sincosArray(phase, &basis[sinCol + j0], &basis[cosCol + j0], m);
+            }
+        }
+    }
+
+    coefH.resize(2 * waves);
+    coefDx.resize(2 * waves);
+    coefDy.resize(2 * waves);
+}
+
+/**
+ * @brief Computes the coefficients of every basis column for a frame
+ *        H     = sum of sin (spatial) *  A cos (temporal) + cos (spatial) *  A sin (temporal)
+ *        dH/dx = sum of sin (spatial) * -Ax sin (temporal) + cos (spatial) * Ax cos (temporal)   (Ax = w * Dx * A, same for y)
+ *
+ * @param field Waves the basis was built from
+ * @param t time elapsed
+ */
+void WaveBasis::setTime(const WaveField& field, float t) {
+    alignas(WAVEFIELD_ALIGN) float temporal[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float s[WAVEFIELD_CHUNK];
+    alignas(WAVEFIELD_ALIGN) float c[WAVEFIELD_CHUNK];
+
+    for (int k0 = 0; k0 < waves; k0 += WAVEFIELD_CHUNK) {
+        int m = (waves - k0 < WAVEFIELD_CHUNK) ? waves - k0 : WAVEFIELD_CHUNK;
+        for (int k = 0; k < m; k ++) {
+            temporal[k] = field.Sw[k0 + k] * t;
+        }
+        sincosArray(temporal, s, c, m);
+
+        for (int k = 0; k < m; k ++) {
+            int i = k0 + k;
+            coefH[i] = field.A[i] * c[k];
+            coefH[waves + i] = field.A[i] * s[k];
+            coefDx[i] = 0 - field.Ax[i] * s[k];
+            coefDx[waves + i] = field.Ax[i] * c[k];
+            coefDy[i] = 0 - field.Ay[i] * s[k];
+            coefDy[waves + i] = field.Ay[i] * c[k];
+        }
+    }
+}
+
+/**
+ * @brief Evaluates the surface and both partials along row i of the grid at the time given to setTime
+ *
+ * @param i Index of the row
+ * @param h Returned array of ny heights
+ * @param dhdx Returned array of ny partials in respect to x (NULL - heights only)
+ * @param dhdy Returned array of ny partials in respect to y (NULL - heights only)
+ */
+void WaveBasis::evaluateRow(int i, float* h, float* dhdx, float* dhdy) const {
+    for (int j = 0; j < ny; j ++) {
+        h[j] = 0;
+    }
+
+    size_t rowPitch = (size_t)2 * waves * pitch;
+
+    // heights only: a single matrix-vector product
+    if (!dhdx) {
+        for (int k = 0; k < 2 * waves; k ++) {
+            float ch = coefH[k];
+            const float* column = &basis[i * rowPitch + (size_t)k * pitch];
+            for (int j = 0; j < ny; j ++)
+                h[j] += column[j] * ch;
+        }
+        return;
+    }
+
+    for (int j = 0; j < ny; j ++) {
+        dhdx[j] = 0; dhdy[j] = 0;
+    }
+
+    for (int k = 0; k < 2 * waves; k ++) {
+        float ch = coefH[k], cdx = coefDx[k], cdy = coefDy[k];
+        const float* column = &basis[i * rowPitch + (size_t)k * pitch];
+        for (int j = 0; j < ny; j ++) {
+            h[j] += column[j] * ch;
+            dhdx[j] += column[j] * cdx;
+            dhdy[j] += column[j] * cdy;
+        }
+    }
+}
+
+/**
+ * @brief Partials of a regular grid of heights by central differences (one-sided on the border of the grid), for rows [first, last). Every
+ *        output only depends on the heights, so rows can be split between threads once the whole grid of heights is known. Each point costs
+ *        the same however many waves made the heights
+ *
+ * @param h Row major nx x ny grid of heights
+ * @param nx Number of rows (x direction)
+ * @param ny Number of points per row (y direction)
+ * @param dx Spacing of the rows
+ * @param dy Spacing of the points along a row
+ * @param first First row to differentiate
+ * @param last One past the last row to differentiate
+ * @param dhdx Returned (last - first) x ny partials in respect to x
+ * @param dhdy Returned (last - first) x ny partials in respect to y
+ */
+void gridSlopes(const float* h, int nx, int ny, float dx, float dy, int first, int last, float* dhdx, float* dhdy) {
+    float invDx = 1 / dx, invDy = 1 / dy;
+
+    for (int i = first; i < last; i ++) {
+        const float* row = h + (size_t)i * ny;
+        float* rx = dhdx + (size_t)(i - first) * ny;
+        float* ry = dhdy + (size_t)(i - first) * ny;
+
+        // across rows
+        const float* prev = (i > 0) ? row - ny : row;
+        const float* next = (i < nx - 1) ? row + ny : row;
+        float sx = (i > 0 && i < nx - 1) ? invDx * 0.5f : invDx;
+        if (nx == 1)
+            sx = 0;
+        for (int j = 0; j < ny; j ++)
+            rx[j] = (next[j] - prev[j]) * sx;
+
+        // along the row
+        if (ny == 1) {
+            ry[0] = 0;
+            continue;
+        }
+        ry[0] = (row[1] - row[0]) * invDy;
+        for (int j = 1; j < ny - 1; j ++)
+            ry[j] = (row[j + 1] - row[j - 1]) * (invDy * 0.5f);
+        ry[ny - 1] = (row[ny - 1] - row[ny - 2]) * invDy;
+    }
+}
@@ -0,0 +1,181 @@
+/**
+ * @file wavefield.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Batched evaluator for sums of sine waves. Stores the wave table as aligned structure-of-arrays and evaluates the height and both partials of the surface for whole rows (or tiles) of points in one call.
+ * @version 0.1
+ * @date 2022-06-14
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef WAVEFIELD_H
+#define WAVEFIELD_H
+
+#include <vector>
+using std::vector;
+
+#include <stddef.h>
+
+// alignment (in bytes) of every array in the wave table; wide enough for 512 bit loads
+#define WAVEFIELD_ALIGN 64
+
+// number of points (or waves) whose phases are batched into a single sincos call
+#define WAVEFIELD_CHUNK 256
+
+// number of interleaved rotation chains in the recurrence evaluator (points seeded with sin/cos at the start of each chunk)
+#define WAVEFIELD_LANES 8
+
+// exponent k of pointed waves, 2 A ((sin (theta) + 1) / 2)^k (an integer, so the power unrolls into multiplications)
+#define WAVEFIELD_SHARPNESS 2
+
+// ways of evaluating a regular row of points
+enum WaveEvalMode {
+    WAVE_DIRECT=0,      // sin/cos of every phase
+    WAVE_RECURRENCE=1,  // sin/cos of a few seed phases per chunk, the rest advanced by angle-addition rotations
+    WAVE_BASIS=2        // cached per point spatial sin/cos (WaveBasis), one matrix-vector product per frame (slower than WAVE_DIRECT, see WaveBasis)
+};
+
+/**
+ * @brief Growable array of floats whose storage is aligned to WAVEFIELD_ALIGN bytes
+ */
+class AlignedFloats {
+    public:
+        AlignedFloats();
+        AlignedFloats(const AlignedFloats& other);
+        AlignedFloats& operator=(const AlignedFloats& other);
+        ~AlignedFloats();
+
+        void resize(int n);
+        void push_back(float v);
+        void clear() { count = 0; }
+
+        int size() const { return count; }
+        float* data() { return ptr; }
+        const float* data() const { return ptr; }
+
+        float& operator[](int i) { return ptr[i]; }
+        const float& operator[](int i) const { return ptr[i]; }
+
+    private:
+        void reserve(int n);
+
+        void* raw;  // pointer returned by malloc (freed on destruction)
+        float* ptr; // aligned pointer into raw
+        int count, capacity;
+};
+
+/**
+ * @brief Sum of sine waves, of one of four families (GG1-C1): directional or circular (every wave radiating from its own center), rounded or pointed crests.
+ *        For a set of waves i, the surface follows
+ *        H(x, y, t) = sum of Wi(theta i),  theta i = Di dot (x, y) * wi + Si * wi * t  (directional) or |(x, y) - Ci| * wi + Si * wi * t  (circular)
+ *        Wi = Ai sin (theta i)  (rounded) or 2 Ai ((sin (theta i) + 1) / 2)^k  (pointed)
+ *        and each call evaluates H, dH/dx and dH/dy together so that the phase of each wave is only computed once per point.
+ *        The sin/cos of the phases are computed in batches through sincosArray (simdmath.h). Every evaluator is a template specialized on the family,
+ *        picked whenever the family changes instead of branched on per point
+ */
+class WaveField {
+    public:
+        WaveField();
+
+        void clear();
+        void addWave(float A, float w, float Dx, float Dy, float S, float Cx = 0, float Cy = 0);
+        int count() const { return A.size(); }
+
+        // family of every wave (directional/rounded by default)
+        void setFamily(bool directional, bool rounded);
+        bool isDirectional() const { return directional; }
+        bool isRounded() const { return rounded; }
+
+        // single wave i at a single point
+        void evaluateWave(int i, float x, float y, float t, float& h, float& dhdx, float& dhdy) const { (this->*waveKernel)(i, x, y, t, h, dhdx, dhdy); }
+
+        // (the evaluators of many points take NULL partials to only return heights)
+
+        // single point
+        void evaluatePoint(float x, float y, float t, float& h, float& dhdx, float& dhdy) const { (this->*pointKernel)(x, y, t, h, dhdx, dhdy); }
+
+        // arbitrary set of n points
+        void evaluate(const float* x, const float* y, int n, float t, float* h, float* dhdx, float* dhdy) const { (this->*pointsKernel)(x, y, n, t, h, dhdx, dhdy); }
+
+        // row of n points sharing the same x coordinate
+        void evaluateRow(float x, const float* y, int n, float t, float* h, float* dhdx, float* dhdy) const { (this->*rowKernel)(&x, y, n, t, h, dhdx, dhdy); }
+
+        // row of n evenly spaced points (y0, y0 + dy, ...) sharing the same x coordinate, advanced with angle-addition recurrences (directional, rounded waves only)
+        void evaluateRowRecurrence(float x, float y0, float dy, int n, float t, float* h, float* dhdx, float* dhdy) const;
+
+        // tile of nx rows by ny points, outputs are row major with ny floats per row
+        void evaluateTile(const float* x, int nx, const float* y, int ny, float t, float* h, float* dhdx, float* dhdy) const;
+
+    private:
+        friend class WaveBasis;
+
+        typedef void (WaveField::*WaveKernel)(int, float, float, float, float&, float&, float&) const;
+        typedef void (WaveField::*PointKernel)(float, float, float, float&, float&, float&) const;
+        typedef void (WaveField::*PointsKernel)(const float*, const float*, int, float, float*, float*, float*) const;
+
+        template <bool Directional, bool Rounded> void waveKernelT(int i, float x, float y, float t, float& h, float& dhdx, float& dhdy) const;
+        template <bool Directional, bool Rounded> void pointKernelT(float x, float y, float t, float& h, float& dhdx, float& dhdy) const;
+        template <bool Directional, bool Rounded, bool Row> void pointsKernelT(const float* x, const float* y, int n, float t, float* h, float* dhdx, float* dhdy) const;
+        template <bool Directional, bool Rounded> void selectKernels();
+        void selectKernels();
+
+        void accumulate(int i, const float* s, const float* c, int m, float* h, float* dhdx, float* dhdy) const;
+
+        bool directional, rounded;
+
+        // evaluators specialized for the current family
+        WaveKernel waveKernel;
+        PointKernel pointKernel;
+        PointsKernel pointsKernel, rowKernel;
+
+        // wave table (one entry per wave)
+        AlignedFloats A;    // amplitude
+        AlignedFloats w;    // frequency
+        AlignedFloats Dx;   // x component of direction
+        AlignedFloats Dy;   // y component of direction
+        AlignedFloats Sw;   // phase-constant times frequency (S * w)
+        AlignedFloats Ax;   // amplitude of dH/dx (w * Dx * A)
+        AlignedFloats Ay;   // amplitude of dH/dy (w * Dy * A)
+        AlignedFloats Cx;   // x component of the center of circular waves
+        AlignedFloats Cy;   // y component of the center of circular waves
+};
+
+/**
+ * @brief Spatial basis of a WaveField (of directional, rounded waves) cached over a fixed grid. Every wave follows
+ *        A sin (spatial(x, y) + S * w * t) = A (sin (spatial) cos (S * w * t) + cos (spatial) sin (S * w * t))
+ *        so the sin/cos of the spatial phase of every wave at every grid point is computed once, after which each frame of H and both partials
+ *        is a (fused, triple) dense matrix-vector product of that basis against 2 * waves time dependent coefficients.
+ *        This is slower than WAVE_DIRECT rows: the product streams 2 * waves floats per point from memory (39 MB for the default 500 x 500 grid
+ *        and 20 waves), which costs as much as the batched sincos it saves (0.99x per frame), and building the basis adds about 28 ms
+ */
+class WaveBasis {
+    public:
+        WaveBasis();
+
+        void build(const WaveField& field, const float* x, int nx, const float* y, int ny);
+        void clear();
+
+        bool built() const { return nx > 0; }
+        size_t bytes() const;
+
+        // computes the coefficients of a frame (call once per frame, before any evaluateRow)
+        void setTime(const WaveField& field, float t);
+
+        // H and both partials of row i of the grid at the time given to setTime
+        void evaluateRow(int i, float* h, float* dhdx, float* dhdy) const;
+
+    private:
+        int nx, ny, waves;
+        int pitch;      // floats between consecutive basis columns (ny rounded up to whole aligned blocks)
+
+        // per row: waves columns of sin (spatial) followed by waves columns of cos (spatial), pitch floats each
+        AlignedFloats basis;
+
+        // coefficients of the current frame, one per basis column
+        AlignedFloats coefH, coefDx, coefDy;
+};
+
+// partials of rows [first, last) of a regular nx x ny grid of heights by central differences
+void gridSlopes(const float* h, int nx, int ny, float dx, float dy, int first, int last, float* dhdx, float* dhdy);
+
+#endif
@@ -0,0 +1,22 @@
+#version 430 core
+out vec4 FragColor;
+
+in vec2 Before;
+in vec2 After;
+
+uniform bool photons;
+uniform float photonEnergy;     // texels of the map over photons: what a photon adds under still water
+
+void main() {
+    if (photons) {
+        FragColor = vec4(photonEnergy, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // area of the triangle under still water over its area through the water (both as covered by this texel), added up over every triangle
+    vec2 bx = dFdx(Before), by = dFdy(Before);
+    vec2 ax = dFdx(After), ay = dFdy(After);
+    float before = abs(bx.x * by.y - bx.y * by.x);
+    float after = abs(ax.x * ay.y - ax.y * ay.x);
+    FragColor = vec4(before / max(after, before * 1e-3), 0.0, 0.0, 1.0);
+}
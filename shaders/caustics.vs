@@ -0,0 +1,57 @@
+#version 430 core
+// ray (gl_VertexID >> 1, gl_InstanceID + (gl_VertexID & 1)) of a grid x grid lattice over the water, generated without vertex attributes: one
+// instance per strip between two rows of rays. Rays are numbered like vertices (j along z, row i along x). In photon mode, ray (gl_VertexID,
+// gl_InstanceID) of a grid x grid lattice of photons drawn as points, each at the center of its cell
+
+out vec2 Before;    // where the ray lands at the focus depth under still water
+out vec2 After;     // where it lands through the water
+
+uniform sampler2D surfaceMap;   // normals of the water, texel (j, i) for vertex j of row i
+uniform bool heightfield;       // surfaceMap holds height, then normal (RGBA float) instead of the RGB normal map
+uniform vec2 gridOrigin;        // x, z of the first vertex of the water
+uniform vec2 gridSize;          // extent of the water along x, z
+uniform int grid;
+uniform bool photons;
+
+uniform float level;            // height of still water
+uniform float depth;            // depth the light is focused at
+uniform vec3 light;             // unit direction towards the sun
+uniform vec3 refracted;         // sunlight under still water
+uniform float eta;              // refractive index of air over water
+uniform mat4 lightSpace;        // world to map coordinates
+
+void main() {
+    vec2 f;
+    if (photons) {
+        f = (vec2(gl_VertexID, gl_InstanceID) + 0.5) / float(grid);
+    } else {
+        ivec2 ray = ivec2(gl_VertexID >> 1, gl_InstanceID + (gl_VertexID & 1));
+        f = vec2(ray) / float(grid - 1);
+    }
+
+    // the texel of the nearest vertex of the water
+    vec2 texels = vec2(textureSize(surfaceMap, 0));
+    vec2 uv = (f * (texels - 1.0) + 0.5) / texels;
+    vec3 normal;
+    float height = 0.0;
+    if (heightfield) {
+        vec4 surface = texture(surfaceMap, uv);
+        height = surface.x;
+        normal = vec3(surface.y, surface.w, surface.z);
+    } else {
+        // bytes of (n / 2 + 0.5) * 255 for n = -dH/dx, -dH/dz
+        vec2 slope = texture(surfaceMap, uv).xy * 2.0 - 1.0;
+        normal = vec3(slope.x, 1.0, slope.y);
+    }
+
+    vec3 entry = vec3(gridOrigin.x + f.y * gridSize.x, level, gridOrigin.y + f.x * gridSize.y);
+    vec3 still = entry + refracted * (depth / -refracted.y);
+
+    vec3 bent = refract(-light, normalize(normal), eta);
+    vec3 start = entry + vec3(0, height, 0);
+    vec3 landed = start + bent * ((start.y - (level - depth)) / max(-bent.y, 1e-3));
+
+    Before = still.xz;
+    After = landed.xz;
+    gl_Position = vec4((lightSpace * vec4(landed, 1.0)).xy * 2.0 - 1.0, 0.0, 1.0);
+}
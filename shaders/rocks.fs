@@ -5,17 +5,38 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 Position;
 in vec3 CPosition;
+in vec2 CausticCoords;
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D normal;
 uniform sampler2D refractions;
 
+// normal holds the heightfield texture of the water (height, then normal, of vertex j of row i at texel (j, i)) instead of a normal map
+uniform bool surfaceHeightfield;
+uniform vec2 surfaceOrigin;     // x, z of the first vertex of the water
+uniform vec2 surfaceSize;       // extent of the water along x, z
+
+// light through the water comes from the caustic map (rendered in light space once per frame) instead of a ray refracted per fragment
+uniform bool causticMapped;
+uniform sampler2D causticMap;   // 1 - as much light as through still water
+
 void main() {
     // directional light
     vec3 lightDir = vec3(1, 5, 1);
     float diff = dot(lightDir, Normal);
-    vec4 p0 = texture(normal, Position.xz/25 + vec2(25, 25));
-    vec2 tp = refract(vec3(0, 1, 0), normalize(p0.xyz), 1.33).xy;
+    if (causticMapped) {
+        FragColor = texture(texture_diffuse1, TexCoords) * 0.5 * texture(causticMap, CausticCoords).r;
+        return;
+    }
+    vec3 n;
+    if (surfaceHeightfield) {
+        // texel rows run along x, texel columns along z
+        vec2 uv = (Position.zx - surfaceOrigin.yx) / surfaceSize.yx + 0.5 / vec2(textureSize(normal, 0));
+        n = texture(normal, uv).yzw;
+    } else {
+        n = texture(normal, Position.xz/25 + vec2(25, 25)).xyz;
+    }
+    vec2 tp = refract(vec3(0, 1, 0), normalize(n), 1.33).xy;
     vec4 p1 = texture(refractions, tp);
     //if (p1.x < 0.1) {
     //    p1 = vec4(1, 1, 1, 1);
@@ -7,16 +7,19 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 Position;
 out vec3 CPosition;
+out vec2 CausticCoords;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 cameraPos;
+uniform mat4 causticSpace;    // world to caustic map coordinates
 
 void main() {
     TexCoords = aTexCoords;
     Normal = aNormal;
     CPosition = cameraPos;
     Position = aPos;
+    CausticCoords = (causticSpace * model * vec4(aPos, 1.0)).xy;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#version 430 core
+layout (local_size_x = 16, local_size_y = 16) in;
+
+// height, then normal, of vertex j of row i at texel (j, i) (the heightfield texture drawn by water.vs and sampled by rocks.fs)
+layout (rgba32f, binding = 0) uniform writeonly image2D surfaceImage;
+
+// two vec4 per wave: (A, w, Dx, Dy), (S * w, Cx, Cy, 0)
+layout (std430, binding = 0) readonly buffer Waves {
+    vec4 waves[];
+};
+
+uniform int waveCount;
+uniform bool directional;
+uniform bool rounded;
+uniform int sharpness;      // exponent k of pointed waves
+uniform float time;
+uniform vec2 gridOrigin;    // x, z of the first vertex
+uniform vec2 gridSpacing;   // distance between rows (x) and between the vertices of a row (z)
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, imageSize(surfaceImage))))
+        return;
+
+    vec2 p = vec2(gridOrigin.x + texel.y * gridSpacing.x, gridOrigin.y + texel.x * gridSpacing.y);
+
+    // H and its partials, summed over every wave (same formulas as WaveField)
+    float h = 0;
+    vec2 dh = vec2(0);
+    for (int i = 0; i < waveCount; i ++) {
+        vec4 a = waves[2 * i];
+        vec4 b = waves[2 * i + 1];
+
+        float phase;
+        vec2 g;
+        if (directional) {
+            phase = dot(a.zw, p) * a.y + b.x * time;
+            g = a.y * a.zw;
+        } else {
+            vec2 d = p - b.yz;
+            float r = length(d);
+            phase = r * a.y + b.x * time;
+            g = (r > 0) ? d * (a.y / r) : vec2(0);
+        }
+
+        float s = sin(phase), c = cos(phase);
+
+        // dW/dtheta
+        float slope;
+        if (rounded) {
+            h += a.x * s;
+            slope = a.x * c;
+        } else {
+            // W = 2 A ((sin + 1) / 2)^k
+            float base = (s + 1) * 0.5;
+            float power = 1;
+            for (int k = 1; k < sharpness; k ++)
+                power *= base;
+            h += 2 * a.x * base * power;
+            slope = sharpness * a.x * power * c;
+        }
+        dh += slope * g;
+    }
+
+    // N = <-dH/dx, -dH/dz, 1>
+    imageStore(surfaceImage, texel, vec4(h, -dh.x, -dh.y, 1));
+}
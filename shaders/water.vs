@@ -1,6 +1,10 @@
 #version 430 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec2 aPlane;         // static x, z
+layout (location = 1) in vec3 aNormal;        // octahedral normal in xy when packed
+layout (location = 2) in float aHeight;       // fraction of heightBound when packed
+layout (location = 3) in vec2 aDisplacement;  // horizontal displacement (constant 0 for still x, z)
+layout (location = 4) in vec2 aNextNormal;    // baked loop: octahedral normal of the next frame
+layout (location = 5) in float aNextHeight;   // baked loop: height of the next frame (fraction of heightBound)
 
 out vec3 Normal;
 out vec3 Position;
@@ -11,9 +15,53 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 cameraPos;
 
+// heightfield mode: no vertex attributes, one instance per strip between rows gl_InstanceID and gl_InstanceID + 1
+uniform bool heightfield;
+uniform bool displaced;
+uniform sampler2D surfaceMap;       // height, then normal, of vertex j of row i at texel (j, i)
+uniform sampler2D displacementMap;  // horizontal displacement, same layout
+uniform vec2 gridOrigin;            // x, z of the first vertex
+uniform vec2 gridSpacing;           // distance between rows (x) and between the vertices of a row (z)
+
+// packed mode: height and normal come in as normalized shorts (see packSurfaceArray)
+uniform bool packedSurface;
+uniform float heightBound;
+
+// baked loop: how far the current time is from the frame in attributes 1 and 2 towards the one in attributes 4 and 5 (0 - not looping)
+uniform float loopBlend;
+
+// unit normal of an octahedral encoding (the lower half of the octahedron folded over the upper one)
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main() {
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec3 pos;
+    vec3 normal;
+    if (heightfield) {
+        ivec2 texel = ivec2(gl_VertexID >> 1, gl_InstanceID + (gl_VertexID & 1));
+        vec4 surface = texelFetch(surfaceMap, texel, 0);
+        vec2 offset = displaced ? texelFetch(displacementMap, texel, 0).xy : vec2(0);
+        pos = vec3(gridOrigin.x + texel.y * gridSpacing.x + offset.x, surface.x, gridOrigin.y + texel.x * gridSpacing.y + offset.y);
+        normal = surface.yzw;
+    } else if (packedSurface) {
+        float height = aHeight;
+        normal = octahedralDecode(aNormal.xy);
+        if (loopBlend > 0.0) {
+            height = mix(height, aNextHeight, loopBlend);
+            normal = normalize(mix(normal, octahedralDecode(aNextNormal), loopBlend));
+        }
+        pos = vec3(aPlane.x, height * heightBound, aPlane.y);
+    } else {
+        pos = vec3(aPlane.x + aDisplacement.x, aHeight, aPlane.y + aDisplacement.y);
+        normal = aNormal;
+    }
+
+    Normal = mat3(transpose(inverse(model))) * normal;
     CPosition = cameraPos;
-    Position = vec3(model * vec4(aPos, 1.0));
+    Position = vec3(model * vec4(pos, 1.0));
     gl_Position = projection * view * vec4(Position, 1.0);
-}
\ No newline at end of file
+}
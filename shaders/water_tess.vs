@@ -0,0 +1,15 @@
+#version 430 core
+
+// corner gl_VertexID of patch gl_InstanceID of a patches x patches grid over the water, generated without vertex attributes. Corners are in the
+// order of the quad domain: (u, v) = (0, 0), (1, 0), (0, 1), (1, 1), u running along x and v along z
+out vec2 vPlane;
+
+uniform vec2 gridOrigin;    // x, z of the first corner of the grid
+uniform vec2 patchSize;     // extent of a patch along x, z
+uniform int patches;
+
+void main() {
+    ivec2 cell = ivec2(gl_InstanceID / patches, gl_InstanceID % patches);
+    ivec2 corner = ivec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vPlane = gridOrigin + vec2(cell + corner) * patchSize;
+}